@@ -105,6 +105,160 @@ static const gchar *sql_statements[] =
 static const gchar *sql_update_statement =
   "update %s set %s=:value where rowid=:rowid;";
 
+/* Number of rows whose decoded values are kept around, so that reading
+ * the cells of a row only selects it once. Rows are dropped from the cache
+ * by the update hook, which only sees writes made through this model's
+ * connection: rows changed by other connections or processes can be read
+ * stale until they fall out of the cache.
+ */
+#define ROW_CACHE_SIZE 128
+
+typedef struct
+{
+  gint    rowid;
+  GValue *values;   /* One per column, unset if it can't be read */
+} ClutterSqliteRow;
+
+/* In paged mode, rows are fetched a page at a time in (key, rowid) order.
+ * A page next to one we already have is found from that page's first or
+ * last key, so scrolling never steps over rows it doesn't return. NULL
+ * keys sort first, and don't compare with =, < or >, so the statements
+ * check for them with IS.
+ */
+#define PAGE_CACHE_SIZE 8
+
+enum
+{
+  SQL_PAGE_COUNT = 0,
+  SQL_PAGE_FIRST,
+  SQL_PAGE_AFTER,
+  SQL_PAGE_BEFORE,
+  SQL_PAGE_AT,
+  SQL_PAGE_POSITION,
+  N_SQL_PAGE_STATEMENTS
+};
+
+/* Formatted with the table, key column and filter, except for the count,
+ * which has no key: a positional format has to use every argument up to
+ * the last one it uses. */
+static const gchar *sql_page_statements[] =
+  {
+    "select count(*) from %s where %s;",
+    "select *,rowid from %1$s where %3$s order by %2$s,rowid limit :n;",
+    "select *,rowid from %1$s where (%3$s) and "
+      "((:key is null and (%2$s is not null or rowid>:rowid)) or "
+      "%2$s>:key or (%2$s=:key and rowid>:rowid)) "
+      "order by %2$s,rowid limit :n;",
+    "select *,rowid from %1$s where (%3$s) and "
+      "((%2$s is null and (:key is not null or rowid<:rowid)) or "
+      "%2$s<:key or (%2$s=:key and rowid<:rowid)) "
+      "order by %2$s desc,rowid desc limit :n;",
+    "select *,rowid from %1$s where %3$s order by %2$s,rowid "
+      "limit :n offset :offset;",
+    "select (select count(*) from %1$s where (%3$s) and "
+      "((%2$s is null and (p.k is not null or rowid<:rowid)) or "
+      "%2$s<p.k or (%2$s=p.k and rowid<:rowid))) "
+      "from (select %2$s as k from %1$s where rowid=:rowid and (%3$s)) as p;",
+  };
+
+/* The statement the model builds for itself from its SQL sort and
+ * filters, see clutter_sqlite_model_set_sql_sort(). The WHERE is left out
+ * when there are no filters, so that analyse_statement() can tell rows
+ * aren't filtered.
+ */
+static const gchar *sql_select_statement =
+  "select *,rowid from %s%s%s order by %s;";
+
+static const gchar *sql_filter_ops[] =
+  {
+    "=", "!=", "<", "<=", ">", ">=", "like"
+  };
+
+typedef struct
+{
+  gint                   column;
+  ClutterSqliteFilterOp  op;
+  GValue                 value;
+} ClutterSqliteFilter;
+
+/* With asynchronous writes on, set_value() and remove_row() queue their
+ * writes for a thread with its own connection to the database. It puts
+ * as many queued writes as it has in one transaction, then hands the
+ * changes they made back to the main loop, where the model catches up.
+ */
+typedef enum
+{
+  WRITE_SET,
+  WRITE_DELETE,
+  WRITE_STOP
+} ClutterSqliteWriteType;
+
+typedef struct
+{
+  ClutterSqliteWriteType  type;
+  ClutterSqliteModel     *model;   /* Holds a reference */
+  gint                    rowid;
+  gint                    column;
+  GValue                  value;
+} ClutterSqliteWrite;
+
+typedef struct
+{
+  int  type;
+  gint rowid;
+  gint column;
+} ClutterSqliteChange;
+
+typedef struct
+{
+  ClutterSqliteModel *model;
+  GQueue             *writes;
+  GArray             *changes;
+} ClutterSqliteBatch;
+
+typedef struct
+{
+  gchar               *filename;
+  gchar               *table;
+  gchar              **col_names;
+  GAsyncQueue         *queue;
+  GThread             *thread;
+
+  /* Set up by writer_open(), then only used from the writer thread */
+  sqlite3             *db;
+  sqlite3_stmt        *delete_statement;
+  sqlite3_stmt       **update_statements;
+  ClutterSqliteBatch  *batch;
+  gint                 column;
+} ClutterSqliteWriter;
+
+/* Values written with set_value() that the writer thread hasn't committed
+ * yet, so reads see them straight away.
+ */
+typedef struct
+{
+  GValue *values;
+  guint  *n_writes;
+} ClutterSqlitePending;
+
+typedef struct
+{
+  int           type;    /* SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT or NULL */
+  sqlite_int64  i;
+  double        d;
+  gchar        *s;
+  gint          rowid;
+} ClutterSqlitePageKey;
+
+typedef struct
+{
+  guint                 index;
+  gint                 *rowids;
+  guint                 n_rows;
+  ClutterSqlitePageKey  first;
+  ClutterSqlitePageKey  last;
+} ClutterSqlitePage;
+
 struct _ClutterSqliteModelPrivate
 {
   sqlite3            *db;
@@ -125,19 +279,74 @@ struct _ClutterSqliteModelPrivate
   gboolean            skip_add;
   gboolean            skip_change;
   gboolean            skip_remove;
+
+  /* Most recently used at the head, indexed by rowid */
+  GQueue             *row_cache;
+  GHashTable         *rowid_to_cached;
+
+  /* What writes to the table can do to the statement's results, worked
+   * out from its SQL: whether all the rows come out in rowid order,
+   * which columns decide the order or which rows are included, and
+   * whether deletes leave the other rows alone.
+   */
+  gboolean            rowid_order;
+  gboolean           *key_columns;
+  gboolean            stable_deletes;
+  gint                changing_column;
+
+  /* Paged mode */
+  gboolean            paged;
+  guint               page_size;
+  gint                page_key;         /* Column index, -1 for rowid */
+  sqlite3_stmt       *page_statements[N_SQL_PAGE_STATEMENTS];
+  GHashTable         *pages;
+  GQueue             *page_lru;
+  gint                n_paged_rows;     /* -1 until counted */
+
+  /* SQL-side sorting and filtering */
+  gint                sql_sort_column;  /* -1 for rowid */
+  gboolean            sql_sort_descending;
+  gint                model_sort_column;  /* clutter_model_set_sort(), or -1 */
+  GArray             *sql_filters;
+  sqlite3_stmt       *own_statement;
+
+  /* Asynchronous writes */
+  gboolean             wal;
+  ClutterSqliteWriter *writer;
+  GHashTable          *pending;
+  GHashTable          *removing;   /* Rowids of rows queued for deletion */
 };
 
 /* Retries are every half a second */
 #define META_MAX_TRIES 30
 
-/* In case another process/thread is using this db, deal with locking */
-#define DB_RETRY_TIME 2000
-#define DB_RETRY_WAIT 0
+/* In case another process/thread is using this db, how long to wait for
+ * a lock before giving up, in milliseconds. Writes made on the main
+ * thread, like adding rows, can block it this long while the writer
+ * thread commits.
+ */
+#define DB_BUSY_TIMEOUT 2000
+
+/* The most writes the writer thread puts in one transaction */
+#define WRITE_BATCH_SIZE 256
+
+enum
+{
+  WRITES_DONE,
+
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0, };
 
 static ClutterModelIter *
 clutter_sqlite_model_iter_new (ClutterSqliteModel *db,
                                gint                row);
 
+static void writer_stop (ClutterSqliteWriter *writer);
+
+static void update_sql (ClutterSqliteModel *model);
+
 static ClutterModelIter *
 clutter_sqlite_model_iter_new_from_rowid (ClutterSqliteModel *db,
                                           gint                rowid);
@@ -174,11 +383,484 @@ clutter_sqlite_intv_get_type (void)
   return our_type;
 }
 
+static void
+row_cache_free_row (ClutterSqliteModel *model,
+                    ClutterSqliteRow   *row)
+{
+  gint i;
+
+  for (i = 0; i < model->priv->n_columns; i++)
+    if (G_IS_VALUE (&row->values[i]))
+      g_value_unset (&row->values[i]);
+
+  g_free (row->values);
+  g_slice_free (ClutterSqliteRow, row);
+}
+
+static void
+row_cache_remove (ClutterSqliteModel *model,
+                  gint                rowid)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  GList                     *link;
+
+  link = g_hash_table_lookup (priv->rowid_to_cached, GINT_TO_POINTER (rowid));
+  if (!link)
+    return;
+
+  g_hash_table_remove (priv->rowid_to_cached, GINT_TO_POINTER (rowid));
+  row_cache_free_row (model, link->data);
+  g_queue_delete_link (priv->row_cache, link);
+}
+
+static void
+row_cache_clear (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  ClutterSqliteRow          *row;
+
+  while ((row = g_queue_pop_head (priv->row_cache)))
+    row_cache_free_row (model, row);
+  g_hash_table_remove_all (priv->rowid_to_cached);
+}
+
+static ClutterSqliteRow *
+row_cache_lookup (ClutterSqliteModel *model,
+                  gint                rowid)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  GList                     *link;
+
+  link = g_hash_table_lookup (priv->rowid_to_cached, GINT_TO_POINTER (rowid));
+  if (!link)
+    return NULL;
+
+  /* Move to the front */
+  g_queue_unlink (priv->row_cache, link);
+  g_queue_push_head_link (priv->row_cache, link);
+
+  return link->data;
+}
+
+/* Decodes the row statement is on and caches it, dropping the least
+ * recently used row if the cache is full.
+ */
+static ClutterSqliteRow *
+row_cache_add (ClutterSqliteModel *model,
+               gint                rowid,
+               sqlite3_stmt       *statement)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  ClutterSqliteRow          *row;
+  gint                       i;
+
+  if ((row = row_cache_lookup (model, rowid)))
+    return row;
+
+  row = g_slice_new (ClutterSqliteRow);
+  row->rowid = rowid;
+  row->values = g_new0 (GValue, priv->n_columns);
+
+  for (i = 0; i < priv->n_columns; i++)
+    {
+      GValue *value = &row->values[i];
+
+      switch (priv->col_types->data[i])
+        {
+          case SQLITE_INTEGER :
+            g_value_init (value, G_TYPE_INT);
+            g_value_set_int (value, sqlite3_column_int (statement, i));
+            break;
+          case SQLITE_TEXT :
+            g_value_init (value, G_TYPE_STRING);
+            g_value_set_string (value, (const gchar *)
+                                sqlite3_column_text (statement, i));
+            break;
+          case SQLITE_BLOB :
+            g_value_init (value, G_TYPE_STRING);
+            break;
+          default :
+            break;
+        }
+    }
+
+  g_queue_push_head (priv->row_cache, row);
+  g_hash_table_insert (priv->rowid_to_cached,
+                       GINT_TO_POINTER (rowid),
+                       priv->row_cache->head);
+
+  if (priv->row_cache->length > ROW_CACHE_SIZE)
+    {
+      ClutterSqliteRow *oldest = g_queue_peek_tail (priv->row_cache);
+      row_cache_remove (model, oldest->rowid);
+    }
+
+  return row;
+}
+
+static void
+pending_free (ClutterSqlitePending *pending)
+{
+  g_free (pending->values);
+  g_free (pending->n_writes);
+  g_slice_free (ClutterSqlitePending, pending);
+}
+
+static void
+pending_add (ClutterSqliteModel *model,
+             gint                rowid,
+             gint                column,
+             const GValue       *value)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  ClutterSqlitePending      *pending;
+  GValue                    *pending_value;
+
+  pending = g_hash_table_lookup (priv->pending, GINT_TO_POINTER (rowid));
+  if (!pending)
+    {
+      pending = g_slice_new (ClutterSqlitePending);
+      pending->values = g_new0 (GValue, priv->n_columns);
+      pending->n_writes = g_new0 (guint, priv->n_columns);
+      g_hash_table_insert (priv->pending, GINT_TO_POINTER (rowid), pending);
+    }
+
+  pending_value = &pending->values[column];
+  if (G_IS_VALUE (pending_value))
+    g_value_unset (pending_value);
+  g_value_init (pending_value, G_VALUE_TYPE (value));
+  g_value_copy (value, pending_value);
+  pending->n_writes[column]++;
+}
+
+static void
+pending_remove (ClutterSqliteModel *model,
+                gint                rowid,
+                gint                column)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  ClutterSqlitePending      *pending;
+  gint                       i;
+
+  pending = g_hash_table_lookup (priv->pending, GINT_TO_POINTER (rowid));
+  if (!pending || (--pending->n_writes[column] > 0))
+    return;
+
+  /* The last write to this cell is in the database now */
+  g_value_unset (&pending->values[column]);
+
+  for (i = 0; i < priv->n_columns; i++)
+    if (pending->n_writes[i])
+      return;
+
+  g_hash_table_remove (priv->pending, GINT_TO_POINTER (rowid));
+}
+
+/* Waiting for locks is left to the busy handler, see DB_BUSY_TIMEOUT */
+static int
+step_statement (sqlite3_stmt *stmt)
+{
+  int result;
+  
+  g_assert (stmt);
+  
+  result = sqlite3_step (stmt);
+  if (result == SQLITE_BUSY)
+    g_warning ("Database busy, could not execute query");
+  
+  return result;
+}
+
+/* Binds a value of one of the fundamental types, returns FALSE for
+ * anything else.
+ */
+static gboolean
+bind_value (sqlite3_stmt *statement,
+            gint          index,
+            const GValue *value)
+{
+  switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (value)))
+    {
+    case G_TYPE_BOOLEAN :
+      sqlite3_bind_int (statement, index, g_value_get_boolean (value));
+      break;
+    case G_TYPE_INT :
+      sqlite3_bind_int (statement, index, g_value_get_int (value));
+      break;
+    case G_TYPE_UINT :
+      sqlite3_bind_int64 (statement, index, g_value_get_uint (value));
+      break;
+    case G_TYPE_INT64 :
+      sqlite3_bind_int64 (statement, index, g_value_get_int64 (value));
+      break;
+    case G_TYPE_ENUM :
+      sqlite3_bind_int (statement, index, g_value_get_enum (value));
+      break;
+    case G_TYPE_FLOAT :
+      sqlite3_bind_double (statement, index, g_value_get_float (value));
+      break;
+    case G_TYPE_DOUBLE :
+      sqlite3_bind_double (statement, index, g_value_get_double (value));
+      break;
+    case G_TYPE_STRING :
+      sqlite3_bind_text (statement, index, g_value_get_string (value),
+                         -1, SQLITE_TRANSIENT);
+      break;
+    default :
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+page_free (ClutterSqlitePage *page)
+{
+  g_free (page->first.s);
+  g_free (page->last.s);
+  g_free (page->rowids);
+  g_slice_free (ClutterSqlitePage, page);
+}
+
+static void
+pages_clear (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+
+  if (!priv->pages)
+    return;
+
+  g_hash_table_remove_all (priv->pages);
+  while (g_queue_pop_head (priv->page_lru));
+  priv->n_paged_rows = -1;
+}
+
+static void
+page_key_read (ClutterSqliteModel   *model,
+               sqlite3_stmt         *statement,
+               ClutterSqlitePageKey *key)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  gint                       column;
+
+  g_free (key->s);
+  key->s = NULL;
+  key->rowid = sqlite3_column_int (statement, priv->n_columns);
+
+  column = (priv->page_key < 0) ? priv->n_columns : priv->page_key;
+  key->type = sqlite3_column_type (statement, column);
+  switch (key->type)
+    {
+    case SQLITE_INTEGER :
+      key->i = sqlite3_column_int64 (statement, column);
+      break;
+    case SQLITE_FLOAT :
+      key->d = sqlite3_column_double (statement, column);
+      break;
+    case SQLITE_NULL :
+      break;
+    default :
+      key->type = SQLITE_TEXT;
+      key->s = g_strdup ((const gchar *) sqlite3_column_text (statement,
+                                                              column));
+      break;
+    }
+}
+
+static void
+page_key_bind (sqlite3_stmt         *statement,
+               ClutterSqlitePageKey *key)
+{
+  gint index;
+
+  index = sqlite3_bind_parameter_index (statement, ":key");
+  switch (key->type)
+    {
+    case SQLITE_INTEGER :
+      sqlite3_bind_int64 (statement, index, key->i);
+      break;
+    case SQLITE_FLOAT :
+      sqlite3_bind_double (statement, index, key->d);
+      break;
+    case SQLITE_TEXT :
+      sqlite3_bind_text (statement, index, key->s, -1, SQLITE_TRANSIENT);
+      break;
+    default :
+      sqlite3_bind_null (statement, index);
+      break;
+    }
+
+  sqlite3_bind_int (statement,
+                    sqlite3_bind_parameter_index (statement, ":rowid"),
+                    key->rowid);
+}
+
+/* Returns the page holding row, fetching it if need be. */
+static ClutterSqlitePage *
+page_get (ClutterSqliteModel *model,
+          guint               index)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  ClutterSqlitePage         *page, *next, *prev;
+  sqlite3_stmt              *statement;
+  gboolean                   backwards = FALSE;
+  gint                       result;
+  guint                      n;
+
+  page = g_hash_table_lookup (priv->pages, GUINT_TO_POINTER (index));
+  if (page)
+    {
+      g_queue_remove (priv->page_lru, page);
+      g_queue_push_head (priv->page_lru, page);
+      return page;
+    }
+
+  prev = index ?
+    g_hash_table_lookup (priv->pages, GUINT_TO_POINTER (index - 1)) : NULL;
+  next = g_hash_table_lookup (priv->pages, GUINT_TO_POINTER (index + 1));
+
+  if (index == 0)
+    statement = priv->page_statements[SQL_PAGE_FIRST];
+  else if (prev)
+    {
+      statement = priv->page_statements[SQL_PAGE_AFTER];
+      page_key_bind (statement, &prev->last);
+    }
+  else if (next)
+    {
+      statement = priv->page_statements[SQL_PAGE_BEFORE];
+      page_key_bind (statement, &next->first);
+      backwards = TRUE;
+    }
+  else
+    {
+      /* Nothing to go from, SQLite has to count its way there */
+      statement = priv->page_statements[SQL_PAGE_AT];
+      sqlite3_bind_int (statement,
+                        sqlite3_bind_parameter_index (statement, ":offset"),
+                        index * priv->page_size);
+    }
+
+  sqlite3_bind_int (statement,
+                    sqlite3_bind_parameter_index (statement, ":n"),
+                    priv->page_size);
+
+  page = g_slice_new0 (ClutterSqlitePage);
+  page->index = index;
+  page->rowids = g_new (gint, priv->page_size);
+
+  for (n = 0; (result = step_statement (statement)) == SQLITE_ROW; n++)
+    {
+      gint rowid = sqlite3_column_int (statement, priv->n_columns);
+      guint i = backwards ? priv->page_size - n - 1 : n;
+
+      page->rowids[i] = rowid;
+      row_cache_add (model, rowid, statement);
+
+      if (n == 0)
+        page_key_read (model, statement,
+                       backwards ? &page->last : &page->first);
+      page_key_read (model, statement,
+                     backwards ? &page->first : &page->last);
+    }
+
+  if (result != SQLITE_DONE)
+    g_warning ("Error fetching page %u: %s", index, sqlite3_errmsg (priv->db));
+  sqlite3_reset (statement);
+
+  /* Going backwards always fills the page, unless the table changed */
+  if (backwards && (n < priv->page_size))
+    memmove (page->rowids,
+             page->rowids + priv->page_size - n,
+             n * sizeof (gint));
+  page->n_rows = n;
+
+  g_hash_table_insert (priv->pages, GUINT_TO_POINTER (index), page);
+  g_queue_push_head (priv->page_lru, page);
+
+  if (priv->page_lru->length > PAGE_CACHE_SIZE)
+    {
+      ClutterSqlitePage *oldest = g_queue_pop_tail (priv->page_lru);
+      g_hash_table_remove (priv->pages, GUINT_TO_POINTER (oldest->index));
+    }
+
+  return page;
+}
+
+static guint
+paged_get_n_rows (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  sqlite3_stmt              *statement;
+
+  if (priv->n_paged_rows >= 0)
+    return priv->n_paged_rows;
+
+  statement = priv->page_statements[SQL_PAGE_COUNT];
+  if (step_statement (statement) == SQLITE_ROW)
+    priv->n_paged_rows = sqlite3_column_int (statement, 0);
+  else
+    g_warning ("Error counting rows: %s", sqlite3_errmsg (priv->db));
+  sqlite3_reset (statement);
+
+  return MAX (priv->n_paged_rows, 0);
+}
+
+/* Returns the row of rowid, or -1 */
+static gint
+paged_get_row (ClutterSqliteModel *model,
+               gint                rowid)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  sqlite3_stmt              *statement;
+  GList                     *l;
+  gint                       row = -1;
+  guint                      i;
+
+  for (l = priv->page_lru->head; l; l = l->next)
+    {
+      ClutterSqlitePage *page = l->data;
+
+      for (i = 0; i < page->n_rows; i++)
+        if (page->rowids[i] == rowid)
+          return page->index * priv->page_size + i;
+    }
+
+  statement = priv->page_statements[SQL_PAGE_POSITION];
+  sqlite3_bind_int (statement,
+                    sqlite3_bind_parameter_index (statement, ":rowid"),
+                    rowid);
+  if (step_statement (statement) == SQLITE_ROW)
+    row = sqlite3_column_int (statement, 0);
+  sqlite3_reset (statement);
+
+  return row;
+}
+
+static gint
+get_rowid (ClutterSqliteModel *model,
+           gint                row)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  ClutterSqlitePage         *page;
+
+  if (!priv->paged)
+    return GPOINTER_TO_INT (priv->rowids->pdata[row]);
+
+  page = page_get (model, row / priv->page_size);
+  if ((row % priv->page_size) >= page->n_rows)
+    return -1;
+
+  return page->rowids[row % priv->page_size];
+}
+
 static void
 reset_statement (ClutterSqliteModel *model)
 {
   ClutterSqliteModelPrivate *priv  = model->priv;
 
+  pages_clear (model);
+
   priv->version ++;
   priv->complete = FALSE;
   if (priv->rowids->len > 0)
@@ -186,6 +868,237 @@ reset_statement (ClutterSqliteModel *model)
   g_hash_table_remove_all (priv->rowid_to_row);
 }
 
+/* Splits the statement's SQL into lower-cased identifiers and numbers,
+ * dropping string literals, punctuation and operators.
+ */
+static GPtrArray *
+statement_tokens (const gchar *sql)
+{
+  GPtrArray   *tokens = g_ptr_array_new ();
+  const gchar *p = sql;
+
+  while (*p)
+    {
+      const gchar *start;
+
+      if (*p == '\'')
+        {
+          for (p++; *p && *p != '\''; p++);
+          if (*p)
+            p++;
+        }
+      else if ((*p == '"') || (*p == '`') || (*p == '['))
+        {
+          gchar close = (*p == '[') ? ']' : *p;
+
+          start = ++p;
+          for (; *p && *p != close; p++);
+          g_ptr_array_add (tokens, g_ascii_strdown (start, p - start));
+          if (*p)
+            p++;
+        }
+      else if (g_ascii_isalnum (*p) || (*p == '_'))
+        {
+          start = p;
+          for (; g_ascii_isalnum (*p) || (*p == '_'); p++);
+          g_ptr_array_add (tokens, g_ascii_strdown (start, p - start));
+        }
+      else
+        p++;
+    }
+
+  return tokens;
+}
+
+static void
+analyse_statement (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  GPtrArray                 *tokens;
+  guint                      from, i;
+  gint                       j;
+
+  /* Assume the worst until shown otherwise */
+  priv->rowid_order = FALSE;
+  priv->stable_deletes = FALSE;
+  for (j = 0; j < priv->n_columns; j++)
+    priv->key_columns[j] = TRUE;
+
+  if (!priv->statement)
+    return;
+
+  tokens = statement_tokens (sqlite3_sql (priv->statement));
+
+  for (from = 0; from < tokens->len; from++)
+    if (strcmp (tokens->pdata[from], "from") == 0)
+      break;
+
+  if ((from + 1 >= tokens->len) ||
+      (g_ascii_strcasecmp (tokens->pdata[from + 1], priv->table) != 0))
+    goto analyse_statement_done;
+
+  /* Joins, grouping, limits and sub-queries make every write suspect */
+  for (i = 0; i < tokens->len; i++)
+    {
+      const gchar *token = tokens->pdata[i];
+
+      if ((strcmp (token, "join") == 0) ||
+          (strcmp (token, "union") == 0) ||
+          (strcmp (token, "group") == 0) ||
+          (strcmp (token, "distinct") == 0) ||
+          (strcmp (token, "limit") == 0) ||
+          (strcmp (token, "offset") == 0) ||
+          ((strcmp (token, "select") == 0) && (i > 0)))
+        goto analyse_statement_done;
+    }
+
+  priv->stable_deletes = TRUE;
+
+  /* Nothing after the table name, or only an ascending rowid order */
+  i = tokens->len - (from + 2);
+  priv->rowid_order =
+    (i == 0) ||
+    (((i == 3) ||
+      ((i == 4) && (strcmp (tokens->pdata[from + 5], "asc") == 0))) &&
+     (strcmp (tokens->pdata[from + 2], "order") == 0) &&
+     (strcmp (tokens->pdata[from + 4], "rowid") == 0));
+
+  /* Only columns named after the table can affect order or membership,
+   * unless something is referred to by position.
+   */
+  for (j = 0; j < priv->n_columns; j++)
+    priv->key_columns[j] = FALSE;
+
+  for (i = from + 2; i < tokens->len; i++)
+    {
+      const gchar *token = tokens->pdata[i];
+
+      if (g_ascii_isdigit (token[0]))
+        {
+          for (j = 0; j < priv->n_columns; j++)
+            priv->key_columns[j] = TRUE;
+          break;
+        }
+
+      for (j = 0; j < priv->n_columns; j++)
+        if (g_ascii_strcasecmp (token, priv->col_names[j]) == 0)
+          priv->key_columns[j] = TRUE;
+    }
+
+  if (priv->rowid_order)
+    goto analyse_statement_done;
+
+  /* Anything in the select list besides plain columns, like an alias or
+   * an expression, could be what the rows are ordered or filtered by.
+   */
+  for (i = 1; i < from; i++)
+    {
+      const gchar *token = tokens->pdata[i];
+
+      if ((strcmp (token, "rowid") == 0) ||
+          (g_ascii_strcasecmp (token, priv->table) == 0))
+        continue;
+
+      for (j = 0; j < priv->n_columns; j++)
+        if (g_ascii_strcasecmp (token, priv->col_names[j]) == 0)
+          break;
+
+      if (j == priv->n_columns)
+        {
+          for (j = 0; j < priv->n_columns; j++)
+            priv->key_columns[j] = TRUE;
+          break;
+        }
+    }
+
+analyse_statement_done:
+  g_ptr_array_foreach (tokens, (GFunc) g_free, NULL);
+  g_ptr_array_free (tokens, TRUE);
+}
+
+/* Takes rowid out of the index, moving the rows after it up */
+static void
+index_remove (ClutterSqliteModel *model,
+              gint                rowid)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  gint                       row, i;
+
+  row = GPOINTER_TO_INT (g_hash_table_lookup (priv->rowid_to_row,
+                                              GINT_TO_POINTER (rowid)));
+  if (!row)
+    return;
+
+  g_hash_table_remove (priv->rowid_to_row, GINT_TO_POINTER (rowid));
+  g_ptr_array_remove_index (priv->rowids, row - 1);
+  for (i = row - 1; i < priv->rowids->len; i++)
+    g_hash_table_insert (priv->rowid_to_row,
+                         priv->rowids->pdata[i],
+                         GINT_TO_POINTER (i) + 1);
+}
+
+/* Brings the rowid index up to date after a write, in place if the
+ * statement's results can be worked out from the old ones. Returns FALSE
+ * if the index had to be thrown away instead.
+ */
+static gboolean
+update_index (ClutterSqliteModel *model,
+              int                 type,
+              gint                rowid)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+
+  /* A partial index can't be patched, the main statement has been
+   * reset under it. Pages are cheap to fetch again.
+   */
+  if (!priv->complete || !priv->statement || priv->paged)
+    {
+      reset_statement (model);
+      return FALSE;
+    }
+
+  switch (type)
+    {
+    case SQLITE_INSERT:
+      /* New rows get the highest rowid, so go at the end */
+      if (priv->rowid_order &&
+          ((priv->rowids->len == 0) ||
+           (rowid > GPOINTER_TO_INT (priv->rowids->pdata[priv->rowids->len - 1]))))
+        {
+          g_hash_table_insert (priv->rowid_to_row,
+                               GINT_TO_POINTER (rowid),
+                               GINT_TO_POINTER (priv->rowids->len) + 1);
+          g_ptr_array_add (priv->rowids, GINT_TO_POINTER (rowid));
+          priv->version ++;
+          return TRUE;
+        }
+      break;
+
+    case SQLITE_DELETE:
+      if (priv->stable_deletes)
+        {
+          index_remove (model, rowid);
+          priv->version ++;
+          return TRUE;
+        }
+      break;
+
+    case SQLITE_UPDATE:
+      /* Our own writes say which column changed. Others don't, and can
+       * change columns the model doesn't have, so they only leave the
+       * index alone if the statement returns every row in rowid order.
+       */
+      if ((priv->changing_column >= 0) ?
+          !priv->key_columns[priv->changing_column] :
+          priv->rowid_order)
+        return TRUE;
+      break;
+    }
+
+  reset_statement (model);
+  return FALSE;
+}
+
 static void
 clutter_sqlite_model_get_property (GObject    *object,
                                    guint       property_id,
@@ -249,6 +1162,12 @@ clutter_sqlite_model_set_property (GObject      *object,
       if (priv->statement)
         sqlite3_reset (priv->statement);
       priv->statement = g_value_get_pointer (value);
+      if (priv->own_statement && (priv->own_statement != priv->statement))
+        {
+          sqlite3_finalize (priv->own_statement);
+          priv->own_statement = NULL;
+        }
+      analyse_statement (CLUTTER_SQLITE_MODEL (object));
       g_signal_emit_by_name (object, "sort-changed");
       break;
     default:
@@ -259,6 +1178,15 @@ clutter_sqlite_model_set_property (GObject      *object,
 static void
 clutter_sqlite_model_dispose (GObject *object)
 {
+  ClutterSqliteModelPrivate *priv = CLUTTER_SQLITE_MODEL (object)->priv;
+
+  /* Queued writes hold a reference, so there are none left by now */
+  if (priv->writer)
+    {
+      writer_stop (priv->writer);
+      priv->writer = NULL;
+    }
+
   G_OBJECT_CLASS (clutter_sqlite_model_parent_class)->dispose (object);
 }
 
@@ -277,6 +1205,10 @@ clutter_sqlite_model_finalize (GObject *object)
   g_ptr_array_free (priv->rowids, TRUE);
   g_hash_table_destroy (priv->rowid_to_row);
 
+  row_cache_clear (CLUTTER_SQLITE_MODEL (object));
+  g_queue_free (priv->row_cache);
+  g_hash_table_destroy (priv->rowid_to_cached);
+
   /* Finalize statements */
   for (i = 0; i < N_SQL_STATEMENTS; i++)
     if (priv->statements[i])
@@ -285,45 +1217,27 @@ clutter_sqlite_model_finalize (GObject *object)
   for (i = 0; priv->update_statements[i]; i++)
     sqlite3_finalize (priv->update_statements[i]);
   g_free (priv->update_statements);
-  
-  G_OBJECT_CLASS (clutter_sqlite_model_parent_class)->finalize (object);
-}
+  g_free (priv->key_columns);
 
-static glong
-time_val_diff (GTimeVal *val1, GTimeVal *val2)
-{
-  glong diff;
-  
-  diff = (val2->tv_sec - val1->tv_sec) * 1000;
-  diff += (val2->tv_usec - val1->tv_usec) / 1000;
-  
-  return diff;
-}
+  for (i = 0; i < N_SQL_PAGE_STATEMENTS; i++)
+    if (priv->page_statements[i])
+      sqlite3_finalize (priv->page_statements[i]);
+  if (priv->pages)
+    {
+      g_hash_table_destroy (priv->pages);
+      g_queue_free (priv->page_lru);
+    }
 
-static int
-sqlite3_step_retry (sqlite3_stmt *stmt)
-{
-  GTimeVal val1, val2;
-  int result = SQLITE_BUSY;
-  
-  g_assert (stmt);
+  if (priv->own_statement)
+    sqlite3_finalize (priv->own_statement);
+  g_hash_table_destroy (priv->pending);
+  g_hash_table_destroy (priv->removing);
+  for (i = 0; i < (gint) priv->sql_filters->len; i++)
+    g_value_unset (&g_array_index (priv->sql_filters,
+                                   ClutterSqliteFilter, i).value);
+  g_array_free (priv->sql_filters, TRUE);
   
-  g_get_current_time (&val1);
-  
-  while (result == SQLITE_BUSY) {
-    if ((result = sqlite3_step (stmt)) != SQLITE_BUSY)
-      break;
-    
-    g_get_current_time (&val2);
-    
-    if (time_val_diff (&val1, &val2) >= DB_RETRY_TIME)
-      break;
-  }
-  
-  if (result == SQLITE_BUSY)
-    g_warning ("Database busy, could not execute query");
-  
-  return result;
+  G_OBJECT_CLASS (clutter_sqlite_model_parent_class)->finalize (object);
 }
 
 static gboolean
@@ -334,6 +1248,7 @@ statement_next (ClutterSqliteModel *model,
 {
   ClutterSqliteModelPrivate *priv = model->priv;
   gboolean                   last = FALSE;
+  gboolean                   skip;
   
   if (!priv->statement)
     return TRUE;
@@ -345,9 +1260,15 @@ statement_next (ClutterSqliteModel *model,
   
   do
     {
-      int result = sqlite3_step_retry (priv->statement);
+      int result = step_statement (priv->statement);
       gint rowid = sqlite3_column_int (priv->statement, priv->n_columns);
       
+      /* Rows queued for deletion have already left the model */
+      skip = (result == SQLITE_ROW) &&
+        g_hash_table_lookup (priv->removing, GINT_TO_POINTER (rowid));
+      if (skip)
+        continue;
+
       if (result == SQLITE_ROW)
         {
           g_hash_table_insert (priv->rowid_to_row,
@@ -374,11 +1295,332 @@ statement_next (ClutterSqliteModel *model,
       
       if ((priv->rowids->len - 1) == stop_on_row)
         break;
-    } while (complete);
+    } while (complete || skip);
   
   return last;
 }
 
+static void
+write_free (ClutterSqliteWrite *write)
+{
+  if (G_IS_VALUE (&write->value))
+    g_value_unset (&write->value);
+  if (write->model)
+    g_object_unref (write->model);
+  g_slice_free (ClutterSqliteWrite, write);
+}
+
+static void
+writer_hook (void         *user_data,
+             int           type,
+             const char   *db_name,
+             const char   *table,
+             sqlite_int64  rowid)
+{
+  ClutterSqliteWriter *writer = user_data;
+  ClutterSqliteChange  change;
+
+  if (!writer->batch || (strcmp (writer->table, table) != 0))
+    return;
+
+  change.type = type;
+  change.rowid = rowid;
+  change.column = writer->column;
+  g_array_append_val (writer->batch->changes, change);
+}
+
+/* Runs in the main loop, once the writes in a batch are committed */
+static gboolean
+writer_batch_done (ClutterSqliteBatch *batch)
+{
+  ClutterSqliteModel        *model = g_object_ref (batch->model);
+  ClutterSqliteModelPrivate *priv  = model->priv;
+  ClutterSqliteWrite        *write;
+  gboolean                   deleted = FALSE;
+  guint                      i;
+
+  for (i = 0; i < batch->changes->len; i++)
+    {
+      ClutterSqliteChange *change =
+        &g_array_index (batch->changes, ClutterSqliteChange, i);
+
+      /* ClutterModel has already emitted the signals for these, like it
+       * does when we write synchronously.
+       */
+      row_cache_remove (model, change->rowid);
+      priv->changing_column = change->column;
+      update_index (model, change->type, change->rowid);
+      priv->changing_column = -1;
+    }
+
+  while ((write = g_queue_pop_head (batch->writes)))
+    {
+      if (write->type == WRITE_SET)
+        pending_remove (model, write->rowid, write->column);
+      else
+        {
+          g_hash_table_remove (priv->removing,
+                               GINT_TO_POINTER (write->rowid));
+          deleted = TRUE;
+        }
+      write_free (write);
+    }
+
+  /* If the batch was rolled back, the rows taken out are still there */
+  if (deleted && (batch->changes->len == 0))
+    reset_statement (model);
+
+  g_queue_free (batch->writes);
+  g_array_free (batch->changes, TRUE);
+  g_slice_free (ClutterSqliteBatch, batch);
+
+  g_signal_emit (model, signals[WRITES_DONE], 0);
+  g_object_unref (model);
+
+  return FALSE;
+}
+
+static void
+writer_apply (ClutterSqliteWriter *writer,
+              ClutterSqliteWrite  *write)
+{
+  sqlite3_stmt *statement;
+
+  if (write->type == WRITE_SET)
+    {
+      statement = writer->update_statements[write->column];
+      bind_value (statement, 1, &write->value);
+      sqlite3_bind_int (statement, 2, write->rowid);
+    }
+  else
+    {
+      statement = writer->delete_statement;
+      sqlite3_bind_int (statement, 1, write->rowid);
+    }
+
+  writer->column = (write->type == WRITE_SET) ? write->column : -1;
+  if (step_statement (statement) != SQLITE_DONE)
+    g_warning ("Unable to write to db: %s", sqlite3_errmsg (writer->db));
+  sqlite3_reset (statement);
+  writer->column = -1;
+}
+
+static gpointer
+writer_thread (ClutterSqliteWriter *writer)
+{
+  ClutterSqliteWrite *write;
+  gboolean            stop = FALSE;
+
+  while (!stop)
+    {
+      ClutterSqliteBatch *batch;
+
+      write = g_async_queue_pop (writer->queue);
+      if (write->type == WRITE_STOP)
+        {
+          write_free (write);
+          break;
+        }
+
+      batch = g_slice_new (ClutterSqliteBatch);
+      batch->model = write->model;
+      batch->writes = g_queue_new ();
+      batch->changes = g_array_new (FALSE, FALSE,
+                                    sizeof (ClutterSqliteChange));
+      writer->batch = batch;
+
+      sqlite3_exec (writer->db, "begin;", NULL, NULL, NULL);
+      do
+        {
+          if (write->type == WRITE_STOP)
+            {
+              write_free (write);
+              stop = TRUE;
+              break;
+            }
+
+          writer_apply (writer, write);
+          g_queue_push_tail (batch->writes, write);
+        }
+      while ((batch->writes->length < WRITE_BATCH_SIZE) &&
+             (write = g_async_queue_try_pop (writer->queue)));
+
+      if (sqlite3_exec (writer->db, "commit;", NULL, NULL, NULL) != SQLITE_OK)
+        {
+          g_warning ("Unable to commit writes: %s",
+                     sqlite3_errmsg (writer->db));
+          sqlite3_exec (writer->db, "rollback;", NULL, NULL, NULL);
+          g_array_set_size (batch->changes, 0);
+        }
+
+      writer->batch = NULL;
+      g_idle_add ((GSourceFunc) writer_batch_done, batch);
+    }
+
+  return NULL;
+}
+
+static void
+writer_free (ClutterSqliteWriter *writer)
+{
+  gint i;
+
+  sqlite3_finalize (writer->delete_statement);
+  if (writer->update_statements)
+    for (i = 0; writer->col_names[i]; i++)
+      sqlite3_finalize (writer->update_statements[i]);
+  g_free (writer->update_statements);
+  sqlite3_close (writer->db);
+
+  g_async_queue_unref (writer->queue);
+  g_strfreev (writer->col_names);
+  g_free (writer->table);
+  g_free (writer->filename);
+  g_slice_free (ClutterSqliteWriter, writer);
+}
+
+/* Opens the writer's connection and prepares its statements. The thread
+ * gets them once this has worked, and is the only one to use them.
+ */
+static gboolean
+writer_open (ClutterSqliteWriter *writer)
+{
+  gchar *text;
+  gint   i;
+
+  if (sqlite3_open_v2 (writer->filename, &writer->db,
+                       SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK)
+    {
+      g_warning ("Writer can't open '%s': %s",
+                 writer->filename, sqlite3_errmsg (writer->db));
+      return FALSE;
+    }
+
+  sqlite3_busy_timeout (writer->db, DB_BUSY_TIMEOUT);
+  sqlite3_update_hook (writer->db, writer_hook, writer);
+
+  text = g_strdup_printf (sql_statements[SQL_DELETE_ROW], writer->table);
+  if (sqlite3_prepare (writer->db, text, -1,
+                       &writer->delete_statement, NULL) != SQLITE_OK)
+    {
+      g_warning ("Writer failed to prepare '%s': %s",
+                 text, sqlite3_errmsg (writer->db));
+      g_free (text);
+      return FALSE;
+    }
+  g_free (text);
+
+  writer->update_statements =
+    g_new0 (sqlite3_stmt *, g_strv_length (writer->col_names) + 1);
+  for (i = 0; writer->col_names[i]; i++)
+    {
+      text = g_strdup_printf (sql_update_statement,
+                              writer->table, writer->col_names[i]);
+      if (sqlite3_prepare (writer->db, text, -1,
+                           &writer->update_statements[i], NULL) != SQLITE_OK)
+        {
+          g_warning ("Writer failed to prepare '%s': %s",
+                     text, sqlite3_errmsg (writer->db));
+          g_free (text);
+          return FALSE;
+        }
+      g_free (text);
+    }
+
+  return TRUE;
+}
+
+static ClutterSqliteWriter *
+writer_start (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  ClutterSqliteWriter       *writer;
+  const gchar               *filename;
+  GError                    *error = NULL;
+
+  /* In-memory and temporary databases can't be opened twice */
+  filename = sqlite3_db_filename (priv->db, "main");
+  if (!filename || !*filename)
+    {
+      g_warning ("Asynchronous writes need a database file");
+      return NULL;
+    }
+
+  /* Without WAL, the writer's transactions would lock readers out */
+  if (!priv->wal)
+    {
+      g_warning ("Asynchronous writes need the database in WAL mode");
+      return NULL;
+    }
+
+  if (!g_thread_supported ())
+    {
+      g_warning ("Asynchronous writes need threads, see g_thread_init()");
+      return NULL;
+    }
+
+  writer = g_slice_new0 (ClutterSqliteWriter);
+  writer->filename = g_strdup (filename);
+  writer->table = g_strdup (priv->table);
+  writer->col_names = g_strdupv (priv->col_names);
+  writer->queue = g_async_queue_new ();
+  writer->column = -1;
+
+  if (!writer_open (writer))
+    {
+      writer_free (writer);
+      return NULL;
+    }
+
+  writer->thread = g_thread_create ((GThreadFunc) writer_thread,
+                                    writer, TRUE, &error);
+  if (!writer->thread)
+    {
+      g_warning ("Can't start writer thread: %s", error->message);
+      g_error_free (error);
+      writer_free (writer);
+      return NULL;
+    }
+
+  return writer;
+}
+
+/* Waits for the queued writes to be committed and the thread to exit */
+static void
+writer_stop (ClutterSqliteWriter *writer)
+{
+  ClutterSqliteWrite *write = g_slice_new0 (ClutterSqliteWrite);
+
+  write->type = WRITE_STOP;
+  g_async_queue_push (writer->queue, write);
+  g_thread_join (writer->thread);
+
+  writer_free (writer);
+}
+
+static void
+writer_push (ClutterSqliteModel     *model,
+             ClutterSqliteWriteType  type,
+             gint                    rowid,
+             gint                    column,
+             const GValue           *value)
+{
+  ClutterSqliteWrite *write = g_slice_new0 (ClutterSqliteWrite);
+
+  write->type = type;
+  write->model = g_object_ref (model);
+  write->rowid = rowid;
+  write->column = column;
+  if (value)
+    {
+      g_value_init (&write->value, G_VALUE_TYPE (value));
+      g_value_copy (value, &write->value);
+      pending_add (model, rowid, column, value);
+    }
+
+  g_async_queue_push (model->priv->writer->queue, write);
+}
+
 static void
 clutter_sqlite_update_hook (void          *user_data,
                             int            type,
@@ -393,6 +1635,15 @@ clutter_sqlite_update_hook (void          *user_data,
   
   if (strcmp (priv->table, table) != 0)
     return;
+
+  /* Any cached copy of the row is out of date now, including for changes
+   * we made ourselves.
+   */
+  if (type != SQLITE_INSERT)
+    row_cache_remove (model, rowid);
+
+  /* Update our index first, so handlers see the new rows */
+  update_index (model, type, rowid);
   
   /* We need to be able to skip row additions/changes as ClutterModel emits 
    * these signals itself, where as we want to emit them for all additions/
@@ -435,9 +1686,6 @@ clutter_sqlite_update_hook (void          *user_data,
           break;
         }
     }
-  
-  /* Reset our index, it may not be valid anymore */
-  reset_statement (model);
 }
 
 static guint
@@ -446,6 +1694,9 @@ clutter_sqlite_model_get_n_rows (ClutterModel *model)
   ClutterSqliteModel        *sqlite_model = CLUTTER_SQLITE_MODEL (model);
   ClutterSqliteModelPrivate *priv         = sqlite_model->priv;
   
+  if (priv->paged)
+    return paged_get_n_rows (sqlite_model);
+
   if (!priv->complete)
     statement_next (sqlite_model, TRUE, -1, -1);
   
@@ -501,7 +1752,7 @@ clutter_sqlite_model_insert_row (ClutterModel *model, gint index)
 
   /* Skip the add hook, ClutterModel generates the row-added signal */
   priv->skip_add = TRUE;
-  result = sqlite3_step_retry (priv->statements[SQL_ADD_ROW]);
+  result = step_statement (priv->statements[SQL_ADD_ROW]);
   sqlite3_reset (priv->statements[SQL_ADD_ROW]);
 
   if (result == SQLITE_DONE)
@@ -528,6 +1779,36 @@ clutter_sqlite_model_remove_row (ClutterModel *model, guint row)
   ClutterSqliteModel        *sqlite_model = CLUTTER_SQLITE_MODEL (model);
   ClutterSqliteModelPrivate *priv         = sqlite_model->priv;
   ClutterModelIter          *iter;
+  gint                       rowid;
+
+  /* Pages come straight from the database, so rows can't leave them
+   * before they're deleted: paged models delete synchronously.
+   */
+  if (priv->writer && !priv->paged)
+    {
+      if (!priv->complete)
+        statement_next (sqlite_model, TRUE, -1, -1);
+
+      rowid = get_rowid (sqlite_model, row);
+
+      iter = clutter_sqlite_model_iter_new (sqlite_model, row);
+      if (iter)
+        {
+          g_signal_emit_by_name (model, "row-removed", iter);
+          g_object_unref (iter);
+        }
+
+      /* The writer's connection has its own update hook, so take the row
+       * out now, and keep it out until the delete is committed.
+       */
+      index_remove (sqlite_model, rowid);
+      priv->version ++;
+      g_hash_table_insert (priv->removing,
+                           GINT_TO_POINTER (rowid), GINT_TO_POINTER (TRUE));
+
+      writer_push (sqlite_model, WRITE_DELETE, rowid, -1, NULL);
+      return;
+    }
 
   /* Fire off 'removed' signal. We do this here, so at least for rows 
    * removed through ClutterModel, we can pass a valid iter.
@@ -545,8 +1826,8 @@ clutter_sqlite_model_remove_row (ClutterModel *model, guint row)
 
   sqlite3_bind_int (priv->statements[SQL_DELETE_ROW],
                     1,
-                    GPOINTER_TO_INT (priv->rowids->pdata[row]));
-  sqlite3_step_retry (priv->statements[SQL_DELETE_ROW]);
+                    get_rowid (sqlite_model, row));
+  step_statement (priv->statements[SQL_DELETE_ROW]);
   sqlite3_reset (priv->statements[SQL_DELETE_ROW]);
 }
 
@@ -556,11 +1837,54 @@ clutter_sqlite_model_get_iter_at_row (ClutterModel *model, guint row)
   return clutter_sqlite_model_iter_new (CLUTTER_SQLITE_MODEL (model), row);
 }
 
+/* A sort function can't be run by SQLite, so the sorting column is
+ * sorted on in the model's own statement instead: see
+ * clutter_sqlite_model_set_sql_sort(). A "statement" set from outside
+ * keeps its own order.
+ */
 static void
 clutter_sqlite_model_resort (ClutterModel         *model,
                              ClutterModelSortFunc  func,
                              gpointer              data)
 {
+  ClutterSqliteModelPrivate *priv = CLUTTER_SQLITE_MODEL (model)->priv;
+  gint                       column;
+
+  column = func ? clutter_model_get_sorting_column (model) : -1;
+  if (column == priv->model_sort_column)
+    return;
+
+  priv->model_sort_column = column;
+
+  if (!priv->paged &&
+      priv->own_statement &&
+      (priv->statement == priv->own_statement))
+    update_sql (CLUTTER_SQLITE_MODEL (model));
+}
+
+/* Returns whether the database is in WAL mode now. SQLite says which mode
+ * it ended up in, which is the old one for in-memory databases or if it
+ * can't do WAL.
+ */
+static gboolean
+set_wal (sqlite3 *db)
+{
+  sqlite3_stmt *statement;
+  const gchar  *mode;
+  gboolean      wal = FALSE;
+
+  if (sqlite3_prepare (db, "pragma journal_mode=wal;",
+                       -1, &statement, NULL) != SQLITE_OK)
+    return FALSE;
+
+  if (step_statement (statement) == SQLITE_ROW)
+    {
+      mode = (const gchar *) sqlite3_column_text (statement, 0);
+      wal = mode && (g_ascii_strcasecmp (mode, "wal") == 0);
+    }
+  sqlite3_finalize (statement);
+
+  return wal;
 }
 
 static GObject *
@@ -577,8 +1901,11 @@ clutter_sqlite_model_constructor (GType                  type,
   obj = gobject_class->constructor (type, n_properties, properties);
   priv = CLUTTER_SQLITE_MODEL (obj)->priv;
   
-  /* Set the busy-timeout */
-  sqlite3_busy_timeout (priv->db, DB_RETRY_WAIT);
+  /* Wait for locks in SQLite's busy handler, and let readers and the
+   * writer thread work at the same time.
+   */
+  sqlite3_busy_timeout (priv->db, DB_BUSY_TIMEOUT);
+  priv->wal = set_wal (priv->db);
   
   /* Generate and precompile statements */
   for (i = 0; i < N_SQL_STATEMENTS; i++)
@@ -599,6 +1926,8 @@ clutter_sqlite_model_constructor (GType                  type,
     }
   
   priv->n_columns = priv->col_types->length;
+  priv->key_columns = g_new0 (gboolean, priv->n_columns);
+  analyse_statement (CLUTTER_SQLITE_MODEL (obj));
   
   priv->update_statements =
     g_malloc0 (sizeof (sqlite3_stmt *) * priv->n_columns);
@@ -691,6 +2020,22 @@ clutter_sqlite_model_class_init (ClutterSqliteModelClass *klass)
                                                          "Sqlite3 statement "
                                                          "pointer",
                                                          G_PARAM_READWRITE));
+
+  /**
+   * ClutterSqliteModel::writes-done:
+   * @model: the model that received the signal
+   *
+   * Emitted in the main loop when a batch of asynchronous writes has been
+   * committed and the model has caught up with it.
+   */
+  signals[WRITES_DONE] =
+    g_signal_new ("writes-done",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
 }
 
 static void
@@ -700,6 +2045,19 @@ clutter_sqlite_model_init (ClutterSqliteModel *self)
   
   priv->rowids = g_ptr_array_new ();
   priv->rowid_to_row = g_hash_table_new (NULL, NULL);
+
+  priv->row_cache = g_queue_new ();
+  priv->rowid_to_cached = g_hash_table_new (NULL, NULL);
+
+  priv->changing_column = -1;
+
+  priv->sql_sort_column = -1;
+  priv->model_sort_column = -1;
+  priv->sql_filters = g_array_new (FALSE, TRUE, sizeof (ClutterSqliteFilter));
+
+  priv->pending = g_hash_table_new_full (NULL, NULL, NULL,
+                                         (GDestroyNotify) pending_free);
+  priv->removing = g_hash_table_new (NULL, NULL);
 }
 
 ClutterModel *
@@ -763,65 +2121,62 @@ clutter_sqlite_model_iter_get_value (ClutterModelIter *iter,
                                      guint             column,
                                      GValue           *value)
 {
-  sqlite3_stmt *statement;
-  GType         column_type;
-  gboolean      converted    = FALSE;
-  GValue        real_value   = { 0, };
-  GValue        column_value = { 0, };
+  sqlite3_stmt     *statement = NULL;
+  GType             column_type;
+  gint                  rowid;
+  ClutterSqliteRow     *row;
+  ClutterSqlitePending *pending;
+  GValue               *column_value;
+  GValue            real_value = { 0, };
 
   ClutterModel              *model   = clutter_model_iter_get_model (iter);
-  ClutterSqliteModelPrivate *priv    = CLUTTER_SQLITE_MODEL (model)->priv;
+  ClutterSqliteModel        *sqlite_model = CLUTTER_SQLITE_MODEL (model);
+  ClutterSqliteModelPrivate *priv    = sqlite_model->priv;
   ClutterSqliteModelIter    *sqliter = CLUTTER_SQLITE_MODEL_ITER (iter);
   
-  if (!priv->statement)
+  if (!priv->statement && !priv->paged)
     return;
 
   column_type = clutter_sqlite_model_get_column_type (model, column);
   if (column_type == G_TYPE_INVALID)
     return;
   
-  if (sqliter->is_parent == priv->version)
-    statement = priv->statement;
-  else
+  if (priv->statement && (sqliter->is_parent == priv->version))
     {
-      gint rowid = (sqliter->row == -1) ?
-        sqliter->rowid : GPOINTER_TO_INT (priv->rowids->pdata[sqliter->row]);
-      sqlite3_bind_int (priv->statements[SQL_GET_ROW], 1, rowid);
-      if (sqlite3_step_retry (priv->statements[SQL_GET_ROW]) != SQLITE_ROW)
-        {
-          g_warning ("Error getting row: %s", sqlite3_errmsg (priv->db));
-          sqlite3_reset (priv->statements[SQL_GET_ROW]);
-          return;
-        }
-      
-      statement = priv->statements[SQL_GET_ROW];
+      /* The main statement is sitting on this row */
+      statement = priv->statement;
+      rowid = sqlite3_column_int (statement, priv->n_columns);
     }
+  else
+    rowid = (sqliter->row == -1) ?
+      sqliter->rowid : get_rowid (sqlite_model, sqliter->row);
   
-  g_value_init (&column_value, column_type);
-  switch (column_type)
+  pending = g_hash_table_lookup (priv->pending, GINT_TO_POINTER (rowid));
+  if (pending && pending->n_writes[column])
+    row = NULL;
+  else if (!(row = row_cache_lookup (sqlite_model, rowid)))
     {
-      case G_TYPE_STRING :
-        if (priv->col_types->data[column] == SQLITE_TEXT)
-          g_value_set_string (&column_value, (const gchar *)
-                              sqlite3_column_text (statement, column));
-        break;
-      case G_TYPE_INT :
-        g_value_set_int (&column_value,
-                         sqlite3_column_int (statement, column));
-        break;
-      case G_TYPE_BOOLEAN :
-        g_value_set_boolean (&column_value,
-                             sqlite3_column_int (statement, column));
-        break;
-      default :
-        g_value_unset (&column_value);
-        if (sqliter->is_parent != priv->version)
+      if (!statement)
+        {
+          sqlite3_bind_int (priv->statements[SQL_GET_ROW], 1, rowid);
+          if (step_statement (priv->statements[SQL_GET_ROW]) != SQLITE_ROW)
+            {
+              g_warning ("Error getting row: %s", sqlite3_errmsg (priv->db));
+              sqlite3_reset (priv->statements[SQL_GET_ROW]);
+              return;
+            }
+          
+          row = row_cache_add (sqlite_model, rowid,
+                               priv->statements[SQL_GET_ROW]);
           sqlite3_reset (priv->statements[SQL_GET_ROW]);
-        return;
+        }
+      else
+        row = row_cache_add (sqlite_model, rowid, statement);
     }
   
-  if (sqliter->is_parent != priv->version)
-    sqlite3_reset (priv->statements[SQL_GET_ROW]);
+  column_value = row ? &row->values[column] : &pending->values[column];
+  if (!G_IS_VALUE (column_value))
+    return;
 
   if (!g_type_is_a (G_VALUE_TYPE (value), column_type))
     {
@@ -835,27 +2190,22 @@ clutter_sqlite_model_iter_get_value (ClutterModelIter *iter,
           return;
         }
       
-      if (!g_value_transform (&column_value, &real_value))
+      g_value_init (&real_value, G_VALUE_TYPE (value));
+      if (!g_value_transform (column_value, &real_value))
         {
           g_warning ("%s: Unable to make conversion from %s to %s",
                      G_STRLOC, 
                      g_type_name (column_type),
                      g_type_name (G_VALUE_TYPE (value)));
           g_value_unset (&real_value);
+          return;
         }
       
-      converted = TRUE;
-    }
-    
-  if (converted)
-    {
       g_value_copy (&real_value, value);
       g_value_unset (&real_value);
     }
   else
-    g_value_copy (&column_value, value);
-  
-  g_value_unset (&column_value);
+    g_value_copy (column_value, value);
 }
 
 static void
@@ -873,7 +2223,7 @@ clutter_sqlite_model_iter_set_value (ClutterModelIter *iter,
   ClutterSqliteModelPrivate *priv         = sqlite_model->priv;
   ClutterSqliteModelIter    *sqliter      = CLUTTER_SQLITE_MODEL_ITER (iter);
 
-  if (!priv->statement)
+  if (!priv->statement && !priv->paged)
     return;
   
   column_type = clutter_sqlite_model_get_column_type (model, column);
@@ -912,36 +2262,23 @@ clutter_sqlite_model_iter_set_value (ClutterModelIter *iter,
   if (!priv->complete && priv->rowids->len)
     statement_next (sqlite_model, TRUE, -1, -1);
   
-  switch (column_type)
+  rowid = (sqliter->row == -1) ?
+    sqliter->rowid : get_rowid (sqlite_model, sqliter->row);
+
+  if (priv->writer)
     {
-      case G_TYPE_STRING :
-        sqlite3_bind_text (priv->update_statements[column],
-                           1, g_value_get_string (&real_value), -1,
-                           SQLITE_TRANSIENT);
-        break;
-      case G_TYPE_INT :
-        sqlite3_bind_int (priv->update_statements[column],
-                          1, g_value_get_int (&real_value));
-        break;
-      case G_TYPE_BOOLEAN :
-        sqlite3_bind_int (priv->update_statements[column],
-                          1, g_value_get_boolean (&real_value));
-        break;
-      case G_TYPE_ENUM :
-        sqlite3_bind_int (priv->update_statements[column],
-                          1, g_value_get_enum (&real_value));
-        break;
-      case G_TYPE_OBJECT :
-        /* TODO: Let's think about this later */
-      default :
-        goto _iter_set_value_skip_write;
+      writer_push (sqlite_model, WRITE_SET, rowid, column, &real_value);
+      goto _iter_set_value_skip_write;
     }
+
+  if (!bind_value (priv->update_statements[column], 1, &real_value))
+    goto _iter_set_value_skip_write;
   
-  rowid = (sqliter->row == -1) ?
-    sqliter->rowid : GPOINTER_TO_INT (priv->rowids->pdata[sqliter->row]);
   sqlite3_bind_int (priv->update_statements[column], 2, rowid);
   priv->skip_change = TRUE;
-  sqlite3_step_retry (priv->update_statements[column]);
+  priv->changing_column = column;
+  step_statement (priv->update_statements[column]);
+  priv->changing_column = -1;
   res = sqlite3_reset (priv->update_statements[column]);
 
   if (res != SQLITE_OK)
@@ -975,6 +2312,25 @@ clutter_sqlite_model_iter_new (ClutterSqliteModel *model,
   ClutterSqliteModelIter    *iter;
   ClutterSqliteModelPrivate *priv = model->priv;
   
+  if (priv->paged)
+    {
+      guint n_rows = paged_get_n_rows (model);
+      
+      if (row > (gint) n_rows)
+        return NULL;
+      
+      iter = g_object_new (CLUTTER_SQLITE_TYPE_MODEL_ITER,
+                           "model", model,
+                           "row", row,
+                           NULL);
+      iter->row = row;
+
+      /* Iterators made from a rowid find their row when moved */
+      iter->is_last = (row >= (gint) n_rows);
+      
+      return CLUTTER_MODEL_ITER (iter);
+    }
+  
   if (!priv->statement)
     return NULL;
   
@@ -992,9 +2348,9 @@ clutter_sqlite_model_iter_new (ClutterSqliteModel *model,
                        "row", row,
                        NULL);
   iter->row = row;
-  iter->is_last = (row >= priv->rowids->len) ? TRUE : FALSE;
+  iter->is_last = (row >= (gint) priv->rowids->len) ? TRUE : FALSE;
   
-  if ((row == priv->rowids->len) && (!priv->complete))
+  if ((row == (gint) priv->rowids->len) && (!priv->complete))
     {
       iter->is_last = statement_next (model, FALSE, -1, -1);
       iter->is_parent = priv->version;
@@ -1011,7 +2367,7 @@ clutter_sqlite_model_iter_new_from_rowid (ClutterSqliteModel *model,
   ClutterModelIter          *iter;
   ClutterSqliteModelIter    *sqlite_iter;
   
-  if (!priv->statement)
+  if (!priv->statement && !priv->paged)
     return NULL;
   
   iter = clutter_sqlite_model_iter_new (model, -1);
@@ -1036,25 +2392,31 @@ clutter_sqlite_model_iter_next (ClutterModelIter *iter)
   priv = model->priv;
 
   /* If we don't yet have a row set, try to get one */
-  if (sqliter->row < 0)
+  if ((sqliter->row < 0) && priv->paged)
+    {
+      sqliter->row = paged_get_row (model, sqliter->rowid);
+      if (sqliter->row < 0)
+        return NULL;
+    }
+  else if (sqliter->row < 0)
     {
-      sqliter->row = GPOINTER_TO_INT (
+      /* The index holds rows counted from 1 */
+      gint row = GPOINTER_TO_INT (
         g_hash_table_lookup (priv->rowid_to_row,
                              GINT_TO_POINTER (sqliter->rowid)));
 
-      if (!priv->complete && !sqliter->row)
+      if (!priv->complete && !row)
         {
           statement_next (model, TRUE, sqliter->rowid, -1);
-          sqliter->row = GPOINTER_TO_INT (
+          row = GPOINTER_TO_INT (
             g_hash_table_lookup (priv->rowid_to_row,
                                  GINT_TO_POINTER (sqliter->rowid)));
         }
       
-      if (!sqliter->row)
-        {
-          sqliter->row = -1;
-          return NULL;
-        }
+      if (!row)
+        return NULL;
+
+      sqliter->row = row - 1;
     }
   
   new_iter = clutter_sqlite_model_iter_new (model, sqliter->row + 1);
@@ -1108,3 +2470,360 @@ clutter_sqlite_model_iter_init (ClutterSqliteModelIter *iter)
 {
 }
 
+
+/* Returns the WHERE expression for the SQL filters, with a :fN parameter
+ * for each filter's value, or 1 if there are none.
+ */
+static gchar *
+filter_clause (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  GString                   *clause;
+  guint                      i;
+
+  if (priv->sql_filters->len == 0)
+    return g_strdup ("1");
+
+  clause = g_string_new (NULL);
+  for (i = 0; i < priv->sql_filters->len; i++)
+    {
+      ClutterSqliteFilter *filter =
+        &g_array_index (priv->sql_filters, ClutterSqliteFilter, i);
+
+      g_string_append_printf (clause, "%s%s %s :f%u",
+                              i ? " and " : "",
+                              priv->col_names[filter->column],
+                              sql_filter_ops[filter->op],
+                              i);
+    }
+
+  return g_string_free (clause, FALSE);
+}
+
+static void
+bind_filters (ClutterSqliteModel *model,
+              sqlite3_stmt       *statement)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  guint                      i;
+
+  for (i = 0; i < priv->sql_filters->len; i++)
+    {
+      ClutterSqliteFilter *filter =
+        &g_array_index (priv->sql_filters, ClutterSqliteFilter, i);
+      const GValue        *value = &filter->value;
+      gchar               *name;
+      gint                 index;
+
+      name = g_strdup_printf (":f%u", i);
+      index = sqlite3_bind_parameter_index (statement, name);
+      g_free (name);
+
+      if (!index)
+        continue;
+
+      if (!bind_value (statement, index, value))
+        {
+          g_warning ("Can't filter on a value of type '%s'",
+                     G_VALUE_TYPE_NAME (value));
+          sqlite3_bind_null (statement, index);
+        }
+    }
+}
+
+static gboolean
+prepare_page_statements (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  const gchar               *key;
+  gchar                     *filter;
+  gint                       i;
+
+  for (i = 0; i < N_SQL_PAGE_STATEMENTS; i++)
+    if (priv->page_statements[i])
+      {
+        sqlite3_finalize (priv->page_statements[i]);
+        priv->page_statements[i] = NULL;
+      }
+
+  key = (priv->page_key < 0) ? "rowid" : priv->col_names[priv->page_key];
+  filter = filter_clause (model);
+
+  for (i = 0; i < N_SQL_PAGE_STATEMENTS; i++)
+    {
+      gchar *text;
+
+      if (i == SQL_PAGE_COUNT)
+        text = g_strdup_printf (sql_page_statements[i], priv->table, filter);
+      else
+        text = g_strdup_printf (sql_page_statements[i],
+                                priv->table, key, filter);
+
+      if (sqlite3_prepare (priv->db,
+                           text,
+                           -1,
+                           &priv->page_statements[i],
+                           NULL) != SQLITE_OK)
+        {
+          g_warning ("Failed to prepare '%s': %s",
+                     text,
+                     sqlite3_errmsg (priv->db));
+          g_free (text);
+          g_free (filter);
+          return FALSE;
+        }
+
+      bind_filters (model, priv->page_statements[i]);
+      g_free (text);
+    }
+
+  g_free (filter);
+
+  return TRUE;
+}
+
+/* Rebuilds whichever statements the SQL sort and filters go into */
+static void
+update_sql (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv = model->priv;
+  sqlite3_stmt              *statement;
+  gchar                     *filter, *order, *text;
+  gint                       column;
+
+  if (priv->paged)
+    {
+      reset_statement (model);
+      priv->paged = prepare_page_statements (model);
+      g_signal_emit_by_name (model, "sort-changed");
+      return;
+    }
+
+  filter = priv->sql_filters->len ? filter_clause (model) : NULL;
+
+  column = (priv->model_sort_column >= 0) ?
+    priv->model_sort_column : priv->sql_sort_column;
+  if (column < 0)
+    order = g_strdup (priv->sql_sort_descending ? "rowid desc" : "rowid");
+  else
+    order = g_strdup_printf ("%s%s,rowid",
+                             priv->col_names[column],
+                             priv->sql_sort_descending ? " desc" : "");
+
+  text = g_strdup_printf (sql_select_statement,
+                          priv->table,
+                          filter ? " where " : "",
+                          filter ? filter : "",
+                          order);
+  g_free (filter);
+  g_free (order);
+
+  if (sqlite3_prepare (priv->db, text, -1, &statement, NULL) != SQLITE_OK)
+    {
+      g_warning ("Failed to prepare '%s': %s", text, sqlite3_errmsg (priv->db));
+      g_free (text);
+      return;
+    }
+  g_free (text);
+
+  bind_filters (model, statement);
+
+  /* Setting the statement drops the one we made before */
+  g_object_set (G_OBJECT (model), "statement", statement, NULL);
+  priv->own_statement = statement;
+}
+
+/**
+ * clutter_sqlite_model_set_paged:
+ * @model: a #ClutterSqliteModel
+ * @key_column: the column to order rows by, or %NULL for rowid order
+ * @page_size: the number of rows to fetch at once, or 0 to turn paging off
+ *
+ * Puts the model in paged mode, where it shows the rows of the table that
+ * pass the SQL filters, ordered by @key_column, and fetches them a page at
+ * a time around the ones asked for instead of stepping through the
+ * "statement" from the start. The number of rows comes from COUNT(*). For
+ * scrolling to be fast, @key_column should be indexed.
+ *
+ * A fetched page's rows go into the row cache, which holds 128 rows, so
+ * @page_size is clamped to that: a bigger page would push its own first
+ * rows out before they are read.
+ */
+void
+clutter_sqlite_model_set_paged (ClutterSqliteModel *model,
+                                const gchar        *key_column,
+                                guint               page_size)
+{
+  ClutterSqliteModelPrivate *priv;
+  gint                       i;
+
+  g_return_if_fail (CLUTTER_SQLITE_IS_MODEL (model));
+
+  priv = model->priv;
+
+  if (!priv->pages)
+    {
+      priv->pages = g_hash_table_new_full (NULL, NULL, NULL,
+                                           (GDestroyNotify) page_free);
+      priv->page_lru = g_queue_new ();
+    }
+
+  reset_statement (model);
+  priv->paged = FALSE;
+
+  if (page_size > 0)
+    {
+      priv->page_size = MIN (page_size, ROW_CACHE_SIZE);
+      priv->page_key = -1;
+      for (i = 0; key_column && (i < priv->n_columns); i++)
+        if (g_ascii_strcasecmp (key_column, priv->col_names[i]) == 0)
+          priv->page_key = i;
+
+      if (key_column && (priv->page_key < 0))
+        {
+          g_warning ("No column '%s' in the model", key_column);
+          return;
+        }
+
+      priv->paged = prepare_page_statements (model);
+    }
+
+  g_signal_emit_by_name (model, "sort-changed");
+}
+
+/**
+ * clutter_sqlite_model_set_sql_sort:
+ * @model: a #ClutterSqliteModel
+ * @column: the column to sort by, or -1 for rowid order
+ * @descending: whether to sort in descending order
+ *
+ * Sorts the model by having SQLite order the rows, so that an index on
+ * @column can be used. The model replaces its "statement" with one of its
+ * own, made from the sort and the filters added with
+ * clutter_sqlite_model_add_sql_filter(). Rows with equal values stay in
+ * rowid order.
+ *
+ * While the model uses this statement, clutter_model_set_sort() sorts on
+ * its column instead of @column, in the direction given here, and unsetting
+ * it goes back to @column. The sort function is never called.
+ *
+ * In paged mode the rows are always ordered by the key column.
+ */
+void
+clutter_sqlite_model_set_sql_sort (ClutterSqliteModel *model,
+                                   gint                column,
+                                   gboolean            descending)
+{
+  ClutterSqliteModelPrivate *priv;
+
+  g_return_if_fail (CLUTTER_SQLITE_IS_MODEL (model));
+
+  priv = model->priv;
+  g_return_if_fail (column < priv->n_columns);
+
+  priv->sql_sort_column = MAX (column, -1);
+  priv->sql_sort_descending = descending;
+
+  update_sql (model);
+}
+
+/**
+ * clutter_sqlite_model_add_sql_filter:
+ * @model: a #ClutterSqliteModel
+ * @column: the column to compare
+ * @op: how to compare it
+ * @value: the value to compare it with
+ *
+ * Leaves out the rows where @column doesn't compare with @value as @op
+ * says. The comparison is done by SQLite, with @value as a bound
+ * parameter, so it can use an index on @column. A row has to pass all the
+ * filters added to be in the model.
+ */
+void
+clutter_sqlite_model_add_sql_filter (ClutterSqliteModel    *model,
+                                     gint                   column,
+                                     ClutterSqliteFilterOp  op,
+                                     const GValue          *value)
+{
+  ClutterSqliteModelPrivate *priv;
+  ClutterSqliteFilter        filter = { 0, };
+
+  g_return_if_fail (CLUTTER_SQLITE_IS_MODEL (model));
+  g_return_if_fail (G_IS_VALUE (value));
+  g_return_if_fail (op < G_N_ELEMENTS (sql_filter_ops));
+
+  priv = model->priv;
+  g_return_if_fail ((column >= 0) && (column < priv->n_columns));
+
+  filter.column = column;
+  filter.op = op;
+  g_value_init (&filter.value, G_VALUE_TYPE (value));
+  g_value_copy (value, &filter.value);
+  g_array_append_val (priv->sql_filters, filter);
+
+  update_sql (model);
+}
+
+/**
+ * clutter_sqlite_model_clear_sql_filters:
+ * @model: a #ClutterSqliteModel
+ *
+ * Removes the filters added with clutter_sqlite_model_add_sql_filter().
+ */
+void
+clutter_sqlite_model_clear_sql_filters (ClutterSqliteModel *model)
+{
+  ClutterSqliteModelPrivate *priv;
+  guint                      i;
+
+  g_return_if_fail (CLUTTER_SQLITE_IS_MODEL (model));
+
+  priv = model->priv;
+
+  for (i = 0; i < priv->sql_filters->len; i++)
+    g_value_unset (&g_array_index (priv->sql_filters,
+                                   ClutterSqliteFilter, i).value);
+  g_array_set_size (priv->sql_filters, 0);
+
+  update_sql (model);
+}
+
+/**
+ * clutter_sqlite_model_set_async_writes:
+ * @model: a #ClutterSqliteModel
+ * @async_writes: whether to write from a separate thread
+ *
+ * Makes changing and removing rows through the model queue the writes for
+ * a thread with its own connection to the database, instead of waiting
+ * for them. The thread puts the writes it has queued in one transaction,
+ * and #ClutterSqliteModel::writes-done is emitted once the model has
+ * caught up with them. Values written are read back straight away, and
+ * removed rows leave the model straight away.
+ *
+ * Adding rows is still synchronous, as ClutterModel needs the new row,
+ * and so is removing rows in paged mode. These writes wait for the
+ * writer's transaction to be committed, which can block for up to two
+ * seconds if it has a lot queued.
+ *
+ * This needs a database file that can be put in WAL mode, and threads to
+ * be initialised; if the writer can't be started, writes stay
+ * synchronous. Turning it off waits for the queued writes.
+ */
+void
+clutter_sqlite_model_set_async_writes (ClutterSqliteModel *model,
+                                       gboolean            async_writes)
+{
+  ClutterSqliteModelPrivate *priv;
+
+  g_return_if_fail (CLUTTER_SQLITE_IS_MODEL (model));
+
+  priv = model->priv;
+
+  if (async_writes && !priv->writer)
+    priv->writer = writer_start (model);
+  else if (!async_writes && priv->writer)
+    {
+      writer_stop (priv->writer);
+      priv->writer = NULL;
+    }
+}
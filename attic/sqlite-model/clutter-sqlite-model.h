@@ -73,6 +73,17 @@ void               clutter_sqlite_intv_free (ClutterSqliteIntV       *intv);
   (G_TYPE_INSTANCE_GET_CLASS ((obj), \
   CLUTTER_SQLITE_TYPE_MODEL, ClutterSqliteModelClass))
 
+typedef enum
+{
+  CLUTTER_SQLITE_FILTER_EQUAL,
+  CLUTTER_SQLITE_FILTER_NOT_EQUAL,
+  CLUTTER_SQLITE_FILTER_LESS,
+  CLUTTER_SQLITE_FILTER_LESS_EQUAL,
+  CLUTTER_SQLITE_FILTER_GREATER,
+  CLUTTER_SQLITE_FILTER_GREATER_EQUAL,
+  CLUTTER_SQLITE_FILTER_LIKE
+} ClutterSqliteFilterOp;
+
 typedef struct _ClutterSqliteModel        ClutterSqliteModel;
 typedef struct _ClutterSqliteModelPrivate ClutterSqliteModelPrivate;
 typedef struct _ClutterSqliteModelClass   ClutterSqliteModelClass;
@@ -91,6 +102,24 @@ GType clutter_sqlite_model_get_type (void);
 
 ClutterModel *clutter_sqlite_model_new (sqlite3 *db, const gchar *table, ...);
 
+void clutter_sqlite_model_set_paged (ClutterSqliteModel *model,
+                                     const gchar        *key_column,
+                                     guint               page_size);
+
+void clutter_sqlite_model_set_sql_sort (ClutterSqliteModel *model,
+                                        gint                column,
+                                        gboolean            descending);
+
+void clutter_sqlite_model_add_sql_filter (ClutterSqliteModel    *model,
+                                          gint                   column,
+                                          ClutterSqliteFilterOp  op,
+                                          const GValue          *value);
+
+void clutter_sqlite_model_clear_sql_filters (ClutterSqliteModel *model);
+
+void clutter_sqlite_model_set_async_writes (ClutterSqliteModel *model,
+                                            gboolean            async_writes);
+
 G_END_DECLS
 
 #endif
@@ -0,0 +1,525 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+#include <glib/gstdio.h>
+#include <clutter/clutter.h>
+#include "clutter-sqlite-model.h"
+
+/* Non-interactive checks for ClutterSqliteModel, see test-sqlite-model.c
+ * for a demo.
+ */
+
+enum
+{
+  COLUMN_FOO,   /* SQLITE_INTEGER */
+  COLUMN_BAR,   /* SQLITE_TEXT */
+
+  N_COLUMNS
+};
+
+static sqlite3 *
+open_db (const gchar *file)
+{
+  sqlite3 *db;
+
+  if (sqlite3_open (file, &db))
+    g_error ("Error opening database: %s", sqlite3_errmsg (db));
+
+  if (sqlite3_exec (db,
+                    "create table mytable(foo int, bar text, extra int);",
+                    NULL, NULL, NULL))
+    g_error ("Can't create table: %s", sqlite3_errmsg (db));
+
+  return db;
+}
+
+static sqlite3_stmt *statement = NULL;
+
+static void
+set_query (ClutterModel *model, const gchar *query)
+{
+  sqlite3_stmt *old_stmt = statement;
+  sqlite3 *db;
+
+  g_object_get (G_OBJECT (model), "db", &db, NULL);
+  if (sqlite3_prepare (db, query, -1, &statement, NULL) != SQLITE_OK)
+    g_error ("Error preparing query: %s", sqlite3_errmsg (db));
+  g_object_set (G_OBJECT (model), "statement", statement, NULL);
+
+  if (old_stmt)
+    sqlite3_finalize (old_stmt);
+}
+
+/* The model doesn't finalize statements it's given */
+static void
+free_model (ClutterModel *model)
+{
+  g_object_unref (model);
+
+  if (statement)
+    sqlite3_finalize (statement);
+  statement = NULL;
+}
+
+static ClutterModel *
+make_model (sqlite3 *db, const gchar *query, gint n_rows)
+{
+  ClutterModel *model;
+  gint i;
+
+  model = clutter_sqlite_model_new (db, "mytable",
+                                    "foo", SQLITE_INTEGER,
+                                    "bar", SQLITE_TEXT,
+                                    NULL);
+  if (query)
+    set_query (model, query);
+
+  for (i = 0; i < n_rows; i++)
+    {
+      gchar *string = g_strdup_printf ("String %d", i);
+
+      clutter_model_append (model,
+                            COLUMN_FOO, i,
+                            COLUMN_BAR, string,
+                            -1);
+      g_free (string);
+    }
+
+  return model;
+}
+
+static void
+run_sql (sqlite3 *db, const gchar *sql)
+{
+  if (sqlite3_exec (db, sql, NULL, NULL, NULL) != SQLITE_OK)
+    g_error ("Error running '%s': %s", sql, sqlite3_errmsg (db));
+}
+
+static void
+compare_row (ClutterModel *model,
+             guint         row,
+             gint          expected_foo,
+             const gchar  *expected_bar)
+{
+  ClutterModelIter *iter;
+  gchar *bar = NULL;
+  gint foo = -1;
+
+  iter = clutter_model_get_iter_at_row (model, row);
+  g_assert (iter != NULL);
+
+  clutter_model_iter_get (iter, COLUMN_FOO, &foo, COLUMN_BAR, &bar, -1);
+  g_assert_cmpint (foo, ==, expected_foo);
+  g_assert_cmpstr (bar, ==, expected_bar);
+
+  g_free (bar);
+  g_object_unref (iter);
+}
+
+static void
+test_row_cache (void)
+{
+  ClutterModelIter *iter;
+  ClutterModel *model;
+  sqlite3 *db;
+  gchar *string;
+  gint i;
+
+  db = open_db (":memory:");
+
+  /* More rows than the cache holds, so that rows get dropped from it */
+  model = make_model (db, "select *,rowid from mytable;", 300);
+
+  for (i = 0; i < 300; i++)
+    {
+      string = g_strdup_printf ("String %d", i);
+      compare_row (model, i, i, string);
+      g_free (string);
+    }
+
+  if (g_test_verbose ())
+    g_print ("Writing through the model...\n");
+
+  iter = clutter_model_get_iter_at_row (model, 299);
+  clutter_model_iter_set (iter, COLUMN_BAR, "Changed", -1);
+  g_object_unref (iter);
+  compare_row (model, 299, 299, "Changed");
+
+  if (g_test_verbose ())
+    g_print ("Writing around the model...\n");
+
+  /* The model's connection, so the update hook sees it */
+  compare_row (model, 0, 0, "String 0");
+  run_sql (db, "update mytable set foo=-1 where rowid=1;");
+  compare_row (model, 0, -1, "String 0");
+
+  free_model (model);
+  sqlite3_close (db);
+}
+
+static void
+set_bar (ClutterModel *model,
+         guint         row,
+         const gchar  *bar)
+{
+  ClutterModelIter *iter;
+
+  iter = clutter_model_get_iter_at_row (model, row);
+  clutter_model_iter_set (iter, COLUMN_BAR, bar, -1);
+  g_object_unref (iter);
+}
+
+/* Each write below can change which rows the statement returns or their
+ * order, so the model has to notice, whether it patches its index or
+ * throws it away.
+ */
+static void
+test_index_updates (void)
+{
+  ClutterModel *model;
+  sqlite3 *db;
+
+  if (g_test_verbose ())
+    g_print ("Appending in rowid order...\n");
+
+  db = open_db (":memory:");
+  model = make_model (db, "select *,rowid from mytable;", 10);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 10);
+  clutter_model_append (model, COLUMN_FOO, 10, COLUMN_BAR, "String 10", -1);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 11);
+  compare_row (model, 10, 10, "String 10");
+  free_model (model);
+  sqlite3_close (db);
+
+  if (g_test_verbose ())
+    g_print ("Filtering on a column the model doesn't have...\n");
+
+  db = open_db (":memory:");
+  model = make_model (db, "select *,rowid from mytable where extra is null;",
+                      10);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 10);
+  run_sql (db, "update mytable set extra=1 where rowid=2;");
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 9);
+  compare_row (model, 1, 2, "String 2");
+  free_model (model);
+  sqlite3_close (db);
+
+  if (g_test_verbose ())
+    g_print ("Ordering by an alias...\n");
+
+  db = open_db (":memory:");
+  model = make_model (db, "select foo,bar as b,rowid from mytable order by b;",
+                      10);
+  compare_row (model, 0, 0, "String 0");
+  set_bar (model, 9, "A");
+  compare_row (model, 0, 9, "A");
+  free_model (model);
+  sqlite3_close (db);
+
+  if (g_test_verbose ())
+    g_print ("Ordering by position...\n");
+
+  db = open_db (":memory:");
+  model = make_model (db, "select *,rowid from mytable order by 2;", 10);
+  set_bar (model, 9, "A");
+  compare_row (model, 0, 9, "A");
+  free_model (model);
+  sqlite3_close (db);
+
+  if (g_test_verbose ())
+    g_print ("Filtering on a quoted column...\n");
+
+  db = open_db (":memory:");
+  model = make_model (db,
+                      "select *,rowid from mytable "
+                      "where \"bar\" != 'String 3';",
+                      10);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 9);
+  set_bar (model, 0, "String 3");
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 8);
+  compare_row (model, 0, 1, "String 1");
+  free_model (model);
+  sqlite3_close (db);
+}
+
+static gint
+get_foo (ClutterModelIter *iter)
+{
+  gint foo = -1;
+
+  clutter_model_iter_get (iter, COLUMN_FOO, &foo, -1);
+
+  return foo;
+}
+
+static void
+on_row_changed_next (ClutterModel     *model,
+                     ClutterModelIter *iter,
+                     gint             *next_foo)
+{
+  /* Moving the iterator unrefs it, and the model unrefs it after this */
+  iter = clutter_model_iter_next (g_object_ref (iter));
+  g_assert (iter != NULL);
+
+  *next_foo = get_foo (iter);
+  g_object_unref (iter);
+}
+
+/* Pages of 2, in bar order, with NULLs first and across page boundaries */
+static void
+test_paged (void)
+{
+  static const gint expected_foo[] = { 1, 3, 5, 2, 6, 0, 7, 4 };
+  ClutterModelIter *iter;
+  ClutterModel *model;
+  sqlite3 *db;
+  gint i, next_foo = -1;
+
+  db = open_db (":memory:");
+  model = make_model (db, NULL, 0);
+  clutter_sqlite_model_set_paged (CLUTTER_SQLITE_MODEL (model), "bar", 2);
+
+  run_sql (db,
+           "insert into mytable(foo,bar) values(0,'b');"
+           "insert into mytable(foo,bar) values(1,NULL);"
+           "insert into mytable(foo,bar) values(2,'a');"
+           "insert into mytable(foo,bar) values(3,NULL);"
+           "insert into mytable(foo,bar) values(4,'c');"
+           "insert into mytable(foo,bar) values(5,NULL);"
+           "insert into mytable(foo,bar) values(6,'a');"
+           "insert into mytable(foo,bar) values(7,'b');");
+
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 8);
+
+  if (g_test_verbose ())
+    g_print ("Paging forwards...\n");
+
+  iter = clutter_model_get_first_iter (model);
+  i = 0;
+  while (!clutter_model_iter_is_last (iter))
+    {
+      g_assert_cmpint (i, <, 8);
+      g_assert_cmpint (get_foo (iter), ==, expected_foo[i]);
+
+      iter = clutter_model_iter_next (iter);
+      i += 1;
+    }
+  g_assert_cmpint (i, ==, 8);
+  g_object_unref (iter);
+
+  if (g_test_verbose ())
+    g_print ("Paging backwards...\n");
+
+  /* Turning paging back on drops the pages, so the last one is fetched
+   * by offset and the others from the first key of the one after.
+   */
+  clutter_sqlite_model_set_paged (CLUTTER_SQLITE_MODEL (model), "bar", 2);
+
+  for (i = 7; i >= 0; i--)
+    {
+      iter = clutter_model_get_iter_at_row (model, i);
+      g_assert_cmpint (get_foo (iter), ==, expected_foo[i]);
+      g_object_unref (iter);
+    }
+
+  if (g_test_verbose ())
+    g_print ("Moving an iterator made from a rowid...\n");
+
+  g_signal_connect (model, "row-changed",
+                    G_CALLBACK (on_row_changed_next), &next_foo);
+  run_sql (db, "update mytable set foo=50 where foo=5;");
+  g_assert_cmpint (next_foo, ==, 2);
+
+  free_model (model);
+  sqlite3_close (db);
+}
+
+static gint
+sort_bar (ClutterModel *model,
+          const GValue *a,
+          const GValue *b,
+          gpointer      data)
+{
+  return strcmp (g_value_get_string (a), g_value_get_string (b));
+}
+
+static void
+test_sql_sort (void)
+{
+  ClutterSqliteModel *sqlite_model;
+  ClutterModel *model;
+  GValue value = { 0, };
+  sqlite3 *db;
+
+  db = open_db (":memory:");
+  model = make_model (db, NULL, 10);
+  sqlite_model = CLUTTER_SQLITE_MODEL (model);
+
+  if (g_test_verbose ())
+    g_print ("Sorting in SQL...\n");
+
+  clutter_sqlite_model_set_sql_sort (sqlite_model, COLUMN_FOO, TRUE);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 10);
+  compare_row (model, 0, 9, "String 9");
+
+  if (g_test_verbose ())
+    g_print ("Filtering in SQL...\n");
+
+  g_value_init (&value, G_TYPE_INT);
+  g_value_set_int (&value, 5);
+  clutter_sqlite_model_add_sql_filter (sqlite_model, COLUMN_FOO,
+                                       CLUTTER_SQLITE_FILTER_GREATER_EQUAL,
+                                       &value);
+  g_value_unset (&value);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 5);
+  compare_row (model, 4, 5, "String 5");
+
+  clutter_sqlite_model_clear_sql_filters (sqlite_model);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 10);
+
+  if (g_test_verbose ())
+    g_print ("Appending in rowid order...\n");
+
+  clutter_sqlite_model_set_sql_sort (sqlite_model, -1, FALSE);
+  clutter_model_append (model, COLUMN_FOO, 10, COLUMN_BAR, "String 10", -1);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 11);
+  compare_row (model, 10, 10, "String 10");
+
+  if (g_test_verbose ())
+    g_print ("Sorting through ClutterModel...\n");
+
+  clutter_model_set_sort (model, COLUMN_BAR, sort_bar, NULL, NULL);
+  compare_row (model, 2, 10, "String 10");
+  set_bar (model, 0, "Z");
+  compare_row (model, 10, 0, "Z");
+
+  /* The direction is still the one set_sql_sort() was given. */
+  clutter_sqlite_model_set_sql_sort (sqlite_model, -1, TRUE);
+  compare_row (model, 0, 0, "Z");
+  compare_row (model, 10, 1, "String 1");
+
+  clutter_model_set_sort (model, -1, NULL, NULL, NULL);
+  compare_row (model, 0, 10, "String 10");
+
+  g_object_unref (model);
+
+  if (g_test_verbose ())
+    g_print ("Sorting a statement of our own...\n");
+
+  /* A statement set from outside keeps its WHERE and ORDER BY. */
+  model = make_model (db, "select *,rowid from mytable "
+                          "where foo < 5 order by foo desc;", 0);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 5);
+  compare_row (model, 0, 4, "String 4");
+
+  clutter_model_set_sort (model, COLUMN_BAR, sort_bar, NULL, NULL);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 5);
+  compare_row (model, 0, 4, "String 4");
+
+  clutter_model_set_sort (model, -1, NULL, NULL, NULL);
+  compare_row (model, 0, 4, "String 4");
+
+  free_model (model);
+  sqlite3_close (db);
+}
+
+static gint
+count_rows (sqlite3 *db)
+{
+  sqlite3_stmt *count;
+  gint n_rows = -1;
+
+  sqlite3_prepare (db, "select count(*) from mytable;", -1, &count, NULL);
+  if (sqlite3_step (count) == SQLITE_ROW)
+    n_rows = sqlite3_column_int (count, 0);
+  sqlite3_finalize (count);
+
+  return n_rows;
+}
+
+static void
+remove_db (const gchar *file)
+{
+  gchar *path;
+
+  g_remove (file);
+
+  path = g_strconcat (file, "-wal", NULL);
+  g_remove (path);
+  g_free (path);
+
+  path = g_strconcat (file, "-shm", NULL);
+  g_remove (path);
+  g_free (path);
+}
+
+static void
+test_async_remove (void)
+{
+  ClutterModel *model;
+  sqlite3 *db;
+  gchar *file;
+  guint n_rows;
+
+  file = g_build_filename (g_get_tmp_dir (), "sqlite-model-test.db", NULL);
+  remove_db (file);
+
+  db = open_db (file);
+  model = make_model (db, "select *,rowid from mytable order by foo desc;",
+                      10);
+  clutter_sqlite_model_set_async_writes (CLUTTER_SQLITE_MODEL (model), TRUE);
+
+  if (g_test_verbose ())
+    g_print ("Removing rows asynchronously...\n");
+
+  /* Removed rows leave the model before the writer gets to them */
+  clutter_model_remove (model, 0);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 9);
+  compare_row (model, 0, 8, "String 8");
+
+  clutter_model_remove (model, 0);
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 8);
+  compare_row (model, 0, 7, "String 7");
+
+  /* Nor do they come back when the index is thrown away */
+  run_sql (db, "update mytable set extra=1;");
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 8);
+  compare_row (model, 0, 7, "String 7");
+
+  n_rows = 8;
+  while (clutter_model_get_n_rows (model))
+    {
+      clutter_model_remove (model, 0);
+      g_assert_cmpint (clutter_model_get_n_rows (model), ==, --n_rows);
+    }
+
+  /* Wait for the writer, then let the model catch up with it */
+  clutter_sqlite_model_set_async_writes (CLUTTER_SQLITE_MODEL (model), FALSE);
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  g_assert_cmpint (clutter_model_get_n_rows (model), ==, 0);
+  g_assert_cmpint (count_rows (db), ==, 0);
+
+  free_model (model);
+  sqlite3_close (db);
+
+  remove_db (file);
+  g_free (file);
+}
+
+int
+main (int     argc,
+      char  **argv)
+{
+  g_thread_init (NULL);
+  g_type_init ();
+
+  test_row_cache ();
+  test_index_updates ();
+  test_paged ();
+  test_sql_sort ();
+  test_async_remove ();
+
+  return EXIT_SUCCESS;
+}
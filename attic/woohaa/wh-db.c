@@ -22,20 +22,91 @@ G_DEFINE_TYPE (WHDB, wh_db, G_TYPE_OBJECT);
 
 typedef struct _WHDBPrivate WHDBPrivate;
 
+/* Found files are committed in batches of at most this many files, or
+ * however many were found in this many seconds.
+ */
+#define IMPORT_BATCH_SIZE 256
+#define IMPORT_BATCH_TIME 0.5
+
+/* How long to wait for the other connection's lock, in milliseconds */
+#define DB_BUSY_TIMEOUT 2000
+
+/* Thumbnails are kept out of the meta table, so that reading the library
+ * doesn't read them. They're loaded when a row is first shown.
+ */
+enum
+  {
+    THUMBNAIL_PIXDATA = 0,   /* Serialised GdkPixdata, from older versions */
+    THUMBNAIL_IMAGE          /* JPEG or PNG */
+  };
+
+/* Main thread statements */
+enum 
+  {
+    SQL_GET_ACTIVE_ROWS = 0,
+    SQL_UPDATE_ROW,
+    SQL_GET_THUMBNAIL,
+    SQL_SET_THUMBNAIL,
+    N_SQL_STATEMENTS
+  };
+
+static gchar *SQLStatementText[] = 
+  {
+    "select path, n_views, vtime, mtime from meta where active=1;",
+    "update meta set n_views=:n_views, vtime=:vtime where path=:path;",
+    "select format, data from thumbnails where path=:path;",
+    "insert or replace into thumbnails(path, format, data) "
+    "            values(:path, :format, :data);"
+  };
+
+static sqlite3_stmt *SQLStatements[N_SQL_STATEMENTS];
+
+/* Import thread statements */
+enum
+  {
+    SQL_IMPORT_UPSERT = 0,
+    SQL_IMPORT_GET_ROW_VIA_PATH,
+    N_SQL_IMPORT_STATEMENTS
+  };
+
+static gchar *SQLImportStatementText[] =
+  {
+    "insert into meta(path, n_views, active, vtime, mtime, thumbnail)"
+    "           values(:path, 0, 1, 0, :mtime, 0)"
+    "           on conflict(path) do update set active=1, mtime=:mtime;",
+    "select n_views, vtime, mtime, "
+    "       exists(select 1 from thumbnails where path=:path) "
+    "            from meta where path=:path;"
+  };
+
+/* The main thread and the import thread each have their own connection,
+ * with its own statements. Only one import runs at a time, so the import
+ * connection is only ever used by one thread.
+ */
 struct _WHDBPrivate
 {
   sqlite3 *db;
   
   GThreadPool *thread_pool;
+
+  sqlite3      *import_db;
+  sqlite3_stmt *import_statements[N_SQL_IMPORT_STATEMENTS];
+  GPtrArray    *import_rows;   /* Found since the last commit */
+  GTimer       *import_timer;
 };
 
 typedef struct
 {
   WHDB *db;
   gchar *uri;
-  GnomeVFSFileInfo *vfs_info;
 } WHDBThreadData;
 
+typedef struct
+{
+  WHDB      *db;
+  GPtrArray *rows;
+} WHDBImportBatch;
+
 enum
 {
   ROW_CREATED,
@@ -48,30 +119,18 @@ static guint _db_signals[LAST_SIGNAL] = { 0 };
 #define SQL_CREATE_TABLES \
  "CREATE TABLE IF NOT EXISTS meta(path text, n_views int, active int, " \
  "                  vtime integer, mtime integer, thumbnail blob, "      \
- "                  primary key (path), unique(path));" 
-
-enum 
-  {
-    SQL_GET_ROW_VIA_PATH = 0,
-    SQL_SET_ACTIVE_VIA_PATH,
-    SQL_ADD_NEW_ROW,
-    SQL_GET_ACTIVE_ROWS,
-    SQL_UPDATE_ROW,
-    N_SQL_STATEMENTS
-  };
-
-static gchar *SQLStatementText[] = 
-  {
-    "select n_views, vtime, mtime, thumbnail from meta where path=:path;",
-    "update meta set active=1, mtime=:mtime where path=:path;",
-    "insert into meta(path, n_views, active, vtime, mtime, thumbnail)"
-    "           values(:path, 0, 1, 0, :mtime, 0);",
-    "select path, n_views, vtime, mtime, thumbnail from meta where active=1;",
-    "update meta set thumbnail=:thumbnail, n_views=:n_views, vtime=:vtime "
-    "            where path=:path;"
-  };
-
-static sqlite3_stmt *SQLStatements[N_SQL_STATEMENTS];
+ "                  primary key (path), unique(path));"                  \
+ "CREATE TABLE IF NOT EXISTS thumbnails(path text primary key, "         \
+ "                  format int, data blob);"
+
+/* Moves thumbnails stored by older versions out of meta */
+#define SQL_MOVE_THUMBNAILS \
+ "begin;"                                                                \
+ "insert or ignore into thumbnails(path, format, data) "                 \
+ "       select path, 0, thumbnail from meta "                           \
+ "       where typeof(thumbnail)='blob';"                                \
+ "update meta set thumbnail=null where thumbnail is not null;"           \
+ "commit;"
 
 static gboolean
 wh_db_walk_directory (WHDB *db, const gchar *uri);
@@ -81,6 +140,12 @@ wh_db_media_file_found (WHDB                    *db,
 			const char              *uri,
 			GnomeVFSFileInfo        *vfs_info);
 
+static void
+wh_db_import_commit (WHDB *db);
+
+static void
+wh_db_import_check_batch (WHDB *db);
+
 static void 
 on_vfs_monitor_event (GnomeVFSMonitorHandle   *handle,
 		      const gchar             *monitor_uri,
@@ -130,6 +195,17 @@ wh_db_dispose (GObject *object)
 static void
 wh_db_finalize (GObject *object)
 {
+  WHDBPrivate *priv = DB_PRIVATE (object);
+  gint         i;
+
+  for (i=0; i<N_SQL_IMPORT_STATEMENTS; i++)
+    if (priv->import_statements[i])
+      sqlite3_finalize (priv->import_statements[i]);
+  sqlite3_close (priv->import_db);
+
+  g_ptr_array_free (priv->import_rows, TRUE);
+  g_timer_destroy (priv->import_timer);
+
   G_OBJECT_CLASS (wh_db_parent_class)->finalize (object);
 }
 
@@ -173,9 +249,6 @@ wh_db_init (WHDB *self)
   
   res = sqlite3_open(db_filename, &priv->db);
 
-  g_free(path); 
-  g_free(db_filename);
-
   if (res)
     {
       g_error("Can't open database: %s\n", sqlite3_errmsg(priv->db));
@@ -183,10 +256,20 @@ wh_db_init (WHDB *self)
       return;
     }
 
+  /* Let the main thread read while an import is writing */
+  sqlite3_busy_timeout (priv->db, DB_BUSY_TIMEOUT);
+  sqlite3_exec (priv->db, "pragma journal_mode=wal;", NULL, NULL, NULL);
+
   /* Create DB if not already existing - preexisting will silently fail */
   if (sqlite3_exec(priv->db, SQL_CREATE_TABLES, NULL, NULL, NULL))
     g_warning("Can't create table: %s\n", sqlite3_errmsg(priv->db));
   
+  if (sqlite3_exec(priv->db, SQL_MOVE_THUMBNAILS, NULL, NULL, NULL))
+    {
+      g_warning("Can't move thumbnails: %s\n", sqlite3_errmsg(priv->db));
+      sqlite3_exec(priv->db, "rollback;", NULL, NULL, NULL);
+    }
+
   /* Next mark fields inactive */
   if (sqlite3_exec(priv->db, "update meta set active=0;", NULL, NULL, NULL))
     g_warning("Can't mark table inactive: %s\n", sqlite3_errmsg(priv->db));
@@ -197,11 +280,42 @@ wh_db_init (WHDB *self)
 			&SQLStatements[i], NULL) != SQLITE_OK)
       g_warning("Failed to prepare '%s' : %s", 
 		SQLStatementText[i], sqlite3_errmsg(priv->db));
+
+  priv->import_rows = g_ptr_array_new ();
+  priv->import_timer = g_timer_new ();
+
+  /* And the connection for the import thread. Without it there's nothing
+   * for the thread to import with, so importing is off.
+   */
+  res = sqlite3_open(db_filename, &priv->import_db);
+
+  g_free(path); 
+  g_free(db_filename);
+
+  if (res)
+    {
+      g_warning("Can't open database for import: %s\n",
+                sqlite3_errmsg(priv->import_db));
+      sqlite3_close(priv->import_db);
+      priv->import_db = NULL;
+      return;
+    }
+
+  sqlite3_busy_timeout (priv->import_db, DB_BUSY_TIMEOUT);
+
+  for (i=0; i<N_SQL_IMPORT_STATEMENTS; i++)
+    if (sqlite3_prepare(priv->import_db, SQLImportStatementText[i], -1,
+			&priv->import_statements[i], NULL) != SQLITE_OK)
+      g_warning("Failed to prepare '%s' : %s",
+		SQLImportStatementText[i], sqlite3_errmsg(priv->import_db));
   
-  /* Create thread pool for indexing */
+  /* Create thread pool for indexing. It's limited to one thread, as the
+   * walk is mostly waiting on the disk anyway and it gets the import
+   * connection to itself.
+   */
   priv->thread_pool = g_thread_pool_new ((GFunc)wh_db_import_uri_func,
                                          self,
-                                         -1,
+                                         1,
                                          FALSE,
                                          NULL);
 }
@@ -246,14 +360,20 @@ wh_db_monitor_add_idle (WHDBThreadData *data)
 }
 
 static gboolean
-wh_db_media_file_found_idle (WHDBThreadData *data)
+wh_db_import_batch_idle (WHDBImportBatch *batch)
 {
-  wh_db_media_file_found (data->db, data->uri, data->vfs_info); 
+  guint i;
 
- if (data->vfs_info)
-    gnome_vfs_file_info_unref (data->vfs_info);
-  g_free (data->uri);
-  g_slice_free (WHDBThreadData, data);
+  for (i = 0; i < batch->rows->len; i++)
+    {
+      WHVideoModelRow *row = g_ptr_array_index (batch->rows, i);
+
+      g_signal_emit (batch->db, _db_signals[ROW_CREATED], 0, row);
+      g_object_unref (row);
+    }
+
+  g_ptr_array_free (batch->rows, TRUE);
+  g_slice_free (WHDBImportBatch, batch);
   
   return FALSE;
 }
@@ -301,18 +421,7 @@ wh_db_import_uri_private (WHDB *db, const gchar *uri)
   else if (vfs_info->type == GNOME_VFS_FILE_TYPE_REGULAR)
     {
       if (uri_is_media(uri))
-        {
-          WHDBThreadData *data;
-          
-          data = g_slice_new0 (WHDBThreadData);
-          data->uri = g_strdup (uri);
-          data->db = db;
-          data->vfs_info = vfs_info;
-          
-          g_idle_add ((GSourceFunc)wh_db_media_file_found_idle, data);
-          
-          goto skip_cleanup;
-        }
+        wh_db_media_file_found (db, uri, vfs_info);
 
       ret = TRUE;
     }
@@ -322,8 +431,6 @@ wh_db_import_uri_private (WHDB *db, const gchar *uri)
   if (vfs_info)
     gnome_vfs_file_info_unref (vfs_info);
   
-  skip_cleanup:
-  
   return ret;
 }
 
@@ -363,6 +470,8 @@ wh_db_walk_directory (WHDB *db, const gchar *uri)
 	      ret |= wh_db_import_uri_private (db, entry_uri); 
 	      g_free(entry_uri);
 	    }
+
+	  wh_db_import_check_batch (db);
 	}
     }
 
@@ -380,18 +489,69 @@ static void
 wh_db_import_uri_func (gchar *uri, WHDB *db)
 {
   wh_db_import_uri_private (db, uri);
+  wh_db_import_commit (db);
   g_free (uri);
 }
 
+/* Commits the files found so far, and hands their rows to the main
+ * thread once they're in the database. If the commit fails the batch is
+ * rolled back and its rows dropped.
+ */
+static void
+wh_db_import_commit (WHDB *db)
+{
+  WHDBPrivate     *priv = DB_PRIVATE (db);
+  WHDBImportBatch *batch;
+  guint            i;
+
+  if (priv->import_rows->len == 0)
+    return;
+
+  if (sqlite3_exec (priv->import_db, "commit;", NULL, NULL, NULL))
+    {
+      g_warning ("Can't commit imported files: %s\n",
+                 sqlite3_errmsg (priv->import_db));
+      sqlite3_exec (priv->import_db, "rollback;", NULL, NULL, NULL);
+
+      for (i = 0; i < priv->import_rows->len; i++)
+        g_object_unref (g_ptr_array_index (priv->import_rows, i));
+      g_ptr_array_set_size (priv->import_rows, 0);
+
+      return;
+    }
+
+  batch = g_slice_new (WHDBImportBatch);
+  batch->db = db;
+  batch->rows = priv->import_rows;
+  g_idle_add ((GSourceFunc)wh_db_import_batch_idle, batch);
+
+  priv->import_rows = g_ptr_array_new ();
+}
+
+/* Commits the open batch if it's full or has been open too long. The walk
+ * calls this for every entry too, so that a long stretch without media
+ * files doesn't keep the transaction open.
+ */
+static void
+wh_db_import_check_batch (WHDB *db)
+{
+  WHDBPrivate *priv = DB_PRIVATE (db);
+
+  if (priv->import_rows->len >= IMPORT_BATCH_SIZE
+      || (priv->import_rows->len > 0
+	  && g_timer_elapsed (priv->import_timer, NULL) >= IMPORT_BATCH_TIME))
+    wh_db_import_commit (db);
+}
+
 static gboolean 
-wh_db_get_uri (const gchar *uri, 
-	       gint        *n_views, 
-	       gint        *vtime, 
-	       gint        *mtime,
-	       GdkPixbuf  **thumb)
+wh_db_get_uri (sqlite3_stmt *stmt,
+	       const gchar  *uri, 
+	       gint         *n_views, 
+	       gint         *vtime, 
+	       gint         *mtime,
+	       gboolean     *has_thumb)
 {
   gboolean      res = FALSE;
-  sqlite3_stmt *stmt = SQLStatements[SQL_GET_ROW_VIA_PATH];
   
   sqlite3_bind_text (stmt, 1, uri, -1, SQLITE_STATIC);
 
@@ -404,26 +564,8 @@ wh_db_get_uri (const gchar *uri,
       if (mtime)
 	*mtime = sqlite3_column_int(stmt, 2);
 
-      if (thumb)
-	{
-	  int         len;
-	  GdkPixdata *pixdata;
-	  guint8 *blob = NULL;
-
-	  blob = (guint8 *)sqlite3_column_blob (stmt, 3);
-	  len  = sqlite3_column_bytes (stmt, 3);
-
-	  if (sqlite3_column_type (stmt,3) == SQLITE_BLOB)
-	    {
-	      pixdata = g_new0 (GdkPixdata, 1);
-
-	      if (gdk_pixdata_deserialize (pixdata, len, (const guint8*)blob, 
-					   NULL))
-		*thumb = gdk_pixbuf_from_pixdata (pixdata, TRUE, NULL);
-
-	      g_free (pixdata);
-	    }
-	}
+      if (has_thumb)
+	*has_thumb = sqlite3_column_int(stmt, 3);
       res = TRUE;
     }
 
@@ -505,48 +647,47 @@ wh_db_parse_video_uri_info (const char *uri,
   return res;
 }
 
+/* Called in the import thread, see wh_db_import_commit() for when the
+ * row gets to the main thread.
+ */
 static void
 wh_db_media_file_found (WHDB                    *db, 
 			const char              *uri,
 			GnomeVFSFileInfo        *vfs_info)
 {
+  WHDBPrivate     *priv = DB_PRIVATE (db);
   WHVideoModelRow *row;
+  sqlite3_stmt    *stmt;
   gchar           *title, *episode = NULL, *series = NULL;
   gint             n_views = 0, mtime = 0, vtime = 0;  
-  GdkPixbuf       *thumb = NULL;
+  gboolean         has_thumb = FALSE;
 
-  /* See if we already have file in db.
-   *  YES - mark active.
-   *  NO  - add it set vtime, n_views to 0 etc
-  */
-  if (wh_db_get_uri (uri, &n_views, &vtime, &mtime, &thumb))
+  /* Without a transaction the file is skipped; the next one tries again */
+  if (priv->import_rows->len == 0)
     {
-      /* Update  */
-      if (vfs_info->valid_fields & GNOME_VFS_FILE_INFO_FIELDS_MTIME)
-	mtime = vfs_info->mtime;
-
-      sqlite3_stmt *stmt = SQLStatements[SQL_SET_ACTIVE_VIA_PATH];
+      if (sqlite3_exec (priv->import_db, "begin;", NULL, NULL, NULL))
+        {
+          g_warning ("Can't start importing '%s': %s\n",
+                     uri, sqlite3_errmsg (priv->import_db));
+          return;
+        }
+      g_timer_start (priv->import_timer);
+    }
 
-      sqlite3_bind_int (stmt, 1, mtime);
-      sqlite3_bind_text (stmt, 2, uri, -1, SQLITE_STATIC);
+  /* Add the file, or mark it active again if we already had it */
+  if (vfs_info->valid_fields & GNOME_VFS_FILE_INFO_FIELDS_MTIME)
+    mtime = vfs_info->mtime;
 
-      sqlite3_step(stmt);
-      sqlite3_reset(stmt);
-    }
-  else
-    {
-      /* New - create row entry*/
-      if (vfs_info->valid_fields & GNOME_VFS_FILE_INFO_FIELDS_MTIME)
-	mtime = vfs_info->mtime;
+  stmt = priv->import_statements[SQL_IMPORT_UPSERT];
+  sqlite3_bind_text (stmt, 1, uri, -1, SQLITE_STATIC);
+  sqlite3_bind_int (stmt, 2, mtime);
 
-      sqlite3_stmt *stmt = SQLStatements[SQL_ADD_NEW_ROW];
-  
-      sqlite3_bind_text (stmt, 1, uri, -1, SQLITE_STATIC);
-      sqlite3_bind_int (stmt, 2, mtime); /* mtime */
+  if (sqlite3_step(stmt) != SQLITE_DONE)
+    g_warning ("Can't add '%s': %s\n", uri, sqlite3_errmsg (priv->import_db));
+  sqlite3_reset(stmt);
 
-      sqlite3_step(stmt);
-      sqlite3_reset(stmt);
-    }
+  wh_db_get_uri (priv->import_statements[SQL_IMPORT_GET_ROW_VIA_PATH],
+                 uri, &n_views, &vtime, &mtime, &has_thumb);
 
   row = wh_video_model_row_new ();
   wh_video_model_row_set_path (row, uri);
@@ -560,57 +701,134 @@ wh_db_media_file_found (WHDB                    *db,
 
   g_free(title);
 
-  if (thumb)
-    {
-      wh_video_model_row_set_thumbnail (row, thumb);
-      g_object_unref (thumb);
-    }
+  wh_video_model_row_set_thumbnail_stored (row, has_thumb);
 
   wh_video_model_row_set_n_views (row, n_views);
   wh_video_model_row_set_age (row, mtime);
   wh_video_model_row_set_vtime (row, vtime);
 
-  g_signal_emit (db, _db_signals[ROW_CREATED], 0, row);
+  g_ptr_array_add (priv->import_rows, row);
 
-  g_object_unref (row);
+  wh_db_import_check_batch (db);
 }
 
 void
 wh_db_sync_row (WHVideoModelRow *row)
 {
-  GdkPixdata   *pixdata = NULL;
-  GdkPixbuf    *pixbuf = NULL;
-  guint8       *data = NULL;
   sqlite3_stmt *stmt = SQLStatements[SQL_UPDATE_ROW];
 
-  sqlite3_bind_int (stmt, 2, wh_video_model_row_get_n_views (row));
-  sqlite3_bind_int (stmt, 3, wh_video_model_row_get_vtime (row));
+  sqlite3_bind_int (stmt, 1, wh_video_model_row_get_n_views (row));
+  sqlite3_bind_int (stmt, 2, wh_video_model_row_get_vtime (row));
+  sqlite3_bind_text (stmt, 3, wh_video_model_row_get_path (row), 
+		     -1, SQLITE_STATIC);
+
+  sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+}
 
-  pixbuf = wh_video_model_row_get_thumbnail (row);
+static GdkPixbuf*
+wh_db_decode_thumbnail (gint format, const guint8 *data, gint len)
+{
+  GdkPixbuf       *pixbuf = NULL;
+  GdkPixbufLoader *loader;
+
+  if (format == THUMBNAIL_PIXDATA)
+    {
+      GdkPixdata pixdata;
+
+      if (gdk_pixdata_deserialize (&pixdata, len, data, NULL))
+	pixbuf = gdk_pixbuf_from_pixdata (&pixdata, TRUE, NULL);
+
+      return pixbuf;
+    }
+
+  loader = gdk_pixbuf_loader_new ();
 
-  if (pixbuf)
+  if (gdk_pixbuf_loader_write (loader, data, len, NULL)
+      && gdk_pixbuf_loader_close (loader, NULL))
     {
-      guint       len = 0;
+      pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+      if (pixbuf)
+	g_object_ref (pixbuf);
+    }
+  else
+    gdk_pixbuf_loader_close (loader, NULL);
+
+  g_object_unref (loader);
+
+  return pixbuf;
+}
+
+/* Reads the row's thumbnail from the database, returns FALSE if it has
+ * none or it can't be read.
+ */
+gboolean
+wh_db_load_thumbnail (WHVideoModelRow *row)
+{
+  sqlite3_stmt *stmt = SQLStatements[SQL_GET_THUMBNAIL];
+  GdkPixbuf    *pixbuf = NULL;
 
-      pixdata = g_new0 (GdkPixdata, 1);
-      gdk_pixdata_from_pixbuf (pixdata, pixbuf, FALSE);
+  sqlite3_bind_text (stmt, 1, wh_video_model_row_get_path (row),
+		     -1, SQLITE_STATIC);
 
-      data = gdk_pixdata_serialize (pixdata, &len);
+  if (sqlite3_step(stmt) == SQLITE_ROW
+      && sqlite3_column_type (stmt, 1) == SQLITE_BLOB)
+    pixbuf = wh_db_decode_thumbnail (sqlite3_column_int (stmt, 0),
+				     sqlite3_column_blob (stmt, 1),
+				     sqlite3_column_bytes (stmt, 1));
 
-      sqlite3_bind_blob(stmt, 1, (void*)data, len, SQLITE_STATIC);
+  sqlite3_reset(stmt);
+
+  if (pixbuf == NULL)
+    {
+      wh_video_model_row_set_thumbnail_stored (row, FALSE);
+      return FALSE;
     }
+
+  wh_video_model_row_set_thumbnail (row, pixbuf);
+  g_object_unref (pixbuf);
+
+  return TRUE;
+}
+
+/* Saves the row's thumbnail compressed, as JPEG unless it needs the
+ * alpha channel.
+ */
+void
+wh_db_store_thumbnail (WHVideoModelRow *row)
+{
+  sqlite3_stmt *stmt = SQLStatements[SQL_SET_THUMBNAIL];
+  GdkPixbuf    *pixbuf;
+  gchar        *data = NULL;
+  gsize         len = 0;
+  gboolean      res;
+
+  pixbuf = wh_video_model_row_get_thumbnail (row);
+  if (pixbuf == NULL)
+    return;
+
+  if (gdk_pixbuf_get_has_alpha (pixbuf))
+    res = gdk_pixbuf_save_to_buffer (pixbuf, &data, &len, "png", NULL, NULL);
   else
+    res = gdk_pixbuf_save_to_buffer (pixbuf, &data, &len, "jpeg", NULL,
+				     "quality", "85", NULL);
+
+  if (!res)
     {
-      sqlite3_bind_null(stmt, 1);
+      g_warning ("Can't compress thumbnail of '%s'",
+		 wh_video_model_row_get_path (row));
+      return;
     }
 
-  sqlite3_bind_text (stmt, 4, wh_video_model_row_get_path (row), 
+  sqlite3_bind_text (stmt, 1, wh_video_model_row_get_path (row),
 		     -1, SQLITE_STATIC);
+  sqlite3_bind_int (stmt, 2, THUMBNAIL_IMAGE);
+  sqlite3_bind_blob (stmt, 3, data, len, SQLITE_STATIC);
 
-  sqlite3_step(stmt);
+  if (sqlite3_step(stmt) == SQLITE_DONE)
+    wh_video_model_row_set_thumbnail_stored (row, TRUE);
   sqlite3_reset(stmt);
 
-  g_free (pixdata);
   g_free (data);
 }
 
@@ -623,9 +841,10 @@ on_vfs_monitor_event (GnomeVFSMonitorHandle   *handle,
 {
   WHDB *db = (WHDB*)user_data;
 
+  /* The import connection belongs to the import thread */
   if (event_type == GNOME_VFS_MONITOR_EVENT_CREATED)
     {
-      wh_db_import_uri_private (db, info_uri);
+      wh_db_import_uri (db, info_uri);
       return;
     }
 
@@ -641,8 +860,10 @@ wh_db_import_uri (WHDB *db, const gchar *uri)
 {
   WHDBPrivate *priv = DB_PRIVATE (db);
   
-  if (priv->thread_pool)
-    g_thread_pool_push (priv->thread_pool, g_strdup (uri), NULL);
+  if (!priv->thread_pool)
+    return FALSE;
+
+  g_thread_pool_push (priv->thread_pool, g_strdup (uri), NULL);
   
   return TRUE;
 }
@@ -49,6 +49,12 @@ wh_db_import_uri (WHDB *db, const gchar *path);
 void
 wh_db_sync_row (WHVideoModelRow *row);
 
+gboolean
+wh_db_load_thumbnail (WHVideoModelRow *row);
+
+void
+wh_db_store_thumbnail (WHVideoModelRow *row);
+
 G_END_DECLS
 
 #endif
@@ -20,6 +20,7 @@ struct _WHVideoModelRowPrivate
   time_t              age;
   time_t              vtime;
   GdkPixbuf          *thumbnail;
+  gboolean            thumbnail_stored;
   WHVideoRowRenderer *renderer; 
 };
 
@@ -34,7 +35,8 @@ enum
   PROP_VTIME,
   PROP_SERIES,
   PROP_EPISODE,
-  PROP_THUMBNAIL
+  PROP_THUMBNAIL,
+  PROP_THUMBNAIL_STORED
 };
 
 static void
@@ -75,6 +77,9 @@ wh_video_model_row_get_property (GObject *object, guint property_id,
     case PROP_THUMBNAIL:
       g_value_set_object (value, priv->thumbnail);
       break;
+    case PROP_THUMBNAIL_STORED:
+      g_value_set_boolean (value, priv->thumbnail_stored);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -123,6 +128,10 @@ wh_video_model_row_set_property (GObject *object, guint property_id,
       wh_video_model_row_set_thumbnail (row, 
 					g_value_get_object (value));
       break;
+    case PROP_THUMBNAIL_STORED:
+      wh_video_model_row_set_thumbnail_stored (row,
+					       g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -238,6 +247,15 @@ wh_video_model_row_class_init (WHVideoModelRowClass *klass)
 			  GDK_TYPE_PIXBUF,
 			  G_PARAM_READWRITE));
 
+  g_object_class_install_property 
+    (object_class,
+     PROP_THUMBNAIL_STORED,
+     g_param_spec_boolean ("thumbnail-stored",
+			   "Thumbnail-Stored",
+			   "Whether the database has a thumbnail to load",
+			   FALSE,
+			   G_PARAM_READWRITE));
+
 }
 
 static void
@@ -466,3 +484,22 @@ wh_video_model_row_set_thumbnail (WHVideoModelRow *row,
   g_object_notify (G_OBJECT (row), "thumbnail");
   g_object_unref (row);
 }
+
+gboolean
+wh_video_model_row_get_thumbnail_stored (WHVideoModelRow *row)
+{
+  WHVideoModelRowPrivate *priv = VIDEO_MODEL_ROW_PRIVATE(row);
+
+  return priv->thumbnail_stored;
+}
+
+void
+wh_video_model_row_set_thumbnail_stored (WHVideoModelRow *row,
+					 gboolean         stored)
+{
+  WHVideoModelRowPrivate *priv = VIDEO_MODEL_ROW_PRIVATE(row);
+
+  priv->thumbnail_stored = stored;
+
+  g_object_notify (G_OBJECT (row), "thumbnail-stored");
+}
@@ -97,6 +97,13 @@ void
 wh_video_model_row_set_thumbnail (WHVideoModelRow *row,
 				  GdkPixbuf       *pixbuf);
 
+gboolean
+wh_video_model_row_get_thumbnail_stored (WHVideoModelRow *row);
+
+void
+wh_video_model_row_set_thumbnail_stored (WHVideoModelRow *row,
+					 gboolean         stored);
+
 G_END_DECLS
 
 #endif /* _WH_VIDEO_MODEL_ROW */
@@ -194,7 +194,7 @@ on_row_changed (GObject      *obj,
   priv = VIDEO_MODEL_PRIVATE(model);
 
   /* thumbnail changing does not effect ordering */
-  if (!strcmp(g_param_spec_get_name(arg1), "thumbnail"))
+  if (g_str_has_prefix (g_param_spec_get_name(arg1), "thumbnail"))
     return;
 
   if (priv->sort)
@@ -1,6 +1,7 @@
 #include "wh-video-row-renderer.h"
 #include "wh-video-model.h"
 #include "wh-video-model-row.h"
+#include "wh-db.h"
 #include "util.h"
 
 G_DEFINE_TYPE (WHVideoRowRenderer, wh_video_row_renderer, CLUTTER_TYPE_ACTOR);
@@ -20,6 +21,7 @@ struct _WHVideoRowRendererPrivate
   ClutterActor    *title_label, *info_label, *date_label, *hr;
   gint             width, height;
   gboolean         active;
+  guint            thumbnail_load_id;
 };
 
 enum
@@ -90,6 +92,19 @@ on_thumbnail_change (GObject        *object,
   sync_thumbnail (renderer);
 }
 
+static gboolean
+load_thumbnail_idle (WHVideoRowRenderer *renderer)
+{
+  WHVideoRowRendererPrivate *priv = VIDEO_ROW_RENDERER_PRIVATE(renderer);
+
+  priv->thumbnail_load_id = 0;
+
+  if (wh_video_model_row_get_thumbnail (priv->row) == NULL)
+    wh_db_load_thumbnail (priv->row);
+
+  return FALSE;
+}
+
 static void
 wh_video_row_renderer_get_property (GObject *object, guint property_id,
 				    GValue *value, GParamSpec *pspec)
@@ -138,6 +153,14 @@ wh_video_row_renderer_set_property (GObject *object, guint property_id,
 static void
 wh_video_row_renderer_dispose (GObject *object)
 {
+  WHVideoRowRendererPrivate *priv = VIDEO_ROW_RENDERER_PRIVATE(object);
+
+  if (priv->thumbnail_load_id)
+    {
+      g_source_remove (priv->thumbnail_load_id);
+      priv->thumbnail_load_id = 0;
+    }
+
   if (G_OBJECT_CLASS (wh_video_row_renderer_parent_class)->dispose)
     G_OBJECT_CLASS (wh_video_row_renderer_parent_class)->dispose (object);
 }
@@ -264,6 +287,14 @@ wh_video_row_renderer_paint (ClutterActor *actor)
   if (priv->width == 0 || priv->height ==0)
     return;
 
+  /* Thumbnails are only read from the database once the row is seen */
+  if (priv->thumbnail_load_id == 0
+      && clutter_actor_get_paint_opacity (actor) > 0
+      && wh_video_model_row_get_thumbnail (priv->row) == NULL
+      && wh_video_model_row_get_thumbnail_stored (priv->row))
+    priv->thumbnail_load_id =
+      g_idle_add ((GSourceFunc)load_thumbnail_idle, row);
+
   clutter_actor_paint (CLUTTER_ACTOR(priv->container));
 }
 
@@ -1,21 +1,40 @@
-#include <clutter/clutter.h>
-#include <cogl/cogl.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
 #ifdef USE_HELIX
+#include <clutter/clutter.h>
+#include <cogl/cogl.h>
 #include <clutter-helix/clutter-helix.h>
 #else
-#include <clutter-gst/clutter-gst.h>
 #include <gst/gst.h>
 #endif
 
 
 #include "totem-resources.h"
 
-int
-main (int argc, char *argv[])
+#define THUMBNAIL_SIZE 128
+
+#ifdef USE_HELIX
+
+/* How long to wait for the video to get to a frame, in seconds. This is
+ * what the resource monitor allows a single thumbnail.
+ */
+#define GRAB_TIMEOUT 60
+
+static gboolean
+on_grab_timeout (gboolean *timed_out)
+{
+  *timed_out = TRUE;
+  return FALSE;
+}
+
+/* Helix has no way to decode a frame without playing, so this plays the
+ * video muted until it gets a third of the way in.
+ */
+static GdkPixbuf *
+grab_frame (const gchar *input)
 {
   ClutterActor   *video;
   GdkPixbuf      *shot = NULL;
@@ -24,57 +43,44 @@ main (int argc, char *argv[])
   CoglPixelFormat format;
   gint            size;
   gint            width;
-  gint            height; 
+  gint            height;
   gint            rowstride;
   guchar         *data = NULL;
+  gboolean        timed_out = FALSE;
+  guint           timeout_id;
 
-#ifdef USE_HELIX
-  clutter_helix_init (&argc, &argv);
-#else
-  gst_init (&argc, &argv);
-#endif
-  clutter_init (&argc, &argv);
-
-  if (argc < 3)
-    {
-      g_print ("Usage: %s <path to movie file> <output png>\n", argv[0]);
-      exit(-1);
-    }
-
-  totem_resources_monitor_start (argv[1], 60 * G_USEC_PER_SEC);
-
-#ifdef USE_HELIX
   video = clutter_helix_video_texture_new ();
-#else
-  video = clutter_gst_video_texture_new ();
-#endif
 
-  if (argv[1][0] == '/')
-    clutter_media_set_filename(CLUTTER_MEDIA(video), argv[1]);
+  if (input[0] == '/')
+    clutter_media_set_filename(CLUTTER_MEDIA(video), input);
   else
-    clutter_media_set_uri(CLUTTER_MEDIA(video), argv[1]);
+    clutter_media_set_uri(CLUTTER_MEDIA(video), input);
   clutter_media_set_volume (CLUTTER_MEDIA(video), 0);
   clutter_media_set_playing (CLUTTER_MEDIA(video), TRUE);
 
-  do {
+  /* Sleep in the main loop until something happens, rather than spin.
+   * The timeout wakes it up if nothing does.
+   */
+  timeout_id = g_timeout_add (GRAB_TIMEOUT * 1000,
+			      (GSourceFunc) on_grab_timeout, &timed_out);
 
-    while (g_main_context_pending (NULL))
-      g_main_context_iteration (NULL, FALSE);
+  while ((duration = clutter_media_get_duration (CLUTTER_MEDIA(video))) == 0
+	 && !timed_out)
+    g_main_context_iteration (NULL, TRUE);
 
-    duration = clutter_media_get_duration (CLUTTER_MEDIA(video));
-
-  } while (duration == 0);
+  if (timed_out)
+    goto out;
 
   clutter_actor_realize (video);
 
   clutter_media_set_position (CLUTTER_MEDIA(video), duration/3);
 
-  do {
-
-    while (g_main_context_pending (NULL))
-      g_main_context_iteration (NULL, FALSE);
+  while (clutter_media_get_position (CLUTTER_MEDIA(video)) <= duration/3
+	 && !timed_out)
+    g_main_context_iteration (NULL, TRUE);
 
-  } while (clutter_media_get_position (CLUTTER_MEDIA(video)) <= duration/3);
+  if (timed_out)
+    goto out;
 
   tex_id = clutter_texture_get_cogl_texture (CLUTTER_TEXTURE (video));
   if (tex_id)
@@ -84,74 +90,284 @@ main (int argc, char *argv[])
       width = cogl_texture_get_width (tex_id);
       height = cogl_texture_get_height (tex_id);
       rowstride = cogl_texture_get_rowstride (tex_id);
-      
+
       data = (guchar*) g_malloc (sizeof(guchar) * size);
-      if (!data)
-	g_error ("malloc");;
 
       cogl_texture_get_data (tex_id, format, rowstride, data);
 
-
-      shot = gdk_pixbuf_new_from_data (data, 
-				       GDK_COLORSPACE_RGB, 
-				       FALSE, 
+      /* FIXME swap RGB pixels */
+      shot = gdk_pixbuf_new_from_data (data,
+				       GDK_COLORSPACE_RGB,
+				       FALSE,
 				       8,
-				       width, 
-				       height, 
-				       rowstride, 
-				       NULL, 
+				       width,
+				       height,
+				       rowstride,
+				       (GdkPixbufDestroyNotify) g_free,
 				       NULL);
-      
     }
 
-  totem_resources_monitor_stop ();
+ out:
+  if (!timed_out)
+    g_source_remove (timeout_id);
 
-  if (shot)
+  clutter_actor_destroy (video);
+
+  return shot;
+}
+
+#else
+
+/* How long to wait for the pipeline to get to a frame */
+#define PREROLL_TIMEOUT (10 * GST_SECOND)
+
+/* Blocks until the pipeline has a frame ready, or fails. */
+static gboolean
+wait_for_preroll (GstElement *pipeline)
+{
+  GstBus     *bus;
+  GstMessage *message;
+  gboolean    res = FALSE;
+
+  bus = gst_element_get_bus (pipeline);
+  message = gst_bus_timed_pop_filtered (bus,
+					PREROLL_TIMEOUT,
+					GST_MESSAGE_ASYNC_DONE
+					| GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  if (message)
     {
-      GdkPixbuf *thumb, *pic;
-      gint       x, y, nw, nh, w, h, size;
-      
-      size = 128;
+      res = (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ASYNC_DONE);
+      gst_message_unref (message);
+    }
 
-      /* FIXME swap RGB pixels */
+  return res;
+}
 
-      w = clutter_actor_get_width (video);
-      h = clutter_actor_get_height (video);
-      
-      nh = ( h * size) / w;
+static void
+free_frame (guchar *pixels, GstBuffer *buffer)
+{
+  gst_buffer_unref (buffer);
+}
 
-      if (nh <= size)
-	{
-	  nw = size;
-	  x = 0;
-	  y = (size - nh) / 2;
-	}
-      else
-	{
-	  nw  = ( w * size ) / h;
-	  nh = size;
-	  x = (size - nw) / 2;
-	  y = 0;
-	}
+/* Pauses the video, which decodes a frame without playing anything, then
+ * seeks to the keyframe nearest a third of the way in and takes the frame
+ * decoded there.
+ */
+static GdkPixbuf *
+grab_frame (const gchar *input)
+{
+  GstElement          *playbin;
+  GstStateChangeReturn state;
+  GstFormat            format = GST_FORMAT_TIME;
+  GstBuffer           *buffer = NULL;
+  GstCaps             *caps;
+  GstStructure        *structure;
+  GdkPixbuf           *shot = NULL;
+  gint64               duration = 0;
+  gint                 width, height;
+  gchar               *uri;
+
+  if (input[0] == '/')
+    uri = g_filename_to_uri (input, NULL, NULL);
+  else
+    uri = g_strdup (input);
 
-      thumb = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
-      gdk_pixbuf_fill (thumb, 0x000000FF);
+  playbin = gst_element_factory_make ("playbin2", NULL);
+  if (playbin == NULL || uri == NULL)
+    {
+      g_free (uri);
+      return NULL;
+    }
 
-      pic = gdk_pixbuf_scale_simple (shot, nw, nh, GDK_INTERP_BILINEAR);
-      gdk_pixbuf_copy_area  (pic, 0, 0, nw, nh, thumb, x, y);
-      
-      if (!gdk_pixbuf_save (thumb, argv[2], "png", NULL, NULL))
+  /* Video only, and don't display it */
+  g_object_set (playbin,
+		"uri", uri,
+		"flags", 1,
+		"audio-sink", gst_element_factory_make ("fakesink", NULL),
+		"video-sink", gst_element_factory_make ("fakesink", NULL),
+		NULL);
+  g_free (uri);
+
+  state = gst_element_set_state (playbin, GST_STATE_PAUSED);
+  if (state == GST_STATE_CHANGE_FAILURE
+      || (state == GST_STATE_CHANGE_ASYNC && !wait_for_preroll (playbin)))
+    goto out;
+
+  if (gst_element_query_duration (playbin, &format, &duration)
+      && duration > 0)
+    {
+      if (gst_element_seek_simple (playbin,
+				   GST_FORMAT_TIME,
+				   GST_SEEK_FLAG_FLUSH
+				   | GST_SEEK_FLAG_KEY_UNIT,
+				   duration / 3))
+	wait_for_preroll (playbin);
+    }
+
+  caps = gst_caps_new_simple ("video/x-raw-rgb",
+			      "bpp", G_TYPE_INT, 24,
+			      "depth", G_TYPE_INT, 24,
+			      "endianness", G_TYPE_INT, G_BIG_ENDIAN,
+			      "red_mask", G_TYPE_INT, 0xff0000,
+			      "green_mask", G_TYPE_INT, 0x00ff00,
+			      "blue_mask", G_TYPE_INT, 0x0000ff,
+			      "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+			      NULL);
+  g_signal_emit_by_name (playbin, "convert-frame", caps, &buffer);
+  gst_caps_unref (caps);
+
+  if (buffer == NULL || GST_BUFFER_CAPS (buffer) == NULL)
+    goto out;
+
+  structure = gst_caps_get_structure (GST_BUFFER_CAPS (buffer), 0);
+  if (gst_structure_get_int (structure, "width", &width)
+      && gst_structure_get_int (structure, "height", &height))
+    {
+      shot = gdk_pixbuf_new_from_data (GST_BUFFER_DATA (buffer),
+				       GDK_COLORSPACE_RGB,
+				       FALSE,
+				       8,
+				       width,
+				       height,
+				       GST_ROUND_UP_4 (width * 3),
+				       (GdkPixbufDestroyNotify) free_frame,
+				       buffer);
+      buffer = NULL;
+    }
+
+ out:
+  if (buffer)
+    gst_buffer_unref (buffer);
+
+  gst_element_set_state (playbin, GST_STATE_NULL);
+  gst_object_unref (playbin);
+
+  return shot;
+}
+
+#endif
+
+/* Letterboxes the frame into a THUMBNAIL_SIZE square and saves it */
+static gboolean
+save_thumbnail (GdkPixbuf *shot, const gchar *output)
+{
+  GdkPixbuf *thumb, *pic;
+  gint       x, y, nw, nh, w, h, size;
+  gboolean   res;
+
+  size = THUMBNAIL_SIZE;
+
+  w = gdk_pixbuf_get_width (shot);
+  h = gdk_pixbuf_get_height (shot);
+
+  nh = ( h * size) / w;
+
+  if (nh <= size)
+    {
+      nw = size;
+      x = 0;
+      y = (size - nh) / 2;
+    }
+  else
+    {
+      nw  = ( w * size ) / h;
+      nh = size;
+      x = (size - nw) / 2;
+      y = 0;
+    }
+
+  thumb = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+  gdk_pixbuf_fill (thumb, 0x000000FF);
+
+  pic = gdk_pixbuf_scale_simple (shot, nw, nh, GDK_INTERP_BILINEAR);
+  gdk_pixbuf_copy_area  (pic, 0, 0, nw, nh, thumb, x, y);
+
+  res = gdk_pixbuf_save (thumb, output, "png", NULL, NULL);
+
+  g_object_unref (thumb);
+  g_object_unref (pic);
+
+  return res;
+}
+
+static gboolean
+thumbnail_file (const gchar *input, const gchar *output)
+{
+  GdkPixbuf *shot;
+  gboolean   res;
+
+  shot = grab_frame (input);
+  if (shot == NULL)
+    return FALSE;
+
+  res = save_thumbnail (shot, output);
+  if (!res)
+    g_warning ("Pixbuf save failed for '%s'", output);
+
+  g_object_unref (shot);
+
+  return res;
+}
+
+/* Reads "<movie>\t<output png>" lines from stdin and answers each with
+ * "ok" or "failed" on stdout, so that one process can make many
+ * thumbnails. The resource monitor is per process, so it's not used
+ * here; each file is limited by grab_frame()'s timeouts instead.
+ */
+static int
+run_batch (void)
+{
+  gchar line[4096];
+
+  while (fgets (line, sizeof (line), stdin))
+    {
+      gchar *output;
+
+      g_strchomp (line);
+
+      output = strchr (line, '\t');
+      if (output == NULL)
 	{
-	  g_error ("%s: Pixbuf save failed\n", argv[0]);
-	  exit(-1);
+	  printf ("failed\n");
+	  fflush (stdout);
+	  continue;
 	}
+      *output++ = '\0';
 
-      g_object_unref (shot);
-      g_object_unref (thumb);
-      g_object_unref (pic);
+      printf ("%s\n", thumbnail_file (line, output) ? "ok" : "failed");
+      fflush (stdout);
+    }
+
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean res;
 
-      exit(0);
+#ifdef USE_HELIX
+  clutter_helix_init (&argc, &argv);
+  clutter_init (&argc, &argv);
+#else
+  gst_init (&argc, &argv);
+#endif
+
+  if (argc == 2 && strcmp (argv[1], "--batch") == 0)
+    exit (run_batch ());
+
+  if (argc < 3)
+    {
+      g_print ("Usage: %s <path to movie file> <output png>\n"
+	       "       %s --batch\n", argv[0], argv[0]);
+      exit(-1);
     }
 
-  exit (-1);
+  totem_resources_monitor_start (argv[1], 60 * G_USEC_PER_SEC);
+  res = thumbnail_file (argv[1], argv[2]);
+  totem_resources_monitor_stop ();
+
+  exit (res ? 0 : -1);
 }
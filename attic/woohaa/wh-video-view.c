@@ -477,6 +477,29 @@ wh_video_view_get_selected (WHVideoView *view)
   return wh_video_model_get_row (priv->model, priv->active_item_num);
 }
 
+/* Calls func on the rows that are on screen, from the top, for as long
+ * as it returns TRUE.
+ */
+void
+wh_video_view_foreach_visible (WHVideoView      *view,
+			       WHForeachRowFunc  func,
+			       gpointer          data)
+{
+  WHVideoViewPrivate *priv = WH_VIDEO_VIEW_GET_PRIVATE(view);
+  WHVideoModelRow    *row;
+  gint                i;
+
+  for (i = MAX (priv->active_item_num - 1, 0);
+       i < MIN (priv->active_item_num + priv->n_rows_visible, priv->n_rows);
+       i++)
+    {
+      row = wh_video_model_get_row (priv->model, i);
+
+      if (row && !func (priv->model, row, data))
+	break;
+    }
+}
+
 void
 wh_video_view_enable_animation (WHVideoView *view, gboolean active)
 {
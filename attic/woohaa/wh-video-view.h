@@ -88,6 +88,11 @@ wh_video_view_enable_animation (WHVideoView *view, gboolean active);
 WHVideoModelRow*
 wh_video_view_get_selected (WHVideoView *view);
 
+void
+wh_video_view_foreach_visible (WHVideoView      *view,
+			       WHForeachRowFunc  func,
+			       gpointer          data);
+
 G_END_DECLS
 
 #endif
@@ -6,6 +6,8 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
 #include <glib/gstdio.h>
 
 #ifdef USE_HELIX
@@ -25,6 +27,9 @@
 #define FONT "VistaSansBook 75px"
 #define WOOHAA_GCONF_PREFIX   "/apps/woohaa"
 
+/* How long a thumbnailer gets before it's killed, in milliseconds */
+#define THUMBNAIL_TIMEOUT 15000
+
 typedef struct WooHaa
 {
   ClutterActor      *screen_browse, *screen_video;
@@ -37,12 +42,22 @@ typedef struct WooHaa
   ClutterEffectTemplate *video_effect_tmpl;
 
   /* For thumbnailer */
-  gint             tn_pending_child_pid;
-  WHVideoModelRow *tn_pending_row;
-  gint             tn_trys;
+  GList           *tn_jobs;
+  guint            tn_max_jobs;
 }
 WooHaa;
 
+/* One running wh-video-thumbnailer, writing to its own temporary file */
+typedef struct
+{
+  WooHaa          *wh;
+  WHVideoModelRow *row;
+  GPid             pid;
+  gchar           *path;
+  guint            timeout_id;
+}
+ThumbnailJob;
+
 gboolean
 browse_input_cb (ClutterStage *stage,
 		 ClutterEvent *event,
@@ -57,77 +72,93 @@ static void
 thumbnail_find_empty (WooHaa *wh);
 
 static gboolean
-check_thumbnailer_child(gpointer data)
+thumbnail_timeout (ThumbnailJob *job)
 {
-  WooHaa    *wh = (WooHaa *)data;
-  GdkPixbuf *pixbuf;
-  gint       status;
+  g_warning("timed out making thumbnail");
 
-  if (wh->tn_pending_child_pid == 0 || wh->tn_pending_row == NULL)
-    return FALSE;
+  /* The child watch does the rest */
+  job->timeout_id = 0;
+  kill (job->pid, SIGKILL);
 
-  if (waitpid (wh->tn_pending_child_pid, 
-	       &status, 
-	       WNOHANG) != wh->tn_pending_child_pid)
-    {
-      /* Try again soon */
-      wh->tn_trys++;
+  return FALSE;
+}
 
-      if (wh->tn_trys > 5)
-	{
-	  g_warning("timed out making thumbnail");
-	  /* Insert a blank pixbuf */
-	  wh_video_model_row_set_thumbnail 
-	    (wh->tn_pending_row, wh_theme_get_pixbuf("default-thumbnail"));
-	  kill (wh->tn_pending_child_pid, SIGKILL);
-	  waitpid (wh->tn_pending_child_pid, &status, 0);
-	  goto cleanup;
-	}
-      return TRUE;
-    }
+static void
+thumbnail_child_done (GPid          pid,
+		      gint          status,
+		      ThumbnailJob *job)
+{
+  WooHaa    *wh = job->wh;
+  GdkPixbuf *pixbuf = NULL;
+
+  g_spawn_close_pid (pid);
 
-  pixbuf = gdk_pixbuf_new_from_file ("/tmp/wh-thumb.png", NULL);
+  if (job->timeout_id)
+    g_source_remove (job->timeout_id);
+
+  if (WIFEXITED (status) && WEXITSTATUS (status) == 0)
+    pixbuf = gdk_pixbuf_new_from_file (job->path, NULL);
+
+  if (pixbuf)
+    {
+      wh_video_model_row_set_thumbnail (job->row, pixbuf);
+      g_object_unref (pixbuf);
 
-  if (pixbuf == NULL)
+      wh_db_store_thumbnail (job->row);
+    }
+  else
     {
       /* Insert a blank pixbuf */
       wh_video_model_row_set_thumbnail 
-	(wh->tn_pending_row, wh_theme_get_pixbuf("default-thumbnail"));
-      g_warning("failed to load pixbuf from thumbnailed");
-      goto cleanup;
+	(job->row, wh_theme_get_pixbuf("default-thumbnail"));
+      g_warning("failed to load pixbuf from thumbnailer");
     }
 
-  wh_video_model_row_set_thumbnail (wh->tn_pending_row, pixbuf);
-  g_object_unref (pixbuf);
-
-  wh_db_sync_row (wh->tn_pending_row);
+  wh->tn_jobs = g_list_remove (wh->tn_jobs, job);
 
- cleanup:
-  g_object_unref(wh->tn_pending_row);
-  wh->tn_pending_child_pid = 0;
-  wh->tn_pending_row = NULL;
-  wh->tn_trys = 0;
-  g_remove ("/tmp/wh-thumb.png");
+  g_remove (job->path);
+  g_free (job->path);
+  g_object_unref (job->row);
+  g_slice_free (ThumbnailJob, job);
 
   thumbnail_find_empty (wh);
+}
+
+static gboolean
+thumbnail_is_pending (WooHaa *wh, WHVideoModelRow *row)
+{
+  GList *l;
+
+  for (l = wh->tn_jobs; l; l = l->next)
+    if (((ThumbnailJob *)l->data)->row == row)
+      return TRUE;
 
-  /* All done */
   return FALSE;
 }
 
 gboolean
 thumbnail_create (WooHaa *wh, WHVideoModelRow *row)
 {
-  gboolean result;
-  gchar  **argv;
+  ThumbnailJob *job;
+  gboolean      result;
+  gchar       **argv;
+  gchar        *path = NULL;
+  gint          fd;
+
+  fd = g_file_open_tmp ("wh-thumb-XXXXXX.png", &path, NULL);
+  if (fd < 0)
+    {
+      g_warning("failed to create a file for the thumbnail");
+      return FALSE;
+    }
+  close (fd);
 
-  if (wh->tn_pending_child_pid > 0 || wh->tn_pending_row != NULL)
-    return TRUE;
+  job = g_slice_new0 (ThumbnailJob);
 
   argv = g_new(gchar *, 4);
   argv[0] = g_strdup("wh-video-thumbnailer");
   argv[1] = g_strdup(wh_video_model_row_get_path(row));
-  argv[2] = g_strdup("/tmp/wh-thumb.png");
+  argv[2] = g_strdup(path);
   argv[3] = NULL;
 
   result = g_spawn_async (NULL,
@@ -136,7 +167,7 @@ thumbnail_create (WooHaa *wh, WHVideoModelRow *row)
 			  G_SPAWN_SEARCH_PATH|G_SPAWN_DO_NOT_REAP_CHILD,
 			  NULL,
 			  NULL,
-			  &wh->tn_pending_child_pid,
+			  &job->pid,
 			  NULL);
   g_strfreev(argv);
 
@@ -147,15 +178,21 @@ thumbnail_create (WooHaa *wh, WHVideoModelRow *row)
       wh_video_model_row_set_thumbnail 
 	(row, wh_theme_get_pixbuf("default-thumbnail"));
 
-      wh->tn_pending_row       = NULL;
-      wh->tn_pending_child_pid = 0;
+      g_remove (path);
+      g_free (path);
+      g_slice_free (ThumbnailJob, job);
 
       return FALSE;
     }
 
-  wh->tn_pending_row = row;
-  g_object_ref(row);
-  g_timeout_add (2500, check_thumbnailer_child, wh);
+  job->wh   = wh;
+  job->row  = g_object_ref (row);
+  job->path = path;
+  job->timeout_id = g_timeout_add (THUMBNAIL_TIMEOUT,
+				   (GSourceFunc)thumbnail_timeout, job);
+  g_child_watch_add (job->pid, (GChildWatchFunc)thumbnail_child_done, job);
+
+  wh->tn_jobs = g_list_prepend (wh->tn_jobs, job);
 
   return TRUE;
 }
@@ -165,23 +202,48 @@ thumbnail_find_empty_foreach (WHVideoModel    *model,
 			      WHVideoModelRow *row,
 			      gpointer         data)
 {
-  if (wh_video_model_row_get_thumbnail (row) == NULL)
-    {
-      if (thumbnail_create ((WooHaa *)data, row))
-	return FALSE;
-    }
+  WooHaa *wh = (WooHaa *)data;
+
+  if (g_list_length (wh->tn_jobs) >= wh->tn_max_jobs)
+    return FALSE;
+
+  if (wh_video_model_row_get_thumbnail (row) == NULL
+      && !wh_video_model_row_get_thumbnail_stored (row)
+      && !thumbnail_is_pending (wh, row))
+    thumbnail_create (wh, row);
 
   return TRUE;
 }
 
+/* Keeps up to tn_max_jobs thumbnailers busy, starting with the rows on
+ * screen.
+ */
 static void
 thumbnail_find_empty (WooHaa *wh)
 {
-  if (!wh_screen_video_get_playing(WH_SCREEN_VIDEO(wh->screen_video))
-      && wh->tn_pending_child_pid == 0)
-    wh_video_model_foreach (wh->model, 
-			    thumbnail_find_empty_foreach, 
-			    (gpointer)wh); 
+  if (wh_screen_video_get_playing(WH_SCREEN_VIDEO(wh->screen_video)))
+    return;
+
+  wh_video_view_foreach_visible (WH_VIDEO_VIEW(wh->view),
+				 thumbnail_find_empty_foreach,
+				 (gpointer)wh);
+  wh_video_model_foreach (wh->model, 
+			  thumbnail_find_empty_foreach, 
+			  (gpointer)wh); 
+}
+
+static void
+thumbnail_cancel_all (WooHaa *wh)
+{
+  GList *l;
+
+  for (l = wh->tn_jobs; l; l = l->next)
+    {
+      ThumbnailJob *job = l->data;
+
+      kill (job->pid, SIGKILL);
+      g_remove (job->path);
+    }
 }
 
 void
@@ -280,9 +342,11 @@ browse_input_cb (ClutterStage *stage,
 	  break;
 	case CLUTTER_Up:
 	  wh_video_view_advance (WH_VIDEO_VIEW(wh->view), -1);
+	  thumbnail_find_empty (wh);
 	  break;
 	case CLUTTER_Down:
 	  wh_video_view_advance (WH_VIDEO_VIEW(wh->view), 1);
+	  thumbnail_find_empty (wh);
 	  break;
 	case CLUTTER_Return:
 	  if (!wh_screen_video_activate (WH_SCREEN_VIDEO(wh->screen_video), 
@@ -595,6 +659,9 @@ main (int argc, char *argv[])
 
   wh = g_new0(WooHaa, 1);
 
+  /* Run as many thumbnailers as there are cores */
+  wh->tn_max_jobs = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+
   wh->model = wh_video_model_new ();
   wh->db    = wh_db_new ();
 
@@ -771,12 +838,11 @@ main (int argc, char *argv[])
 		    G_CALLBACK (browse_input_cb),
 		    wh);
 
-  g_remove ("/tmp/wh-thumb.png");
   thumbnail_find_empty(wh);
 
   clutter_main();
 
-  g_remove ("/tmp/wh-thumb.png");
+  thumbnail_cancel_all (wh);
 
   return 0;
 }
@@ -0,0 +1,414 @@
+/*
+ * gps-globe - A little app showing your position on a globe
+ * Copyright (C) 2009  Intel Corporation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "gpsg-sphere-geometry.h"
+
+#define GPSG_SPHERE_GOLDEN_RATIO      1.61803398874989  /* φ = (1+√5) ÷ 2 */
+/* Amount to scale a vertex using the golden ratio so that it will
+   have a radius of one. */
+#define GPSG_SPHERE_NORM_ONE          0.525731112119134 /* = √(1 / (1 + φ²)) */
+#define GPSG_SPHERE_NORM_GOLDEN_RATIO (GPSG_SPHERE_GOLDEN_RATIO \
+                                       * GPSG_SPHERE_NORM_ONE)
+
+typedef struct _GpsgSphereStackEntry
+{
+  /* Index of the three edges that make up the triangle */
+  guint32 e[3];
+  /* The recursion depth that was needed to add this entry */
+  guint8 depth;
+  /* A bit for each edge. If set then use v1, otherwise v0 */
+  guint8 direction;
+} GpsgSphereStackEntry;
+
+typedef struct _GpsgSphereEdge
+{
+  /* Index of the two vertices that make up this edge */
+  guint32 v0, v1;
+  /* Index of two edges that subdivide this edge, or -1 if it hasn't
+     been divided yet */
+  gint32 e0, e1;
+} GpsgSphereEdge;
+
+/* Initial edges needed to make an icosahedron */
+static const GpsgSphereEdge
+gpsg_sphere_ico_edges[] =
+{
+  { 0, 2, -1, -1 }, { 0, 4, -1, -1 }, { 0, 6, -1, -1 }, { 0, 8, -1, -1 },
+  { 0, 9, -1, -1 }, { 1, 3, -1, -1 }, { 1, 4, -1, -1 }, { 1, 6, -1, -1 },
+  { 1, 10, -1, -1 }, { 1, 11, -1, -1 }, { 2, 5, -1, -1 }, { 2, 7, -1, -1 },
+  { 2, 8, -1, -1 }, { 2, 9, -1, -1 }, { 3, 5, -1, -1 }, { 3, 7, -1, -1 },
+  { 3, 10, -1, -1 }, { 3, 11, -1, -1 }, { 4, 6, -1, -1 }, { 4, 8, -1, -1 },
+  { 4, 10, -1, -1 }, { 5, 7, -1, -1 }, { 5, 8, -1, -1 }, { 5, 10, -1, -1 },
+  { 6, 9, -1, -1 }, { 6, 11, -1, -1 }, { 7, 9, -1, -1 }, { 7, 11, -1, -1 },
+  { 8, 10, -1, -1 }, { 9, 11, -1, -1 }
+};
+
+/* Initial triangles needed to make an icosahedron with all the
+   vertices in anti-clockwise order */
+static const GpsgSphereStackEntry
+gpsg_sphere_ico_stack_entries[] =
+{
+  { { 17, 9, 5 }, 0, 2 }, { { 8, 16, 5 }, 0, 6 }, { { 14, 16, 23 }, 0, 5 },
+  { { 21, 15, 14 }, 0, 2 }, { { 27, 17, 15 }, 0, 2 }, { { 11, 21, 10 }, 0, 6 },
+  { { 12, 10, 22 }, 0, 1 }, { { 22, 23, 28 }, 0, 5 }, { { 19, 28, 20 }, 0, 4 },
+  { { 20, 8, 6 }, 0, 2 }, { { 18, 6, 7 }, 0, 3 }, { { 7, 9, 25 }, 0, 5 },
+  { { 24, 25, 29 }, 0, 5 }, { { 29, 27, 26 }, 0, 2 }, { { 26, 11, 13 }, 0, 3 },
+  { { 0, 4, 13 }, 0, 5 }, { { 4, 2, 24 }, 0, 1 }, { { 1, 18, 2 }, 0, 4 },
+  { { 3, 19, 1 }, 0, 6 }, { { 12, 3, 0 }, 0, 2 }
+};
+
+/* This helper macro is just used to abbreviate getting a vertex out
+   of the GArray */
+#define VERT(x) g_array_index (vertices, GpsgSphereVertex, (x))
+
+GpsgSphereGeometry *
+gpsg_sphere_geometry_new (guint depth)
+{
+  GpsgSphereGeometry *geometry;
+  guint n_triangles;
+  guint n_indices;
+  guint n_edges;
+  GpsgSphereStackEntry *stack, *stack_pos, *max_stack_pos;
+  guint stack_size;
+  GArray *vertices;
+  GpsgSphereVertex *vertices_pos;
+  guint32 *indices, *indices_pos;
+  GpsgSphereEdge *edges, *edges_pos;
+  int i;
+
+  n_triangles = 20 * powf (4, depth) + 0.5f;
+  n_edges = 0;
+  for (i = 0; i <= depth; i++)
+    n_edges += 30 * powf (4, i) + 0.5f;
+  n_indices = n_triangles * 3;
+  stack_size = depth * 3 + 20;
+  stack = g_new (GpsgSphereStackEntry, stack_size);
+  indices_pos = indices = g_new (guint32, n_indices);
+  vertices = g_array_new (FALSE, FALSE, sizeof (GpsgSphereVertex));
+  edges = g_new (GpsgSphereEdge, n_edges + 100);
+
+  /* Add the initial 12 vertices needed to make an icosahedron */
+  g_array_set_size (vertices, 12);
+  vertices_pos = &VERT (0);
+  {
+    int unit, magic;
+
+    for (unit = -1; unit <= 1; unit += 2)
+      for (magic = -1; magic <= 1; magic += 2)
+        {
+          vertices_pos->x = 0;
+          vertices_pos->y = unit * GPSG_SPHERE_NORM_ONE;
+          vertices_pos->z = magic * GPSG_SPHERE_NORM_GOLDEN_RATIO;
+          vertices_pos++;
+        }
+    for (unit = -1; unit <= 1; unit += 2)
+      for (magic = -1; magic <= 1; magic += 2)
+        {
+          vertices_pos->x = unit * GPSG_SPHERE_NORM_ONE;
+          vertices_pos->y = magic * GPSG_SPHERE_NORM_GOLDEN_RATIO;
+          vertices_pos->z = 0;
+          vertices_pos++;
+        }
+    for (unit = -1; unit <= 1; unit += 2)
+      for (magic = -1; magic <= 1; magic += 2)
+        {
+          vertices_pos->x = magic * GPSG_SPHERE_NORM_GOLDEN_RATIO;
+          vertices_pos->y = 0;
+          vertices_pos->z = unit * GPSG_SPHERE_NORM_ONE;
+          vertices_pos++;
+        }
+  }
+
+  /* Add the initial edges */
+  memcpy (edges, gpsg_sphere_ico_edges, sizeof (gpsg_sphere_ico_edges));
+  edges_pos = edges + G_N_ELEMENTS (gpsg_sphere_ico_edges);
+  /* and stack entries */
+  memcpy (stack, gpsg_sphere_ico_stack_entries,
+          sizeof (gpsg_sphere_ico_stack_entries));
+  stack_pos = stack + G_N_ELEMENTS (gpsg_sphere_ico_stack_entries);
+
+  max_stack_pos = stack_pos;
+
+  /* While the stack is not empty */
+  while (stack_pos > stack)
+    {
+      /* Pop an entry off the stack */
+      GpsgSphereStackEntry entry = *(--stack_pos);
+
+      /* If we've reached the depth limit.. */
+      if (entry.depth >= depth)
+        /* Add the triangle to the vertices */
+        for (i = 0; i < 3; i++)
+          *(indices_pos++) = ((entry.direction & (1 << i))
+                              ? edges[entry.e[i]].v1
+                              : edges[entry.e[i]].v0);
+      else
+        {
+          /* If the stack is not empty then add four more triangles
+             to split this one up */
+
+          /* Split each edge if it is not already split */
+          for (i = 0; i < 3; i++)
+            if (edges[entry.e[i]].e0 == -1)
+              {
+                g_array_set_size (vertices, vertices->len + 1);
+                vertices_pos = &VERT (vertices->len - 1);
+                vertices_pos->x = (VERT (edges[entry.e[i]].v0).x
+                                   + VERT (edges[entry.e[i]].v1).x) / 2.0;
+                vertices_pos->y = (VERT (edges[entry.e[i]].v0).y
+                                   + VERT (edges[entry.e[i]].v1).y) / 2.0;
+                vertices_pos->z = (VERT (edges[entry.e[i]].v0).z
+                                   + VERT (edges[entry.e[i]].v1).z) / 2.0;
+                edges[entry.e[i]].e0 = edges_pos - edges;
+                edges_pos->v0 = edges[entry.e[i]].v0;
+                edges_pos->v1 = vertices->len - 1;
+                edges_pos->e0 = -1;
+                edges_pos->e1 = -1;
+                edges_pos++;
+                edges[entry.e[i]].e1 = edges_pos - edges;
+                edges_pos->v0 = edges[entry.e[i]].v1;
+                edges_pos->v1 = vertices->len - 1;
+                edges_pos->e0 = -1;
+                edges_pos->e1 = -1;
+                edges_pos++;
+              }
+
+          /* Add each triangle */
+
+          /* Top triangle */
+          if ((entry.direction & 1))
+            stack_pos->e[0] = edges[entry.e[0]].e1;
+          else
+            stack_pos->e[0] = edges[entry.e[0]].e0;
+          stack_pos->e[1] = edges_pos - edges;
+          edges_pos->v0 = edges[edges[entry.e[0]].e0].v1;
+          edges_pos->v1 = edges[edges[entry.e[2]].e0].v1;
+          if (edges_pos->v0 > edges_pos->v1)
+            {
+              gint t = edges_pos->v0;
+              edges_pos->v0 = edges_pos->v1;
+              edges_pos->v1 = t;
+              stack_pos->direction = 6;
+            }
+          else
+            stack_pos->direction = 4;
+          edges_pos->e0 = -1;
+          edges_pos->e1 = -1;
+          edges_pos++;
+          if ((entry.direction & 4))
+            stack_pos->e[2] = edges[entry.e[2]].e0;
+          else
+            stack_pos->e[2] = edges[entry.e[2]].e1;
+          stack_pos->depth = entry.depth + 1;
+          stack_pos++;
+
+          /* Bottom left triangle */
+          if ((entry.direction & 1))
+            stack_pos->e[0] = edges[entry.e[0]].e0;
+          else
+            stack_pos->e[0] = edges[entry.e[0]].e1;
+          if ((entry.direction & 2))
+            stack_pos->e[1] = edges[entry.e[1]].e1;
+          else
+            stack_pos->e[1] = edges[entry.e[1]].e0;
+          stack_pos->e[2] = edges_pos - edges;
+          edges_pos->v0 = edges[edges[entry.e[1]].e0].v1;
+          edges_pos->v1 = edges[edges[entry.e[0]].e0].v1;
+          if (edges_pos->v0 > edges_pos->v1)
+            {
+              gint t = edges_pos->v0;
+              edges_pos->v0 = edges_pos->v1;
+              edges_pos->v1 = t;
+              stack_pos->direction = 5;
+            }
+          else
+            stack_pos->direction = 1;
+          edges_pos->e0 = -1;
+          edges_pos->e1 = -1;
+          edges_pos++;
+          stack_pos->depth = entry.depth + 1;
+          stack_pos++;
+
+          /* Bottom right triangle */
+          stack_pos->e[0] = edges_pos - edges;
+          edges_pos->v0 = edges[edges[entry.e[2]].e0].v1;
+          edges_pos->v1 = edges[edges[entry.e[1]].e0].v1;
+          if (edges_pos->v0 > edges_pos->v1)
+            {
+              gint t = edges_pos->v0;
+              edges_pos->v0 = edges_pos->v1;
+              edges_pos->v1 = t;
+              stack_pos->direction = 3;
+            }
+          else
+            stack_pos->direction = 2;
+          edges_pos->e0 = -1;
+          edges_pos->e1 = -1;
+          edges_pos++;
+          if ((entry.direction & 2))
+            stack_pos->e[1] = edges[entry.e[1]].e0;
+          else
+            stack_pos->e[1] = edges[entry.e[1]].e1;
+          if ((entry.direction & 4))
+            stack_pos->e[2] = edges[entry.e[2]].e1;
+          else
+            stack_pos->e[2] = edges[entry.e[2]].e0;
+          stack_pos->depth = entry.depth + 1;
+          stack_pos++;
+
+          /* Middle triangle */
+          stack_pos->e[0] = stack_pos[-1].e[0];
+          stack_pos->e[1] = stack_pos[-3].e[1];
+          stack_pos->e[2] = stack_pos[-2].e[2];
+          stack_pos->depth = entry.depth + 1;
+          stack_pos->direction = ((stack_pos[-1].direction & 1)
+                                  | (stack_pos[-3].direction & 2)
+                                  | (stack_pos[-2].direction & 4)) ^ 7;
+          stack_pos++;
+
+          /* This is just used for the assert below */
+          if (stack_pos > max_stack_pos)
+            max_stack_pos = stack_pos;
+        }
+    }
+
+  /* Normalise every vertex. The initial 12 are already normalised */
+  for (i = 12; i < vertices->len; i++)
+    {
+      gfloat length;
+
+      vertices_pos = &VERT (i);
+
+      length = sqrt (vertices_pos->x * vertices_pos->x
+                     + vertices_pos->y * vertices_pos->y
+                     + vertices_pos->z * vertices_pos->z);
+      vertices_pos->x /= length;
+      vertices_pos->y /= length;
+      vertices_pos->z /= length;
+    }
+
+  /* Calculate texture coordinates */
+  for (i = 0; i < vertices->len; i++)
+    {
+      vertices_pos = &VERT (i);
+
+      vertices_pos->tx = (atan2 (vertices_pos->x, vertices_pos->z)
+                          / G_PI / 2.0 + 0.5);
+      vertices_pos->ty = asin (vertices_pos->y) / G_PI + 0.5;
+    }
+
+  /* Fix all of the triangles along the seam. If a triangle contains
+     vertices with texture coordinates that wrap the long way from
+     0->1 then we need to duplicate one of them to extend the texture
+     coordinate past 1 so that it will vary across the span
+     correctly */
+  for (i = 0; i < n_indices; i += 3)
+    {
+      gfloat min_tx = G_MAXDOUBLE, max_tx = -G_MAXDOUBLE;
+      int v;
+
+      for (v = 0; v < 3; v++)
+        {
+          gfloat tx = VERT (indices[i + v]).tx;
+          if (tx < min_tx)
+            min_tx = tx;
+          if (tx > max_tx)
+            max_tx = tx;
+        }
+
+      /* If the span is greater than half of the texture then it would
+         be shorter to wrap around instead */
+      if (max_tx - min_tx > 0.5f)
+        {
+          int n_left = 0, n_right = 0, left, right;
+          gfloat tx_diff;
+
+          /* Find the odd one out */
+          for (v = 0; v < 3; v++)
+            if (VERT (indices[i + v]).tx < 0.5f)
+              {
+                n_left++;
+                left = v;
+              }
+            else
+              {
+                n_right++;
+                right = v;
+              }
+
+          /* Duplicate whichever side is the odd one out */
+          if (n_left == 1)
+            {
+              v = left;
+              tx_diff = 1.0f;
+            }
+          else
+            {
+              v = right;
+              tx_diff = -1.0f;
+            }
+
+          /* Duplicate it with a different tx */
+          g_array_set_size (vertices, vertices->len + 1);
+          vertices_pos = &VERT (vertices->len - 1);
+          *vertices_pos = VERT (indices[i + v]);
+          vertices_pos->tx += tx_diff;
+          indices[i + v] = vertices->len - 1;
+        }
+    }
+
+  /* Make sure that we allocated exactly the right amount of memory */
+  g_assert (edges_pos == edges + n_edges);
+  g_assert (indices_pos == indices + n_indices);
+  g_assert (max_stack_pos == stack + stack_size);
+
+  g_free (edges);
+  g_free (stack);
+
+  geometry = g_slice_new (GpsgSphereGeometry);
+  geometry->n_vertices = vertices->len;
+  geometry->vertices = (GpsgSphereVertex *) g_array_free (vertices, FALSE);
+  geometry->n_indices = n_indices;
+  geometry->indices = indices;
+
+  return geometry;
+}
+
+#undef VERT
+
+void
+gpsg_sphere_geometry_free (GpsgSphereGeometry *geometry)
+{
+  g_free (geometry->vertices);
+  g_free (geometry->indices);
+  g_slice_free (GpsgSphereGeometry, geometry);
+}
+
+gboolean
+gpsg_sphere_geometry_needs_int_indices (const GpsgSphereGeometry *geometry)
+{
+  return geometry->n_vertices > GPSG_SPHERE_GEOMETRY_MAX_SHORT_VERTICES;
+}
@@ -0,0 +1,60 @@
+/*
+ * gps-globe - A little app showing your position on a globe
+ * Copyright (C) 2009  Intel Corporation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GPSG_SPHERE_GEOMETRY_H__
+#define __GPSG_SPHERE_GEOMETRY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Spheres with more vertices than this need 32-bit indices */
+#define GPSG_SPHERE_GEOMETRY_MAX_SHORT_VERTICES (G_MAXUINT16 + 1)
+
+typedef struct _GpsgSphereVertex
+{
+  /* Vertex coordinates */
+  gfloat x, y, z;
+  /* Texture coordinates */
+  gfloat tx, ty;
+} GpsgSphereVertex;
+
+typedef struct _GpsgSphereGeometry GpsgSphereGeometry;
+
+/* The vertices and triangles of an icosahedron subdivided 'depth'
+   times and projected on to the unit sphere. This doesn't need a GL
+   context, so it can be tested on its own. */
+struct _GpsgSphereGeometry
+{
+  GpsgSphereVertex *vertices;
+  guint n_vertices;
+
+  /* Three indices per triangle in anti-clockwise order */
+  guint32 *indices;
+  guint n_indices;
+};
+
+GpsgSphereGeometry *gpsg_sphere_geometry_new (guint depth);
+void gpsg_sphere_geometry_free (GpsgSphereGeometry *geometry);
+
+gboolean gpsg_sphere_geometry_needs_int_indices
+                              (const GpsgSphereGeometry *geometry);
+
+G_END_DECLS
+
+#endif /* __GPSG_SPHERE_GEOMETRY_H__ */
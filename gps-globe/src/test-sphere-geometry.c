@@ -0,0 +1,96 @@
+/*
+ * gps-globe - A little app showing your position on a globe
+ * Copyright (C) 2009  Intel Corporation
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <math.h>
+
+#include "gpsg-sphere-geometry.h"
+
+#define MAX_DEPTH 7
+
+static void
+check_depth (guint depth)
+{
+  GpsgSphereGeometry *geometry = gpsg_sphere_geometry_new (depth);
+  guint n_triangles = 20, i;
+
+  for (i = 0; i < depth; i++)
+    n_triangles *= 4;
+
+  g_assert_cmpuint (geometry->n_indices, ==, n_triangles * 3);
+
+  /* Every index has to refer to a real vertex */
+  for (i = 0; i < geometry->n_indices; i++)
+    g_assert_cmpuint (geometry->indices[i], <, geometry->n_vertices);
+
+  /* All of the vertices should be on the unit sphere */
+  for (i = 0; i < geometry->n_vertices; i++)
+    {
+      const GpsgSphereVertex *v = geometry->vertices + i;
+      gfloat len = sqrtf (v->x * v->x + v->y * v->y + v->z * v->z);
+
+      g_assert_cmpfloat (fabsf (len - 1.0f), <, 1e-4f);
+    }
+
+  /* 32-bit indices are only needed once the short ones would wrap */
+  g_assert_cmpint (gpsg_sphere_geometry_needs_int_indices (geometry),
+                   ==,
+                   geometry->n_vertices
+                   > GPSG_SPHERE_GEOMETRY_MAX_SHORT_VERTICES);
+
+  if (g_test_verbose ())
+    g_print ("depth %u: %u vertices, %u triangles\n",
+             depth, geometry->n_vertices, n_triangles);
+
+  gpsg_sphere_geometry_free (geometry);
+}
+
+static void
+test_depths (void)
+{
+  guint depth;
+
+  for (depth = 0; depth <= MAX_DEPTH; depth++)
+    check_depth (depth);
+}
+
+static void
+test_large (void)
+{
+  GpsgSphereGeometry *geometry = gpsg_sphere_geometry_new (MAX_DEPTH);
+
+  /* This is the case that used to overflow the 16-bit indices */
+  g_assert (gpsg_sphere_geometry_needs_int_indices (geometry));
+
+  gpsg_sphere_geometry_free (geometry);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/sphere-geometry/depths", test_depths);
+  g_test_add_func ("/sphere-geometry/large", test_large);
+
+  return g_test_run ();
+}
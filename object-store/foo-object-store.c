@@ -31,6 +31,9 @@
   objects' properties in any desired order.
 */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "foo-object-store.h"
 
 typedef struct FooObjectStoreIter_ FooObjectStoreIter;
@@ -42,11 +45,27 @@ foo_object_store_object_property_notify (GObject         *object,
 
 static void
 foo_object_store_detach_object          (FooObjectStore  *self,
-                                         GObject         *object);
+                                         GObject         *object,
+                                         GSequenceIter   *seq_iter);
 
 static void
 foo_object_store_attach_object          (FooObjectStore  *self,
-                                         GObject         *object);
+                                         GObject         *object,
+                                         GSequenceIter   *seq_iter);
+
+static void
+foo_object_store_get_column             (FooObjectStore  *self,
+                                         GObject         *object,
+                                         guint            column,
+                                         GValue          *value);
+
+static GSequenceIter *
+foo_object_store_visible_lookup         (FooObjectStore  *self,
+                                         GSequenceIter   *seq_iter);
+
+static void
+foo_object_store_visible_update         (FooObjectStore  *self,
+                                         GSequenceIter   *seq_iter);
 
 /*
  * FooObjectStore declaration.
@@ -54,13 +73,70 @@ foo_object_store_attach_object          (FooObjectStore  *self,
 
 G_DEFINE_TYPE (FooObjectStore, foo_object_store, CLUTTER_TYPE_MODEL)
 
+enum
+{
+  ROWS_ADDED,
+  ROWS_REMOVED,
+
+  LAST_SIGNAL
+};
+
+static guint _signals[LAST_SIGNAL] = { 0, };
+
 #define GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), FOO_TYPE_OBJECT_STORE, FooObjectStorePrivate))
 
+/* How to read one column from objects of a given class. */
+typedef struct
+{
+  GParamSpec          *pspec;
+  GObjectClass        *owner_class;
+  guint                param_id;
+  gboolean             fast;
+} FooObjectStoreColumn;
+
+typedef struct
+{
+  guint                 n_columns;
+  FooObjectStoreColumn *columns;
+} FooObjectStoreAccessors;
+
 typedef struct
 {
   GSequence           *sequence;
   FooObjectStoreIter  *cached_iter;
+  /* Maps attached objects to their GSequenceIter. */
+  GHashTable          *rows;
+
+  /* While a filter is set, the GSequenceIters of the rows that pass it,
+   * in order, so they can be looked up by position. Built on demand and
+   * kept up to date as rows change, until the filter or sorting does. */
+  GSequence           *visible;
+  GHashTable          *visible_nodes;
+  gboolean             visible_valid;
+  FooObjectStoreIter  *filter_iter;
+
+  /* Maps object types to their FooObjectStoreAccessors. Stores usually hold
+   * objects of a single type, so the last one looked up is kept at hand. */
+  GHashTable              *accessors;
+  GType                    last_type;
+  FooObjectStoreAccessors *last_accessors;
+
+  gboolean                 parallel_sort;
+
+  /* Rows whose objects changed while change notifications were being
+   * coalesced or were frozen, to be reported at the next flush. While a
+   * flush runs, the rows it is reporting are in flushing. */
+  gboolean                 coalesce_changes;
+  guint                    freeze_count;
+  GHashTable              *dirty;
+  GHashTable              *flushing;
+  guint                    flush_id;
+
+  /* "notify" details for each column, so that attaching an object does
+   * not have to build and parse signal names. */
+  guint                    notify_id;
+  GQuark                  *notify_details;
 } FooObjectStorePrivate;
 
 /*
@@ -109,7 +185,6 @@ foo_object_store_iter_get_value (ClutterModelIter *iter,
 {
   FooObjectStoreIter  *self;
   GObject             *object;
-  const gchar         *name;
 
   g_return_if_fail (FOO_IS_OBJECT_STORE_ITER (iter));
   g_return_if_fail (value);
@@ -125,9 +200,12 @@ foo_object_store_iter_get_value (ClutterModelIter *iter,
     }
   else
     {
-      name = clutter_model_get_column_name (clutter_model_iter_get_model (iter),
-                                            column);
-      g_object_get_property (object, name, value);
+      ClutterModel *store = clutter_model_iter_get_model (iter);
+
+      foo_object_store_get_column (FOO_OBJECT_STORE (store),
+                                   object,
+                                   column,
+                                   value);
     }
 }
 
@@ -152,7 +230,9 @@ foo_object_store_iter_set_value (ClutterModelIter *iter,
       /* Set "master" column. NULL is legal since append() does an empty row. */
       if (object)
         {
-          foo_object_store_detach_object (FOO_OBJECT_STORE (model), object);
+          foo_object_store_detach_object (FOO_OBJECT_STORE (model),
+                                          object,
+                                          self->seq_iter);
           g_object_unref (object);
         }
 
@@ -160,7 +240,11 @@ foo_object_store_iter_set_value (ClutterModelIter *iter,
       g_sequence_set (self->seq_iter, g_object_ref (object));
 
       /* Hook up "changed" notifications for the object's properties. */
-      foo_object_store_attach_object (FOO_OBJECT_STORE (model), object);
+      foo_object_store_attach_object (FOO_OBJECT_STORE (model),
+                                      object,
+                                      self->seq_iter);
+      foo_object_store_visible_update (FOO_OBJECT_STORE (model),
+                                       self->seq_iter);
     }
   else if (object)
     {
@@ -180,33 +264,20 @@ foo_object_store_iter_is_first (ClutterModelIter *iter)
 {
   FooObjectStoreIter    *self;
   ClutterModel          *store;
-  FooObjectStorePrivate *priv;
-  FooObjectStoreIter    *cached_iter;
-  gboolean               is_seq_first;
-  gboolean               is_first = TRUE;
+  GSequenceIter         *node;
 
   g_return_val_if_fail (FOO_IS_OBJECT_STORE_ITER (iter), FALSE);
 
   self = FOO_OBJECT_STORE_ITER (iter);
   store = clutter_model_iter_get_model (iter);
-  priv = GET_PRIVATE (store);
-  cached_iter = priv->cached_iter;
 
-  /* Go backwards from iter looking for non-filtered rows. */
-  for (is_seq_first = g_sequence_iter_is_begin (self->seq_iter),
-       cached_iter->seq_iter = g_sequence_iter_prev (self->seq_iter);
-       !is_seq_first;
-       is_seq_first = g_sequence_iter_is_begin (cached_iter->seq_iter),
-       cached_iter->seq_iter = g_sequence_iter_prev (cached_iter->seq_iter))
-    {
-      if (clutter_model_filter_iter (store, CLUTTER_MODEL_ITER (cached_iter)))
-        {
-          is_first = FALSE;
-          break;
-        }
-    }
+  if (!clutter_model_get_filter_set (store))
+    return g_sequence_iter_is_begin (self->seq_iter);
 
-  return is_first;
+  /* First if no non-filtered row comes before it. */
+  node = foo_object_store_visible_lookup (FOO_OBJECT_STORE (store),
+                                          self->seq_iter);
+  return g_sequence_iter_is_begin (node);
 }
 
 static gboolean
@@ -233,17 +304,28 @@ foo_object_store_iter_next (ClutterModelIter *iter)
 
   if (clutter_model_get_filter_set (store))
     {
+      FooObjectStorePrivate *priv = GET_PRIVATE (store);
+      GSequenceIter         *node;
+
       /* Look for next non-filtered row. */
-      for (self->seq_iter = g_sequence_iter_next (self->seq_iter);
-           !g_sequence_iter_is_end (self->seq_iter);
-           self->seq_iter = g_sequence_iter_next (self->seq_iter))
+      node = foo_object_store_visible_lookup (FOO_OBJECT_STORE (store),
+                                              self->seq_iter);
+      if (!g_sequence_iter_is_end (node) &&
+          g_sequence_get (node) == self->seq_iter)
+        node = g_sequence_iter_next (node);
+
+      if (g_sequence_iter_is_end (node))
         {
-          if (clutter_model_filter_iter (store, iter))
-            {
-              g_object_set (iter, "row", row + 1, NULL);
-              /* self->seq_iter already points to the correct row. */
-              break;
-            }
+          self->seq_iter = g_sequence_get_end_iter (priv->sequence);
+        }
+      else
+        {
+          /* The iter may be on a row that is no longer visible, so take
+           * the row from the index rather than counting from it. */
+          g_object_set (iter,
+                        "row", g_sequence_iter_get_position (node),
+                        NULL);
+          self->seq_iter = g_sequence_get (node);
         }
     }
   else if (!g_sequence_iter_is_end (self->seq_iter))
@@ -270,17 +352,23 @@ foo_object_store_iter_prev (ClutterModelIter *iter)
 
   if (clutter_model_get_filter_set (store))
     {
+      FooObjectStorePrivate *priv = GET_PRIVATE (store);
+      GSequenceIter         *node;
+
       /* Look for prev non-filtered row. */
-      for (self->seq_iter = g_sequence_iter_prev (self->seq_iter);
-           !g_sequence_iter_is_begin (self->seq_iter);
-           self->seq_iter = g_sequence_iter_next (self->seq_iter))
+      node = foo_object_store_visible_lookup (FOO_OBJECT_STORE (store),
+                                              self->seq_iter);
+      if (g_sequence_iter_is_begin (node))
         {
-          if (clutter_model_filter_iter (store, iter))
-            {
-              g_object_set (iter, "row", row - 1, NULL);
-              /* self->seq_iter already points to the correct row. */
-              break;
-            }
+          self->seq_iter = g_sequence_get_begin_iter (priv->sequence);
+        }
+      else
+        {
+          node = g_sequence_iter_prev (node);
+          g_object_set (iter,
+                        "row", g_sequence_iter_get_position (node),
+                        NULL);
+          self->seq_iter = g_sequence_get (node);
         }
     }
   else if (!g_sequence_iter_is_begin (self->seq_iter))
@@ -345,26 +433,51 @@ foo_object_store_finalize (GObject *gobject)
   g_sequence_free (priv->sequence);
   priv->sequence = NULL;
 
-  G_OBJECT_CLASS (foo_object_store_parent_class)->finalize (gobject);
-}
+  g_hash_table_destroy (priv->rows);
+  priv->rows = NULL;
 
-static void
-_detach_if_non_null (GObject        *object,
-                     FooObjectStore *self)
-{
-  if (G_IS_OBJECT (object))
-    foo_object_store_detach_object (self, object);
+  g_sequence_free (priv->visible);
+  priv->visible = NULL;
+
+  g_hash_table_destroy (priv->visible_nodes);
+  priv->visible_nodes = NULL;
+
+  g_hash_table_destroy (priv->accessors);
+  priv->accessors = NULL;
+
+  g_hash_table_destroy (priv->dirty);
+  priv->dirty = NULL;
+
+  g_free (priv->notify_details);
+  priv->notify_details = NULL;
+
+  G_OBJECT_CLASS (foo_object_store_parent_class)->finalize (gobject);
 }
 
 static void
 foo_object_store_dispose (GObject *gobject)
 {
   FooObjectStorePrivate *priv = GET_PRIVATE (gobject);
+  GSequenceIter         *seq_iter;
+
+  for (seq_iter = g_sequence_get_begin_iter (priv->sequence);
+       !g_sequence_iter_is_end (seq_iter);
+       seq_iter = g_sequence_iter_next (seq_iter))
+    {
+      GObject *object = g_sequence_get (seq_iter);
 
-  g_sequence_foreach_range (g_sequence_get_begin_iter (priv->sequence),
-                            g_sequence_get_end_iter (priv->sequence),
-                            (GFunc) _detach_if_non_null,
-                            gobject);
+      if (G_IS_OBJECT (object))
+        foo_object_store_detach_object (FOO_OBJECT_STORE (gobject),
+                                        object,
+                                        seq_iter);
+    }
+
+  if (priv->flush_id)
+    {
+      g_source_remove (priv->flush_id);
+      priv->flush_id = 0;
+    }
+  g_hash_table_remove_all (priv->dirty);
 
   g_sequence_remove_range (g_sequence_get_begin_iter (priv->sequence),
                            g_sequence_get_end_iter (priv->sequence));
@@ -375,55 +488,200 @@ foo_object_store_dispose (GObject *gobject)
       priv->cached_iter = NULL;
     }
 
+  if (priv->filter_iter)
+    {
+      g_object_unref (priv->filter_iter);
+      priv->filter_iter = NULL;
+    }
+
   G_OBJECT_CLASS (foo_object_store_parent_class)->dispose (gobject);
 }
 
+/*
+ * Index of the rows that pass the filter.
+ */
+
+static gint
+_compare_seq_iters (gconstpointer a,
+                    gconstpointer b,
+                    gpointer      data)
+{
+  return g_sequence_iter_compare ((GSequenceIter *) a, (GSequenceIter *) b);
+}
+
+static gboolean
+foo_object_store_row_is_visible (FooObjectStore *self,
+                                 GSequenceIter  *seq_iter)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+
+  /* Rows without an object yet are still being added. */
+  if (!g_sequence_get (seq_iter))
+    return FALSE;
+
+  priv->filter_iter->seq_iter = seq_iter;
+  return clutter_model_filter_iter (CLUTTER_MODEL (self),
+                                    CLUTTER_MODEL_ITER (priv->filter_iter));
+}
+
+static void
+foo_object_store_visible_invalidate (FooObjectStore *self)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+
+  if (!priv->visible_valid)
+    return;
+
+  g_sequence_remove_range (g_sequence_get_begin_iter (priv->visible),
+                           g_sequence_get_end_iter (priv->visible));
+  g_hash_table_remove_all (priv->visible_nodes);
+  priv->visible_valid = FALSE;
+}
+
+static void
+foo_object_store_visible_ensure (FooObjectStore *self)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+  GSequenceIter         *seq_iter;
+
+  if (priv->visible_valid)
+    return;
+
+  for (seq_iter = g_sequence_get_begin_iter (priv->sequence);
+       !g_sequence_iter_is_end (seq_iter);
+       seq_iter = g_sequence_iter_next (seq_iter))
+    {
+      if (foo_object_store_row_is_visible (self, seq_iter))
+        g_hash_table_insert (priv->visible_nodes,
+                             seq_iter,
+                             g_sequence_append (priv->visible, seq_iter));
+    }
+
+  priv->visible_valid = TRUE;
+}
+
+/*
+ * Returns the node in the index of the first non-filtered row at or after
+ * seq_iter, which may be the end node.
+ */
+static GSequenceIter *
+foo_object_store_visible_lookup (FooObjectStore *self,
+                                 GSequenceIter  *seq_iter)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+  GSequenceIter         *node;
+
+  foo_object_store_visible_ensure (self);
+
+  node = g_hash_table_lookup (priv->visible_nodes, seq_iter);
+  if (node)
+    return node;
+
+  if (g_sequence_iter_is_end (seq_iter))
+    return g_sequence_get_end_iter (priv->visible);
+
+  return g_sequence_search (priv->visible, seq_iter, _compare_seq_iters, NULL);
+}
+
+/*
+ * Re-evaluates the filter for a row whose object has changed.
+ */
+static void
+foo_object_store_visible_update (FooObjectStore *self,
+                                 GSequenceIter  *seq_iter)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+  GSequenceIter         *node;
+  gboolean               visible;
+
+  if (!priv->visible_valid)
+    return;
+
+  node = g_hash_table_lookup (priv->visible_nodes, seq_iter);
+  visible = foo_object_store_row_is_visible (self, seq_iter);
+
+  if (visible && !node)
+    {
+      node = g_sequence_insert_sorted (priv->visible,
+                                       seq_iter,
+                                       _compare_seq_iters,
+                                       NULL);
+      g_hash_table_insert (priv->visible_nodes, seq_iter, node);
+    }
+  else if (!visible && node)
+    {
+      g_hash_table_remove (priv->visible_nodes, seq_iter);
+      g_sequence_remove (node);
+    }
+}
+
+static void
+foo_object_store_visible_remove (FooObjectStore *self,
+                                 GSequenceIter  *seq_iter)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+  GSequenceIter         *node;
+
+  if (!priv->visible_valid)
+    return;
+
+  node = g_hash_table_lookup (priv->visible_nodes, seq_iter);
+  if (node)
+    {
+      g_hash_table_remove (priv->visible_nodes, seq_iter);
+      g_sequence_remove (node);
+    }
+}
+
 static ClutterModelIter *
 foo_object_store_get_iter_at_row (ClutterModel *self,
                                   guint         row)
 {
   FooObjectStorePrivate *priv;
-  FooObjectStoreIter    *cached_iter;
-  FooObjectStoreIter    *iter = NULL;
-  gint                   r = -1;
+  FooObjectStoreIter    *iter;
+  GSequenceIter         *seq_iter;
 
   g_return_val_if_fail (FOO_IS_OBJECT_STORE (self), NULL);
 
   priv = GET_PRIVATE (self);
-  cached_iter = priv->cached_iter;
 
-  /* Work the cached iter to defer object instantiation until success. */
   if (clutter_model_get_filter_set (self))
     {
-      /* Count matching rows. */
-      for (cached_iter->seq_iter = g_sequence_get_begin_iter (priv->sequence);
-           !g_sequence_iter_is_end (cached_iter->seq_iter);
-           cached_iter->seq_iter = g_sequence_iter_next (cached_iter->seq_iter))
-        {
-          if (clutter_model_filter_iter (self, CLUTTER_MODEL_ITER (cached_iter)))
-            {
-              r++;
-              if ((unsigned) r == row)
-                break;
-            }
-        }
+      GSequenceIter *node;
+
+      foo_object_store_visible_ensure (FOO_OBJECT_STORE (self));
+      node = g_sequence_get_iter_at_pos (priv->visible, row);
+      if (g_sequence_iter_is_end (node))
+        return NULL;
+
+      seq_iter = g_sequence_get (node);
     }
   else
     {
-      r = row;
-      cached_iter->seq_iter = g_sequence_get_iter_at_pos (priv->sequence, row);
+      seq_iter = g_sequence_get_iter_at_pos (priv->sequence, row);
     }
 
-  if (r > -1)
+  iter = g_object_new (FOO_TYPE_OBJECT_STORE_ITER,
+                       "model", self,
+                       "row", row,
+                       NULL);
+  iter->seq_iter = seq_iter;
+
+  return (ClutterModelIter *) iter;
+}
+
+static guint
+foo_object_store_get_n_rows (ClutterModel *self)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+
+  if (clutter_model_get_filter_set (self))
     {
-      iter = g_object_new (FOO_TYPE_OBJECT_STORE_ITER,
-                            "model", self,
-                            "row", r,
-                            NULL);
-      iter->seq_iter = cached_iter->seq_iter;
+      foo_object_store_visible_ensure (FOO_OBJECT_STORE (self));
+      return g_sequence_get_length (priv->visible);
     }
 
-  return (ClutterModelIter *) iter;
+  return g_sequence_get_length (priv->sequence);
 }
 
 static ClutterModelIter *
@@ -486,34 +744,115 @@ foo_object_store_remove_row (ClutterModel *self,
   g_object_unref (iter);
 }
 
+/* Below this many rows a second thread isn't worth starting. */
+#define PARALLEL_SORT_MIN_ROWS 8192
+
+typedef struct
+{
+  GSequenceIter *seq_iter;
+  GValue         key;       /* Unset for rows without an object. */
+} SortEntry;
+
 typedef struct
 {
   ClutterModel          *store;
-  const gchar           *property_name;
   ClutterModelSortFunc   func;
   gpointer               data;
 } SortClosure;
 
+typedef struct
+{
+  SortEntry    **order;
+  guint          n_entries;
+  SortClosure   *closure;
+} SortRun;
+
 static gint
-sort_store_default (gconstpointer a,
-                    gconstpointer b,
-                    gpointer      data)
+sort_entries_compare (gconstpointer a_,
+                      gconstpointer b_,
+                      gpointer      data)
 {
-  SortClosure *closure = data;
-  GValue       p1 = { 0, };
-  GValue       p2 = { 0, };
+  const SortEntry *a = *(SortEntry * const *) a_;
+  const SortEntry *b = *(SortEntry * const *) b_;
+  SortClosure     *closure = data;
 
-  if (a == NULL && b == NULL)
+  if (!G_IS_VALUE (&a->key) && !G_IS_VALUE (&b->key))
     return 0;
-  else if (a == NULL)
+  else if (!G_IS_VALUE (&a->key))
     return -1;
-  else if (b == NULL)
+  else if (!G_IS_VALUE (&b->key))
     return 1;
 
-  g_object_get_property (G_OBJECT (a), closure->property_name, &p1);
-  g_object_get_property (G_OBJECT (b), closure->property_name, &p2);
+  return closure->func (closure->store, &a->key, &b->key, closure->data);
+}
+
+static gpointer
+sort_run_thread (gpointer data)
+{
+  SortRun *run = data;
+
+  g_qsort_with_data (run->order,
+                     run->n_entries,
+                     sizeof (SortEntry *),
+                     sort_entries_compare,
+                     run->closure);
 
-  return closure->func (closure->store, &p1, &p2, closure->data);
+  return NULL;
+}
+
+/*
+ * Sorts the halves of order on two threads and merges them. The sort
+ * function only ever sees the snapshotted keys, never the objects.
+ */
+static gboolean
+sort_entries_parallel (SortEntry   **order,
+                       guint         n_entries,
+                       SortClosure  *closure)
+{
+  SortRun     left, right;
+  GThread    *thread;
+  SortEntry  **merged;
+  guint        i, j, k;
+
+  if (!g_thread_supported ())
+    return FALSE;
+
+  left.order = order;
+  left.n_entries = n_entries / 2;
+  left.closure = closure;
+
+  right.order = order + left.n_entries;
+  right.n_entries = n_entries - left.n_entries;
+  right.closure = closure;
+
+  thread = g_thread_create (sort_run_thread, &left, TRUE, NULL);
+  if (!thread)
+    return FALSE;
+
+  sort_run_thread (&right);
+  g_thread_join (thread);
+
+  /* Taking from the left on ties keeps the sort stable. */
+  merged = g_new (SortEntry *, n_entries);
+  i = 0;
+  j = 0;
+  k = 0;
+  while (i < left.n_entries && j < right.n_entries)
+    {
+      if (sort_entries_compare (&left.order[i], &right.order[j], closure) <= 0)
+        merged[k++] = left.order[i++];
+      else
+        merged[k++] = right.order[j++];
+    }
+  while (i < left.n_entries)
+    merged[k++] = left.order[i++];
+  while (j < right.n_entries)
+    merged[k++] = right.order[j++];
+
+  memcpy (order, merged, n_entries * sizeof (SortEntry *));
+  g_free (merged);
+
+  return TRUE;
 }
 
 static void
@@ -523,19 +862,104 @@ foo_object_store_resort (ClutterModel         *self,
 {
   FooObjectStorePrivate *priv;
   SortClosure            closure;
-  gint                   column;
+  SortEntry             *entries;
+  SortEntry            **order;
+  GSequenceIter         *seq_iter;
+  GSequenceIter         *end_iter;
+  guint                  column;
+  GType                  type;
+  guint                  n_entries;
+  guint                  i;
 
   g_return_if_fail (FOO_IS_OBJECT_STORE (self));
 
   priv = GET_PRIVATE (self);
-  column = clutter_model_get_sorting_column (self);
+
+  n_entries = g_sequence_get_length (priv->sequence);
+  if (n_entries < 2)
+    return;
 
   closure.store = self;
-  closure.property_name = clutter_model_get_column_name (self, column);
   closure.func = func;
   closure.data = data;
 
-  g_sequence_sort (priv->sequence, sort_store_default, &closure);
+  column = clutter_model_get_sorting_column (self);
+  type = clutter_model_get_column_type (self, column);
+
+  /* Fetch every row's key once, rather than twice per comparison. */
+  entries = g_new0 (SortEntry, n_entries);
+  order = g_new (SortEntry *, n_entries);
+  for (seq_iter = g_sequence_get_begin_iter (priv->sequence), i = 0;
+       !g_sequence_iter_is_end (seq_iter);
+       seq_iter = g_sequence_iter_next (seq_iter), i++)
+    {
+      GObject *object = g_sequence_get (seq_iter);
+
+      entries[i].seq_iter = seq_iter;
+      order[i] = &entries[i];
+
+      if (object)
+        {
+          g_value_init (&entries[i].key, type);
+          foo_object_store_get_column (FOO_OBJECT_STORE (self),
+                                       object,
+                                       column,
+                                       &entries[i].key);
+        }
+    }
+
+  if (!priv->parallel_sort ||
+      n_entries < PARALLEL_SORT_MIN_ROWS ||
+      !sort_entries_parallel (order, n_entries, &closure))
+    {
+      g_qsort_with_data (order,
+                         n_entries,
+                         sizeof (SortEntry *),
+                         sort_entries_compare,
+                         &closure);
+    }
+
+  /* Moving the rows to the end in sorted order leaves them sorted, and
+   * keeps every GSequenceIter (and so every row lookup) valid. */
+  end_iter = g_sequence_get_end_iter (priv->sequence);
+  for (i = 0; i < n_entries; i++)
+    g_sequence_move (order[i]->seq_iter, end_iter);
+
+  for (i = 0; i < n_entries; i++)
+    if (G_IS_VALUE (&entries[i].key))
+      g_value_unset (&entries[i].key);
+
+  g_free (order);
+  g_free (entries);
+
+  /* The rows that pass the filter are now in a different order. */
+  foo_object_store_visible_invalidate (FOO_OBJECT_STORE (self));
+}
+
+/*
+ * Takes a row out of the sequence and every index that refers to it.
+ */
+static void
+foo_object_store_forget_row (FooObjectStore *self,
+                             GSequenceIter  *seq_iter)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+  GObject               *object;
+
+  object = g_sequence_get (seq_iter);
+  if (G_IS_OBJECT (object))
+    {
+      foo_object_store_detach_object (self, object, seq_iter);
+      g_object_unref (object);
+    }
+
+  foo_object_store_visible_remove (self, seq_iter);
+
+  g_hash_table_remove (priv->dirty, seq_iter);
+  if (priv->flushing)
+    g_hash_table_remove (priv->flushing, seq_iter);
+
+  g_sequence_remove (seq_iter);
 }
 
 static void
@@ -543,18 +967,54 @@ foo_object_store_row_removed (ClutterModel     *self,
                               ClutterModelIter *iter_)
 {
   FooObjectStoreIter  *iter;
-  GObject             *object;
 
   iter = FOO_OBJECT_STORE_ITER (iter_);
-  object = g_sequence_get (iter->seq_iter);
 
-  if (G_IS_OBJECT (object))
+  foo_object_store_forget_row (FOO_OBJECT_STORE (self), iter->seq_iter);
+}
+
+static void
+foo_object_store_filter_changed (ClutterModel *self)
+{
+  foo_object_store_visible_invalidate (FOO_OBJECT_STORE (self));
+}
+
+/* Like glib-genmarshal's, for GLib versions that can't pick a
+ * marshaller by themselves. */
+static void
+_foo_marshal_VOID__UINT_UINT (GClosure     *closure,
+                              GValue       *return_value G_GNUC_UNUSED,
+                              guint         n_param_values,
+                              const GValue *param_values,
+                              gpointer      invocation_hint G_GNUC_UNUSED,
+                              gpointer      marshal_data)
+{
+  typedef void (*MarshalFunc) (gpointer data1,
+                               guint    arg_1,
+                               guint    arg_2,
+                               gpointer data2);
+  GCClosure   *cc = (GCClosure *) closure;
+  gpointer     data1, data2;
+  MarshalFunc  callback;
+
+  g_return_if_fail (n_param_values == 3);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
     {
-      foo_object_store_detach_object (FOO_OBJECT_STORE (self), object);
-      g_object_unref (object);
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
     }
+  callback = (MarshalFunc) (marshal_data ? marshal_data : cc->callback);
 
-  g_sequence_remove (iter->seq_iter);
+  callback (data1,
+            g_value_get_uint (param_values + 1),
+            g_value_get_uint (param_values + 2),
+            data2);
 }
 
 static void
@@ -569,11 +1029,50 @@ foo_object_store_class_init (FooObjectStoreClass *klass)
   gobject_class->finalize = foo_object_store_finalize;
 
   store_class->get_iter_at_row = foo_object_store_get_iter_at_row;
+  store_class->get_n_rows      = foo_object_store_get_n_rows;
   store_class->insert_row      = foo_object_store_insert_row;
   store_class->remove_row      = foo_object_store_remove_row;
   store_class->resort          = foo_object_store_resort;
 
   store_class->row_removed     = foo_object_store_row_removed;
+  store_class->filter_changed  = foo_object_store_filter_changed;
+
+  /* Emitted once by foo_object_store_append_many(), for rows
+   * first_row to first_row + n_rows - 1. */
+  _signals[ROWS_ADDED] =
+    g_signal_new ("rows-added",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (FooObjectStoreClass, rows_added),
+                  NULL, NULL,
+                  _foo_marshal_VOID__UINT_UINT,
+                  G_TYPE_NONE, 2,
+                  G_TYPE_UINT, G_TYPE_UINT);
+
+  /* Emitted by foo_object_store_remove_many() once the rows are gone,
+   * for each run of adjacent rows, last run first. */
+  _signals[ROWS_REMOVED] =
+    g_signal_new ("rows-removed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (FooObjectStoreClass, rows_removed),
+                  NULL, NULL,
+                  _foo_marshal_VOID__UINT_UINT,
+                  G_TYPE_NONE, 2,
+                  G_TYPE_UINT, G_TYPE_UINT);
+}
+
+static void
+_accessors_free (FooObjectStoreAccessors *accessors)
+{
+  guint i;
+
+  for (i = 0; i < accessors->n_columns; i++)
+    if (accessors->columns[i].pspec)
+      g_param_spec_unref (accessors->columns[i].pspec);
+
+  g_free (accessors->columns);
+  g_slice_free (FooObjectStoreAccessors, accessors);
 }
 
 /*
@@ -595,6 +1094,20 @@ foo_object_store_init (FooObjectStore *self)
   priv->cached_iter = g_object_new (FOO_TYPE_OBJECT_STORE_ITER,
                                     "model", self,
                                     NULL);
+  priv->rows = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  priv->visible = g_sequence_new (NULL);
+  priv->visible_nodes = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->filter_iter = g_object_new (FOO_TYPE_OBJECT_STORE_ITER,
+                                    "model", self,
+                                    NULL);
+
+  priv->accessors = g_hash_table_new_full (g_direct_hash,
+                                           g_direct_equal,
+                                           NULL,
+                                           (GDestroyNotify) _accessors_free);
+
+  priv->dirty = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
 ClutterModel *
@@ -627,65 +1140,323 @@ foo_object_store_new (guint n_columns,
   return self;
 }
 
+static void
+foo_object_store_emit_row_changed (FooObjectStore *self,
+                                   GSequenceIter  *seq_iter)
+{
+  FooObjectStoreIter    *iter;
+
+  iter = g_object_new (FOO_TYPE_OBJECT_STORE_ITER,
+                       "model", self,
+                       NULL);
+  iter->seq_iter = seq_iter;
+  g_signal_emit_by_name (self, "row-changed", iter);
+  g_object_unref (iter);
+}
+
+static gint
+_compare_seq_iters_list (gconstpointer a,
+                         gconstpointer b)
+{
+  return g_sequence_iter_compare ((GSequenceIter *) a, (GSequenceIter *) b);
+}
+
+static gboolean
+_flush_idle (FooObjectStore *self);
+
+static void
+foo_object_store_queue_flush (FooObjectStore *self)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+
+  if (!priv->flush_id)
+    priv->flush_id = g_idle_add_full (CLUTTER_PRIORITY_REDRAW - 10,
+                                      (GSourceFunc) _flush_idle,
+                                      self,
+                                      NULL);
+}
+
+/*
+ * Emits "row-changed" once for every dirty row, in row order.
+ */
+static void
+foo_object_store_flush_changes (FooObjectStore *self)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+  GHashTable            *flushing;
+  GList                 *dirty;
+  GList                 *iter;
+
+  /* A handler flushing from within a flush leaves its changes, and the
+   * idle queued for them, to the end of this one. */
+  if (priv->flushing)
+    return;
+
+  if (priv->flush_id)
+    {
+      g_source_remove (priv->flush_id);
+      priv->flush_id = 0;
+    }
+
+  if (g_hash_table_size (priv->dirty) == 0)
+    return;
+
+  /* Handlers may change objects again, which starts a new batch, or
+   * remove rows, which drops them from this one. */
+  flushing = priv->dirty;
+  priv->dirty = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->flushing = flushing;
+
+  dirty = g_list_sort (g_hash_table_get_keys (flushing),
+                       _compare_seq_iters_list);
+
+  g_object_ref (self);
+  for (iter = dirty; iter; iter = iter->next)
+    {
+      if (g_hash_table_lookup (flushing, iter->data))
+        foo_object_store_emit_row_changed (self, iter->data);
+    }
+
+  priv->flushing = NULL;
+  g_hash_table_destroy (flushing);
+  g_list_free (dirty);
+
+  /* Changes made by the handlers whose flush was skipped above. */
+  if (priv->freeze_count == 0 && g_hash_table_size (priv->dirty) > 0)
+    foo_object_store_queue_flush (self);
+
+  g_object_unref (self);
+}
+
+static gboolean
+_flush_idle (FooObjectStore *self)
+{
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+
+  priv->flush_id = 0;
+  foo_object_store_flush_changes (self);
+
+  return FALSE;
+}
+
 static void
 foo_object_store_object_property_notify (GObject         *object,
                                          GParamSpec      *pspec,
                                          FooObjectStore  *self)
 {
   FooObjectStorePrivate *priv = GET_PRIVATE (self);
-  GSequenceIter         *seq_iter;
-  FooObjectStoreIter    *iter;
-  GSequenceIter         *notify_seq_iter = NULL;
+  GSequenceIter         *notify_seq_iter;
 
   /* Find corresponding row of changed object. */
-  for (seq_iter = g_sequence_get_begin_iter (priv->sequence);
-       !g_sequence_iter_is_end (seq_iter);
-       seq_iter = g_sequence_iter_next (seq_iter))
+  notify_seq_iter = g_hash_table_lookup (priv->rows, object);
+
+  g_return_if_fail (notify_seq_iter);
+
+  foo_object_store_visible_update (self, notify_seq_iter);
+
+  if (priv->freeze_count > 0)
     {
-      if (object == g_sequence_get (seq_iter))
+      g_hash_table_insert (priv->dirty, notify_seq_iter, notify_seq_iter);
+    }
+  else if (priv->coalesce_changes)
+    {
+      g_hash_table_insert (priv->dirty, notify_seq_iter, notify_seq_iter);
+      foo_object_store_queue_flush (self);
+    }
+  else
+    {
+      foo_object_store_emit_row_changed (self, notify_seq_iter);
+    }
+}
+
+/*
+ * Column accessors.
+ */
+
+/*
+ * g_object_class_find_property() follows overrides to the pspec they
+ * redirect to, which names the class (or interface) that first declared the
+ * property. Find the entry klass actually registered for it instead, the one
+ * g_object_get_property() dispatches through.
+ */
+static GParamSpec *
+_find_implementing_pspec (GParamSpec  **pspecs,
+                          guint         n_pspecs,
+                          GParamSpec   *target)
+{
+  guint i;
+
+  for (i = 0; i < n_pspecs; i++)
+    if (pspecs[i] == target ||
+        g_param_spec_get_redirect_target (pspecs[i]) == target)
+      return pspecs[i];
+
+  return NULL;
+}
+
+static FooObjectStoreAccessors *
+foo_object_store_lookup_accessors (FooObjectStore *self,
+                                   GType           type)
+{
+  FooObjectStorePrivate   *priv = GET_PRIVATE (self);
+  FooObjectStoreAccessors *accessors;
+  GObjectClass            *klass;
+  GParamSpec             **pspecs;
+  guint                    n_pspecs;
+  guint                    i;
+
+  if (type == priv->last_type)
+    return priv->last_accessors;
+
+  accessors = g_hash_table_lookup (priv->accessors, GSIZE_TO_POINTER (type));
+  if (!accessors)
+    {
+      accessors = g_slice_new (FooObjectStoreAccessors);
+      accessors->n_columns = clutter_model_get_n_columns (CLUTTER_MODEL (self));
+      accessors->columns = g_new0 (FooObjectStoreColumn, accessors->n_columns);
+
+      klass = g_type_class_peek (type);
+      pspecs = g_object_class_list_properties (klass, &n_pspecs);
+
+      /* Column 0 holds the object itself. */
+      for (i = 1; i < accessors->n_columns; i++)
         {
-          notify_seq_iter = seq_iter;
-          break;
+          FooObjectStoreColumn *column = &accessors->columns[i];
+          const gchar          *name;
+          GParamSpec           *implementing;
+          GType                 column_type;
+          GType                 fundamental;
+
+          name = clutter_model_get_column_name (CLUTTER_MODEL (self), i);
+          column->pspec = g_object_class_find_property (klass, name);
+          if (!column->pspec)
+            continue;
+
+          g_param_spec_ref (column->pspec);
+
+          /* Overridden and interface properties are read through the class
+           * that implements the override, with its param_id. */
+          implementing = _find_implementing_pspec (pspecs, n_pspecs,
+                                                   column->pspec);
+          if (implementing &&
+              !G_TYPE_IS_INTERFACE (implementing->owner_type))
+            {
+              column->owner_class = g_type_class_peek (implementing->owner_type);
+              column->param_id = implementing->param_id;
+            }
+
+          /* Plain values of the column's own type can be fetched straight
+           * from the owning class, skipping the lookup by name and the
+           * temporary GValue that g_object_get_property() goes through. */
+          column_type = clutter_model_get_column_type (CLUTTER_MODEL (self), i);
+          fundamental = G_TYPE_FUNDAMENTAL (column_type);
+          column->fast = column->owner_class &&
+                         column->owner_class->get_property &&
+                         (column->pspec->flags & G_PARAM_READABLE) &&
+                         column->pspec->value_type == column_type &&
+                         (fundamental == G_TYPE_INT ||
+                          fundamental == G_TYPE_UINT ||
+                          fundamental == G_TYPE_BOOLEAN ||
+                          fundamental == G_TYPE_DOUBLE ||
+                          fundamental == G_TYPE_FLOAT ||
+                          fundamental == G_TYPE_STRING);
         }
+
+      g_free (pspecs);
+      g_hash_table_insert (priv->accessors, GSIZE_TO_POINTER (type), accessors);
     }
 
-  g_return_if_fail (notify_seq_iter);
+  priv->last_type = type;
+  priv->last_accessors = accessors;
 
-  iter = g_object_new (FOO_TYPE_OBJECT_STORE_ITER,
-                       "model", self,
-                       NULL);
-  iter->seq_iter = notify_seq_iter;
-  g_signal_emit_by_name (self, "row-changed", iter);
-  g_object_unref (iter);
+  return accessors;
+}
+
+/*
+ * Reads a property column of object into value, which must be initialised.
+ */
+static void
+foo_object_store_get_column (FooObjectStore *self,
+                             GObject        *object,
+                             guint           column,
+                             GValue         *value)
+{
+  FooObjectStoreAccessors *accessors;
+  FooObjectStoreColumn    *accessor;
+
+  accessors = foo_object_store_lookup_accessors (self, G_OBJECT_TYPE (object));
+  accessor = &accessors->columns[column];
+
+  if (accessor->fast &&
+      G_VALUE_TYPE (value) == accessor->pspec->value_type)
+    {
+      accessor->owner_class->get_property (object,
+                                           accessor->param_id,
+                                           value,
+                                           accessor->pspec);
+    }
+  else
+    {
+      /* Let GObject convert the value, or complain. */
+      g_object_get_property (object,
+                             clutter_model_get_column_name (CLUTTER_MODEL (self),
+                                                            column),
+                             value);
+    }
 }
 
 static void
 foo_object_store_attach_object (FooObjectStore  *self,
-                                GObject         *object)
+                                GObject         *object,
+                                GSequenceIter   *seq_iter)
 {
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
   guint        n_columns;
-  const gchar *column_name;
-  gchar       *signal_name;
   guint        i;
 
-  /* Start at column 1 because 0 hold the actual object. */
+  g_hash_table_insert (priv->rows, object, seq_iter);
+
+  /* Resolve the columns for this class up front, rather than on first read. */
+  foo_object_store_lookup_accessors (self, G_OBJECT_TYPE (object));
+
   n_columns = clutter_model_get_n_columns (CLUTTER_MODEL (self));
+  if (!priv->notify_details)
+    {
+      priv->notify_id = g_signal_lookup ("notify", G_TYPE_OBJECT);
+      priv->notify_details = g_new0 (GQuark, n_columns);
+      for (i = 1; i < n_columns; i++)
+        priv->notify_details[i] =
+          g_quark_from_string (clutter_model_get_column_name (CLUTTER_MODEL (self),
+                                                              i));
+    }
+
+  /* Start at column 1 because 0 hold the actual object. */
   for (i = 1; i < n_columns; i++)
     {
-      column_name = clutter_model_get_column_name (CLUTTER_MODEL (self), i);
-      signal_name = g_strdup_printf ("notify::%s", column_name);
-      g_signal_connect (object,
-                        signal_name,
-                        G_CALLBACK (foo_object_store_object_property_notify),
-                        self);
-      g_free (signal_name);
+      GClosure *closure;
+
+      closure = g_cclosure_new (G_CALLBACK (foo_object_store_object_property_notify),
+                                self,
+                                NULL);
+      g_signal_connect_closure_by_id (object,
+                                      priv->notify_id,
+                                      priv->notify_details[i],
+                                      closure,
+                                      FALSE);
     }
 }
 
 static void
 foo_object_store_detach_object (FooObjectStore  *self,
-                                GObject         *object)
+                                GObject         *object,
+                                GSequenceIter   *seq_iter)
 {
+  FooObjectStorePrivate *priv = GET_PRIVATE (self);
+
+  /* The object may have been added again since, in another row. */
+  if (g_hash_table_lookup (priv->rows, object) == seq_iter)
+    g_hash_table_remove (priv->rows, object);
+
   g_signal_handlers_disconnect_by_func (object,
                                         foo_object_store_object_property_notify,
                                         self);
@@ -724,26 +1495,244 @@ foo_object_store_remove (FooObjectStore  *self,
 {
   FooObjectStorePrivate *priv;
   GSequenceIter *seq_iter;
-  gint           row = -1;
+  gint           row;
 
   g_return_val_if_fail (FOO_IS_OBJECT_STORE (self), FALSE);
   g_return_val_if_fail (G_IS_OBJECT (object), FALSE);
 
   priv = GET_PRIVATE (self);
 
-  for (seq_iter = g_sequence_get_begin_iter (priv->sequence);
-       !g_sequence_iter_is_end (seq_iter);
-       seq_iter = g_sequence_iter_next (seq_iter))
+  seq_iter = g_hash_table_lookup (priv->rows, object);
+  if (!seq_iter)
+    return -1;
+
+  row = g_sequence_iter_get_position (seq_iter);
+  foo_object_store_remove_row (CLUTTER_MODEL (self), row);
+
+  return row;
+}
+
+/*
+ * Sort large stores on two threads. The sort function is then called
+ * from a second thread too, on copies of the column values.
+ */
+void
+foo_object_store_set_parallel_sort (FooObjectStore  *self,
+                                    gboolean         parallel_sort)
+{
+  FooObjectStorePrivate *priv;
+
+  g_return_if_fail (FOO_IS_OBJECT_STORE (self));
+
+  priv = GET_PRIVATE (self);
+  priv->parallel_sort = parallel_sort;
+}
+
+gboolean
+foo_object_store_get_parallel_sort (FooObjectStore *self)
+{
+  g_return_val_if_fail (FOO_IS_OBJECT_STORE (self), FALSE);
+
+  return GET_PRIVATE (self)->parallel_sort;
+}
+
+/*
+ * Instead of emitting "row-changed" as soon as a proxied property changes,
+ * collect the changed rows and report each of them once, from an idle
+ * that runs just before the stage is redrawn.
+ */
+void
+foo_object_store_set_coalesce_changes (FooObjectStore  *self,
+                                       gboolean         coalesce_changes)
+{
+  FooObjectStorePrivate *priv;
+
+  g_return_if_fail (FOO_IS_OBJECT_STORE (self));
+
+  priv = GET_PRIVATE (self);
+  priv->coalesce_changes = coalesce_changes;
+
+  if (!coalesce_changes && priv->freeze_count == 0)
+    foo_object_store_flush_changes (self);
+}
+
+gboolean
+foo_object_store_get_coalesce_changes (FooObjectStore *self)
+{
+  g_return_val_if_fail (FOO_IS_OBJECT_STORE (self), FALSE);
+
+  return GET_PRIVATE (self)->coalesce_changes;
+}
+
+/*
+ * Holds back "row-changed" until the matching thaw. Calls nest.
+ */
+void
+foo_object_store_freeze_changes (FooObjectStore *self)
+{
+  g_return_if_fail (FOO_IS_OBJECT_STORE (self));
+
+  GET_PRIVATE (self)->freeze_count++;
+}
+
+/*
+ * Emits "row-changed" for each row that changed since the outermost
+ * freeze.
+ */
+void
+foo_object_store_thaw_changes (FooObjectStore *self)
+{
+  FooObjectStorePrivate *priv;
+
+  g_return_if_fail (FOO_IS_OBJECT_STORE (self));
+
+  priv = GET_PRIVATE (self);
+  g_return_if_fail (priv->freeze_count > 0);
+
+  if (--priv->freeze_count == 0)
+    foo_object_store_flush_changes (self);
+}
+
+/*
+ * Appends n_objects objects in one go, emitting "row-added" for each of
+ * them and "rows-added" once for the whole range.
+ */
+void
+foo_object_store_append_many (FooObjectStore  *self,
+                              GObject        **objects,
+                              guint            n_objects)
+{
+  FooObjectStorePrivate *priv;
+  FooObjectStoreIter    *iter;
+  guint                  first_row;
+  guint                  i;
+
+  g_return_if_fail (FOO_IS_OBJECT_STORE (self));
+  g_return_if_fail (objects || n_objects == 0);
+
+  if (n_objects == 0)
+    return;
+
+  /* Check everything first, so that a bad element doesn't leave the
+   * store half filled. */
+  for (i = 0; i < n_objects; i++)
+    g_return_if_fail (G_IS_OBJECT (objects[i]));
+
+  priv = GET_PRIVATE (self);
+
+  iter = g_object_new (FOO_TYPE_OBJECT_STORE_ITER,
+                       "model", self,
+                       NULL);
+
+  first_row = g_sequence_get_length (priv->sequence);
+  for (i = 0; i < n_objects; i++)
+    {
+      GSequenceIter *seq_iter;
+
+      seq_iter = g_sequence_append (priv->sequence, g_object_ref (objects[i]));
+      foo_object_store_attach_object (self, objects[i], seq_iter);
+      foo_object_store_visible_update (self, seq_iter);
+
+      /* Like removals, always emit: the class handler and emission hooks
+       * see the signal whether or not anything is connected. */
+      g_object_set (iter, "row", first_row + i, NULL);
+      iter->seq_iter = seq_iter;
+      g_signal_emit_by_name (self, "row-added", iter);
+    }
+
+  g_object_unref (iter);
+
+  g_signal_emit (self, _signals[ROWS_ADDED], 0, first_row, n_objects);
+
+  if (clutter_model_get_sorting_column (CLUTTER_MODEL (self)) >= 0)
+    {
+      clutter_model_resort (CLUTTER_MODEL (self));
+      g_signal_emit_by_name (self, "sort-changed");
+    }
+}
+
+typedef struct
+{
+  GSequenceIter *seq_iter;
+  guint          row;
+} RemoveEntry;
+
+static gint
+_compare_remove_entries (gconstpointer a,
+                         gconstpointer b)
+{
+  const RemoveEntry *ea = a;
+  const RemoveEntry *eb = b;
+
+  return ea->row < eb->row ? -1 : ea->row > eb->row;
+}
+
+/*
+ * Removes those of n_objects objects that are in the store, and returns
+ * how many were. "row-removed" is emitted for each row, then
+ * "rows-removed" for each run of adjacent rows.
+ */
+guint
+foo_object_store_remove_many (FooObjectStore  *self,
+                              GObject        **objects,
+                              guint            n_objects)
+{
+  FooObjectStorePrivate *priv;
+  RemoveEntry           *entries;
+  guint                  n_entries;
+  guint                  i, j;
+
+  g_return_val_if_fail (FOO_IS_OBJECT_STORE (self), 0);
+  g_return_val_if_fail (objects || n_objects == 0, 0);
+
+  priv = GET_PRIVATE (self);
+
+  /* Find the rows, dropping objects that aren't in the store or are
+   * listed twice. */
+  entries = g_new (RemoveEntry, n_objects);
+  n_entries = 0;
+  for (i = 0; i < n_objects; i++)
     {
-      GObject *o = g_sequence_get (seq_iter);
-      row++;
-      if (o == object)
+      GSequenceIter *seq_iter = g_hash_table_lookup (priv->rows, objects[i]);
+
+      if (seq_iter)
         {
-          foo_object_store_remove_row (CLUTTER_MODEL (self), row);
-          break;
+          entries[n_entries].seq_iter = seq_iter;
+          entries[n_entries].row = g_sequence_iter_get_position (seq_iter);
+          n_entries++;
         }
     }
 
-  return row;
-}
+  qsort (entries, n_entries, sizeof (RemoveEntry), _compare_remove_entries);
+
+  for (i = 0, j = 0; i < n_entries; i++)
+    if (j == 0 || entries[i].row != entries[j - 1].row)
+      entries[j++] = entries[i];
+  n_entries = j;
+
+  /* Always go through ::row-removed, whose class handler (possibly a
+   * subclass's) does the removing. Last row first, so the rows still to
+   * go keep their positions. */
+  for (i = n_entries; i > 0; i--)
+    foo_object_store_remove_row (CLUTTER_MODEL (self), entries[i - 1].row);
 
+  /* Report runs of adjacent rows, last first, so that each range is
+   * still correct for a listener applying them in turn. */
+  i = n_entries;
+  while (i > 0)
+    {
+      guint last = i - 1;
+      guint first = last;
+
+      while (first > 0 && entries[first - 1].row + 1 == entries[first].row)
+        first--;
+
+      g_signal_emit (self, _signals[ROWS_REMOVED], 0,
+                     entries[first].row, last - first + 1);
+      i = first;
+    }
+
+  g_free (entries);
+
+  return n_entries;
+}
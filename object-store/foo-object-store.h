@@ -56,6 +56,13 @@ struct FooObjectStore_ {
 
 struct FooObjectStoreClass_ {
   ClutterModelClass parent;
+
+  void (* rows_added)   (FooObjectStore *self,
+                         guint           first_row,
+                         guint           n_rows);
+  void (* rows_removed) (FooObjectStore *self,
+                         guint           first_row,
+                         guint           n_rows);
 };
 
 GType foo_object_store_get_type (void) G_GNUC_CONST;
@@ -70,6 +77,28 @@ void foo_object_store_foreach_unfiltered (FooObjectStore          *self,
 gint foo_object_store_remove (FooObjectStore  *self,
                               GObject         *object);
 
+void foo_object_store_set_parallel_sort (FooObjectStore  *self,
+                                         gboolean         parallel_sort);
+
+gboolean foo_object_store_get_parallel_sort (FooObjectStore *self);
+
+void foo_object_store_set_coalesce_changes (FooObjectStore  *self,
+                                            gboolean         coalesce_changes);
+
+gboolean foo_object_store_get_coalesce_changes (FooObjectStore *self);
+
+void foo_object_store_freeze_changes (FooObjectStore *self);
+
+void foo_object_store_thaw_changes (FooObjectStore *self);
+
+void foo_object_store_append_many (FooObjectStore  *self,
+                                   GObject        **objects,
+                                   guint            n_objects);
+
+guint foo_object_store_remove_many (FooObjectStore  *self,
+                                    GObject        **objects,
+                                    guint            n_objects);
+
 G_END_DECLS
 
 #endif /* FOO_OBJECT_STORE_H */
@@ -0,0 +1,289 @@
+/*
+ * Timings for the common FooObjectStore operations, at a few store sizes.
+ *
+ *   object-store-benchmark [max-rows]
+ *
+ * Allocations are counted through g_mem_set_vtable(), with GSlice made
+ * to use malloc. GLib 2.46 and later ignore the vtable, in which case
+ * the allocation column shows "-".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <clutter/clutter.h>
+#include "foo-object-store.h"
+#include "foo-test-object.h"
+
+enum
+{
+  COLUMN_OBJECT,  /* FOO_TYPE_OBJECT_STORE */
+  COLUMN_NUMBER,  /* G_TYPE_INT */
+  COLUMN_TEXT,    /* G_TYPE_STRING */
+
+  N_COLUMNS
+};
+
+static const guint sizes[] = { 1000, 10000, 100000 };
+
+static gboolean counting_allocations = FALSE;
+static guint64  n_allocations = 0;
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+  n_allocations++;
+  return malloc (n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem,
+                  gsize    n_bytes)
+{
+  n_allocations++;
+  return realloc (mem, n_bytes);
+}
+
+static gpointer
+counting_calloc (gsize n_blocks,
+                 gsize n_block_bytes)
+{
+  n_allocations++;
+  return calloc (n_blocks, n_block_bytes);
+}
+
+static GMemVTable counting_vtable = {
+  counting_malloc,
+  counting_realloc,
+  free,
+  counting_calloc,
+  NULL,
+  NULL
+};
+
+typedef struct
+{
+  GTimer  *timer;
+  guint64  allocations;
+} Measure;
+
+static void
+measure_start (Measure *measure)
+{
+  measure->allocations = n_allocations;
+  g_timer_start (measure->timer);
+}
+
+static void
+measure_stop (Measure     *measure,
+              const gchar *name,
+              guint        n_rows,
+              guint        n_ops)
+{
+  gdouble elapsed;
+  guint64 allocations;
+
+  g_timer_stop (measure->timer);
+  elapsed = g_timer_elapsed (measure->timer, NULL);
+  allocations = n_allocations - measure->allocations;
+
+  if (counting_allocations)
+    g_print ("%-28s %8u %12.1f ns/op %10.2f allocs/op\n",
+             name, n_rows,
+             elapsed * 1e9 / n_ops,
+             (gdouble) allocations / n_ops);
+  else
+    g_print ("%-28s %8u %12.1f ns/op %10s allocs/op\n",
+             name, n_rows,
+             elapsed * 1e9 / n_ops,
+             "-");
+}
+
+/*
+ * Visits the rows in a fixed scrambled order, the same on every run.
+ */
+static inline guint
+scramble (guint i,
+          guint n_rows)
+{
+  return (guint) (((guint64) i * 7919) % n_rows);
+}
+
+static gboolean
+filter_odd_rows (ClutterModel     *model,
+                 ClutterModelIter *iter,
+                 gpointer          dummy G_GNUC_UNUSED)
+{
+  gint number;
+
+  clutter_model_iter_get (iter, COLUMN_NUMBER, &number, -1);
+
+  return number % 2 != 0;
+}
+
+static gint
+sort_descending (ClutterModel *model,
+                 const GValue *a,
+                 const GValue *b,
+                 gpointer      dummy G_GNUC_UNUSED)
+{
+  return g_value_get_int (b) - g_value_get_int (a);
+}
+
+static void
+on_row_changed (ClutterModel     *model,
+                ClutterModelIter *iter,
+                guint            *n_changed)
+{
+  *n_changed += 1;
+}
+
+static ClutterModel *
+new_store (void)
+{
+  return foo_object_store_new (N_COLUMNS,
+                               FOO_TYPE_TEST_OBJECT, "object",
+                               G_TYPE_INT,           "number",
+                               G_TYPE_STRING,        "text");
+}
+
+static void
+run (guint n_rows)
+{
+  Measure            measure;
+  GObject          **objects;
+  ClutterModel      *model;
+  ClutterModelIter  *iter;
+  guint              n_changed = 0;
+  guint              n_visited;
+  guint              i;
+
+  measure.timer = g_timer_new ();
+
+  objects = g_new (GObject *, n_rows);
+  for (i = 0; i < n_rows; i++)
+    {
+      gchar *text = g_strdup_printf ("String %u", i);
+      objects[i] = g_object_new (FOO_TYPE_TEST_OBJECT,
+                                 "number", (gint) scramble (i, n_rows),
+                                 "text", text,
+                                 NULL);
+      g_free (text);
+    }
+
+  /* Filling the store, one row at a time and all at once. */
+  model = new_store ();
+  measure_start (&measure);
+  for (i = 0; i < n_rows; i++)
+    clutter_model_append (model, COLUMN_OBJECT, objects[i], -1);
+  measure_stop (&measure, "append", n_rows, n_rows);
+  g_object_unref (model);
+
+  model = new_store ();
+  measure_start (&measure);
+  foo_object_store_append_many (FOO_OBJECT_STORE (model), objects, n_rows);
+  measure_stop (&measure, "append_many", n_rows, n_rows);
+
+  /* Random access. */
+  measure_start (&measure);
+  for (i = 0; i < n_rows; i++)
+    {
+      iter = clutter_model_get_iter_at_row (model, scramble (i, n_rows));
+      g_object_unref (iter);
+    }
+  measure_stop (&measure, "get_iter_at_row", n_rows, n_rows);
+
+  clutter_model_set_filter (model, filter_odd_rows, NULL, NULL);
+  measure_start (&measure);
+  for (i = 0; i < n_rows / 2; i++)
+    {
+      iter = clutter_model_get_iter_at_row (model, scramble (i, n_rows / 2));
+      g_object_unref (iter);
+    }
+  measure_stop (&measure, "get_iter_at_row (filtered)", n_rows, n_rows / 2);
+  clutter_model_set_filter (model, NULL, NULL, NULL);
+
+  /* Walking the store. */
+  iter = clutter_model_get_first_iter (model);
+  n_visited = 0;
+  measure_start (&measure);
+  while (!clutter_model_iter_is_last (iter))
+    {
+      clutter_model_iter_next (iter);
+      n_visited++;
+    }
+  measure_stop (&measure, "iter_next", n_rows, n_visited);
+  g_object_unref (iter);
+
+  iter = clutter_model_get_last_iter (model);
+  n_visited = 0;
+  measure_start (&measure);
+  while (!clutter_model_iter_is_first (iter))
+    {
+      clutter_model_iter_prev (iter);
+      n_visited++;
+    }
+  measure_stop (&measure, "iter_prev", n_rows, MAX (n_visited, 1));
+  g_object_unref (iter);
+
+  /* Sorting, per row sorted. */
+  measure_start (&measure);
+  clutter_model_set_sort (model, COLUMN_NUMBER, sort_descending, NULL, NULL);
+  measure_stop (&measure, "resort", n_rows, n_rows);
+
+  /* Property changes reaching "row-changed". */
+  g_signal_connect (model, "row-changed",
+                    G_CALLBACK (on_row_changed), &n_changed);
+  measure_start (&measure);
+  for (i = 0; i < n_rows; i++)
+    foo_test_object_set_number (FOO_TEST_OBJECT (objects[i]), i);
+  measure_stop (&measure, "notify -> row-changed", n_rows, n_rows);
+  g_assert_cmpuint (n_changed, ==, n_rows);
+
+  clutter_model_set_sort (model, -1, NULL, NULL, NULL);
+
+  /* Emptying the store again, in scrambled order. */
+  measure_start (&measure);
+  for (i = 0; i < n_rows; i++)
+    foo_object_store_remove (FOO_OBJECT_STORE (model),
+                             objects[scramble (i, n_rows)]);
+  measure_stop (&measure, "remove (by object)", n_rows, n_rows);
+  g_assert_cmpuint (clutter_model_get_n_rows (model), ==, 0);
+
+  g_object_unref (model);
+
+  for (i = 0; i < n_rows; i++)
+    g_object_unref (objects[i]);
+  g_free (objects);
+
+  g_timer_destroy (measure.timer);
+}
+
+int
+main (int     argc,
+      char  **argv)
+{
+  guint max_rows = G_MAXUINT;
+  guint i;
+
+  /* Both have to happen before GLib allocates anything. */
+  setenv ("G_SLICE", "always-malloc", TRUE);
+  g_mem_set_vtable (&counting_vtable);
+  counting_allocations = !g_mem_is_system_malloc ();
+
+  clutter_init (&argc, &argv);
+
+  if (argc > 1)
+    max_rows = atoi (argv[1]);
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      if (sizes[i] > max_rows)
+        break;
+
+      run (sizes[i]);
+      g_print ("\n");
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -160,6 +160,147 @@ filter_odd_rows (ClutterModel     *model,
   return FALSE;
 }
 
+/* An interface with an int property, and a FooTestObject subclass that
+ * implements it and overrides "number", to exercise columns whose pspec
+ * g_object_class_find_property() resolves to another owner.
+ */
+typedef GTypeInterface FooTestCountedInterface;
+
+static void
+foo_test_counted_default_init (FooTestCountedInterface *iface)
+{
+  g_object_interface_install_property (iface,
+                                       g_param_spec_int ("count", "", "",
+                                                         G_MININT32, G_MAXINT32,
+                                                         0,
+                                                         G_PARAM_READABLE));
+}
+
+G_DEFINE_INTERFACE (FooTestCounted, foo_test_counted, G_TYPE_OBJECT)
+
+typedef FooTestObject FooTestDerived;
+typedef FooTestObjectClass FooTestDerivedClass;
+
+G_DEFINE_TYPE_WITH_CODE (FooTestDerived, foo_test_derived, FOO_TYPE_TEST_OBJECT,
+                         G_IMPLEMENT_INTERFACE (foo_test_counted_get_type (),
+                                                NULL))
+
+enum
+{
+  DERIVED_PROP_0,
+  DERIVED_PROP_NUMBER,
+  DERIVED_PROP_COUNT
+};
+
+static void
+_derived_get_property (GObject    *object,
+                       unsigned    property_id,
+                       GValue     *value,
+                       GParamSpec *pspec)
+{
+  gint number = foo_test_object_get_number (FOO_TEST_OBJECT (object));
+
+  switch (property_id)
+  {
+  case DERIVED_PROP_NUMBER:
+    g_value_set_int (value, number * 10);
+    break;
+  case DERIVED_PROP_COUNT:
+    g_value_set_int (value, number + 100);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+  }
+}
+
+static void
+_derived_set_property (GObject      *object,
+                       unsigned      property_id,
+                       const GValue *value,
+                       GParamSpec   *pspec)
+{
+  switch (property_id)
+  {
+  case DERIVED_PROP_NUMBER:
+    foo_test_object_set_number (FOO_TEST_OBJECT (object),
+                                g_value_get_int (value));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+  }
+}
+
+static void
+foo_test_derived_class_init (FooTestDerivedClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->get_property = _derived_get_property;
+  object_class->set_property = _derived_set_property;
+
+  g_object_class_override_property (object_class,
+                                    DERIVED_PROP_NUMBER, "number");
+  g_object_class_override_property (object_class,
+                                    DERIVED_PROP_COUNT, "count");
+}
+
+static void
+foo_test_derived_init (FooTestDerived *self)
+{
+}
+
+/* Nine test objects, numbered 1 to 9, with texts "String 1" to "String 9" */
+static void
+make_objects (GObject **objects)
+{
+  gint i;
+
+  for (i = 1; i < 10; i++)
+    {
+      gchar *foo = g_strdup_printf ("String %d", i);
+      objects[i - 1] = g_object_new (FOO_TYPE_TEST_OBJECT,
+                                     "number", i,
+                                     "text", foo,
+                                     NULL);
+      g_free (foo);
+    }
+}
+
+static ClutterModel *
+make_store (void)
+{
+  return foo_object_store_new (N_COLUMNS,
+                               FOO_TYPE_TEST_OBJECT, "object",
+                               G_TYPE_INT,           "number",
+                               G_TYPE_STRING,        "text");
+}
+
+/* A store holding the objects from make_objects(). If objects isn't NULL,
+ * it's filled in with them, and the caller has to unref them.
+ */
+static ClutterModel *
+make_populated_store (GObject **objects)
+{
+  ClutterModel *model;
+  GObject *own_objects[9];
+  gint i;
+
+  model = make_store ();
+  make_objects (objects ? objects : own_objects);
+
+  for (i = 0; i < 9; i++)
+    {
+      GObject *object = objects ? objects[i] : own_objects[i];
+
+      clutter_model_append (model, COLUMN_OBJECT, object, -1);
+
+      if (!objects)
+        g_object_unref (object);
+    }
+
+  return model;
+}
+
 void
 test_list_model_filter (void)
 {
@@ -349,16 +490,484 @@ test_list_model_populate (void)
   g_object_unref (test_data.model);
 }
 
+static void
+on_row_changed (ClutterModel     *model,
+                ClutterModelIter *iter,
+                gpointer          data)
+{
+  GObject **changed = data;
+
+  clutter_model_iter_get (iter, COLUMN_OBJECT, changed, -1);
+  g_object_unref (*changed);
+}
+
+void
+test_object_store_remove (void)
+{
+  ModelData test_data = { NULL, 0 };
+  GObject *objects[9];
+  GObject *changed = NULL;
+  gint i;
+
+  test_data.model = make_populated_store (objects);
+
+  g_signal_connect (test_data.model, "row-changed",
+                    G_CALLBACK (on_row_changed),
+                    &changed);
+
+  /* Property changes are reported on the object's own row. */
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[6]), 70);
+  g_assert (changed == objects[6]);
+
+  if (g_test_verbose ())
+    g_print ("Removing by object...\n");
+
+  g_assert_cmpint (foo_object_store_remove (FOO_OBJECT_STORE (test_data.model),
+                                            objects[2]), ==, 2);
+  g_assert_cmpint (clutter_model_get_n_rows (test_data.model), ==, 8);
+  g_assert_cmpint (foo_object_store_remove (FOO_OBJECT_STORE (test_data.model),
+                                            objects[2]), ==, -1);
+
+  /* Removed objects are no longer watched. */
+  changed = NULL;
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[2]), 30);
+  g_assert (changed == NULL);
+
+  /* Rows after the removed one still map to their objects. */
+  g_assert_cmpint (foo_object_store_remove (FOO_OBJECT_STORE (test_data.model),
+                                            objects[8]), ==, 7);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[6]), 7);
+  g_assert (changed == objects[6]);
+
+  g_object_unref (test_data.model);
+
+  for (i = 0; i < 9; i++)
+    g_object_unref (objects[i]);
+}
+
+void
+test_object_store_filter_rows (void)
+{
+  ModelData test_data = { NULL, 0 };
+  ClutterModelIter *iter;
+  GObject *objects[9];
+  gint i;
+
+  test_data.model = make_populated_store (objects);
+
+  clutter_model_set_filter (test_data.model, filter_odd_rows, NULL, NULL);
+  g_assert_cmpint (clutter_model_get_n_rows (test_data.model), ==, 5);
+
+  if (g_test_verbose ())
+    g_print ("Random access (filter odd)...\n");
+
+  for (i = G_N_ELEMENTS (filter_odd) - 1; i >= 0; i--)
+    {
+      iter = clutter_model_get_iter_at_row (test_data.model, i);
+      compare_iter (iter, i,
+                    filter_odd[i].expected_foo,
+                    filter_odd[i].expected_bar);
+      g_object_unref (iter);
+    }
+
+  g_assert (clutter_model_get_iter_at_row (test_data.model, 5) == NULL);
+
+  /* Rows move in and out of the filter as their objects change. */
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[2]), 4);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[3]), 5);
+  g_assert_cmpint (clutter_model_get_n_rows (test_data.model), ==, 5);
+
+  iter = clutter_model_get_iter_at_row (test_data.model, 1);
+  compare_iter (iter, 1, "String 4", 5);
+  g_object_unref (iter);
+
+  g_assert_cmpint (foo_object_store_remove (FOO_OBJECT_STORE (test_data.model),
+                                            objects[0]), ==, 0);
+  g_assert_cmpint (clutter_model_get_n_rows (test_data.model), ==, 4);
+
+  iter = clutter_model_get_first_iter (test_data.model);
+  compare_iter (iter, 0, "String 4", 5);
+  g_object_unref (iter);
+
+  /* Stepping off a row that has just been filtered out. */
+  iter = clutter_model_get_iter_at_row (test_data.model, 1);
+  compare_iter (iter, 1, "String 5", 5);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[4]), 6);
+  iter = clutter_model_iter_next (iter);
+  compare_iter (iter, 1, "String 7", 7);
+  g_object_unref (iter);
+
+  clutter_model_set_filter (test_data.model, NULL, NULL, NULL);
+  g_assert_cmpint (clutter_model_get_n_rows (test_data.model), ==, 8);
+
+  g_object_unref (test_data.model);
+
+  for (i = 0; i < 9; i++)
+    g_object_unref (objects[i]);
+}
+
+static gint
+sort_descending (ClutterModel *model,
+                 const GValue *a,
+                 const GValue *b,
+                 gpointer      dummy G_GNUC_UNUSED)
+{
+  return g_value_get_int (b) - g_value_get_int (a);
+}
+
+void
+test_object_store_sort (void)
+{
+  ModelData test_data = { NULL, 0 };
+  ClutterModelIter *iter;
+  gint i;
+
+  test_data.model = make_populated_store (NULL);
+
+  if (g_test_verbose ())
+    g_print ("Sorting by number, descending...\n");
+
+  clutter_model_set_sort (test_data.model, COLUMN_NUMBER,
+                          sort_descending, NULL, NULL);
+
+  iter = clutter_model_get_first_iter (test_data.model);
+  g_assert (iter != NULL);
+
+  i = 0;
+  while (!clutter_model_iter_is_last (iter))
+    {
+      compare_iter (iter, i,
+                    backward_base[i].expected_foo,
+                    backward_base[i].expected_bar);
+
+      iter = clutter_model_iter_next (iter);
+      i += 1;
+    }
+
+  g_assert_cmpint (i, ==, G_N_ELEMENTS (backward_base));
+  g_object_unref (iter);
+
+  g_object_unref (test_data.model);
+}
+
+typedef struct
+{
+  GThread  *main_thread;
+  gboolean  other_thread;
+} SortThreads;
+
+/* Like sort_descending, noting whether it ran off the main thread. */
+static gint
+sort_descending_threads (ClutterModel *model,
+                         const GValue *a,
+                         const GValue *b,
+                         gpointer      data)
+{
+  SortThreads *threads = data;
+
+  if (g_thread_self () != threads->main_thread)
+    threads->other_thread = TRUE;
+
+  return g_value_get_int (b) - g_value_get_int (a);
+}
+
+void
+test_object_store_sort_parallel (void)
+{
+  ClutterModel *model;
+  ClutterModelIter *iter;
+  SortThreads threads = { g_thread_self (), FALSE };
+  gint previous;
+  gint i;
+
+  model = make_store ();
+  foo_object_store_set_parallel_sort (FOO_OBJECT_STORE (model), TRUE);
+
+  /* Enough rows for the sort to be split, in scrambled order. */
+  for (i = 0; i < 10000; i++)
+    {
+      GObject *object = g_object_new (FOO_TYPE_TEST_OBJECT,
+                                      "number", (i * 7919) % 10007,
+                                      NULL);
+
+      clutter_model_append (model,
+                            COLUMN_OBJECT, object,
+                            -1);
+
+      g_object_unref (object);
+    }
+
+  clutter_model_set_sort (model, COLUMN_NUMBER,
+                          sort_descending_threads, &threads, NULL);
+
+  /* Half of the rows were sorted on a second thread. */
+  g_assert (threads.other_thread);
+
+  iter = clutter_model_get_first_iter (model);
+  previous = G_MAXINT;
+  i = 0;
+  while (!clutter_model_iter_is_last (iter))
+    {
+      gint number;
+
+      clutter_model_iter_get (iter, COLUMN_NUMBER, &number, -1);
+      g_assert_cmpint (number, <=, previous);
+      previous = number;
+
+      iter = clutter_model_iter_next (iter);
+      i += 1;
+    }
+
+  g_assert_cmpint (i, ==, 10000);
+  g_object_unref (iter);
+
+  g_object_unref (model);
+}
+
+static void
+on_row_changed_record (ClutterModel     *model,
+                       ClutterModelIter *iter,
+                       gpointer          data)
+{
+  GPtrArray *changed = data;
+  GObject *object;
+
+  clutter_model_iter_get (iter, COLUMN_OBJECT, &object, -1);
+  g_ptr_array_add (changed, object);
+  g_object_unref (object);
+}
+
+/* Changes another object from within a flush, frozen, as a handler that
+ * batches its own updates would. */
+static void
+on_row_changed_touch (ClutterModel     *model,
+                      ClutterModelIter *iter,
+                      gpointer          data)
+{
+  GObject *other = data;
+
+  g_signal_handlers_disconnect_by_func (model, on_row_changed_touch, data);
+
+  foo_object_store_freeze_changes (FOO_OBJECT_STORE (model));
+  foo_test_object_set_number (FOO_TEST_OBJECT (other), 10);
+  foo_object_store_thaw_changes (FOO_OBJECT_STORE (model));
+}
+
+void
+test_object_store_coalesce_changes (void)
+{
+  ModelData test_data = { NULL, 0 };
+  GObject *objects[9];
+  GPtrArray *changed;
+  gint i;
+
+  test_data.model = make_populated_store (objects);
+
+  changed = g_ptr_array_new ();
+  g_signal_connect (test_data.model, "row-changed",
+                    G_CALLBACK (on_row_changed_record),
+                    changed);
+
+  if (g_test_verbose ())
+    g_print ("Freezing changes...\n");
+
+  /* One row-changed per row at thaw, in row order. */
+  foo_object_store_freeze_changes (FOO_OBJECT_STORE (test_data.model));
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[5]), 60);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[1]), 20);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[5]), 61);
+  g_assert_cmpint (changed->len, ==, 0);
+  foo_object_store_thaw_changes (FOO_OBJECT_STORE (test_data.model));
+
+  g_assert_cmpint (changed->len, ==, 2);
+  g_assert (g_ptr_array_index (changed, 0) == objects[1]);
+  g_assert (g_ptr_array_index (changed, 1) == objects[5]);
+
+  if (g_test_verbose ())
+    g_print ("Coalescing changes...\n");
+
+  g_ptr_array_set_size (changed, 0);
+  foo_object_store_set_coalesce_changes (FOO_OBJECT_STORE (test_data.model),
+                                         TRUE);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[7]), 80);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[7]), 81);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[3]), 40);
+  g_assert_cmpint (changed->len, ==, 0);
+
+  /* Removed rows are dropped from the batch. */
+  foo_object_store_remove (FOO_OBJECT_STORE (test_data.model), objects[3]);
+
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  g_assert_cmpint (changed->len, ==, 1);
+  g_assert (g_ptr_array_index (changed, 0) == objects[7]);
+
+  if (g_test_verbose ())
+    g_print ("Changing objects during a flush...\n");
+
+  /* The nested thaw can't flush, the change still goes out after. */
+  g_ptr_array_set_size (changed, 0);
+  g_signal_connect (test_data.model, "row-changed",
+                    G_CALLBACK (on_row_changed_touch),
+                    objects[0]);
+  foo_test_object_set_number (FOO_TEST_OBJECT (objects[7]), 82);
+
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  g_assert_cmpint (changed->len, ==, 2);
+  g_assert (g_ptr_array_index (changed, 0) == objects[7]);
+  g_assert (g_ptr_array_index (changed, 1) == objects[0]);
+
+  g_object_unref (test_data.model);
+  g_ptr_array_free (changed, TRUE);
+
+  for (i = 0; i < 9; i++)
+    g_object_unref (objects[i]);
+}
+
+static void
+on_rows_range (FooObjectStore *store,
+               guint           first_row,
+               guint           n_rows,
+               gpointer        data)
+{
+  GArray *ranges = data;
+
+  g_array_append_val (ranges, first_row);
+  g_array_append_val (ranges, n_rows);
+}
+
+void
+test_object_store_bulk (void)
+{
+  ModelData test_data = { NULL, 0 };
+  ClutterModelIter *iter;
+  GObject *objects[9];
+  GObject *remove[5];
+  GArray *added;
+  GArray *removed;
+  gint i;
+
+  test_data.model = make_store ();
+
+  added = g_array_new (FALSE, FALSE, sizeof (guint));
+  removed = g_array_new (FALSE, FALSE, sizeof (guint));
+  g_signal_connect (test_data.model, "rows-added",
+                    G_CALLBACK (on_rows_range), added);
+  g_signal_connect (test_data.model, "rows-removed",
+                    G_CALLBACK (on_rows_range), removed);
+  g_signal_connect (test_data.model, "row-added",
+                    G_CALLBACK (on_row_added), &test_data);
+
+  make_objects (objects);
+
+  if (g_test_verbose ())
+    g_print ("Appending in bulk...\n");
+
+  foo_object_store_append_many (FOO_OBJECT_STORE (test_data.model),
+                                objects, G_N_ELEMENTS (objects));
+
+  g_assert_cmpint (added->len, ==, 2);
+  g_assert_cmpint (g_array_index (added, guint, 0), ==, 0);
+  g_assert_cmpint (g_array_index (added, guint, 1), ==, 9);
+  g_assert_cmpint (test_data.n_row, ==, 9);
+
+  iter = clutter_model_get_first_iter (test_data.model);
+  i = 0;
+  while (!clutter_model_iter_is_last (iter))
+    {
+      compare_iter (iter, i,
+                    forward_base[i].expected_foo,
+                    forward_base[i].expected_bar);
+
+      iter = clutter_model_iter_next (iter);
+      i += 1;
+    }
+  g_assert_cmpint (i, ==, 9);
+  g_object_unref (iter);
+
+  if (g_test_verbose ())
+    g_print ("Removing in bulk...\n");
+
+  /* Duplicates and objects that aren't in the store are skipped. */
+  remove[0] = objects[5];
+  remove[1] = objects[2];
+  remove[2] = objects[1];
+  remove[3] = objects[2];
+  remove[4] = g_object_new (FOO_TYPE_TEST_OBJECT, NULL);
+
+  i = foo_object_store_remove_many (FOO_OBJECT_STORE (test_data.model),
+                                    remove, G_N_ELEMENTS (remove));
+  g_assert_cmpint (i, ==, 3);
+  g_assert_cmpint (clutter_model_get_n_rows (test_data.model), ==, 6);
+
+  g_assert_cmpint (removed->len, ==, 4);
+  g_assert_cmpint (g_array_index (removed, guint, 0), ==, 5);
+  g_assert_cmpint (g_array_index (removed, guint, 1), ==, 1);
+  g_assert_cmpint (g_array_index (removed, guint, 2), ==, 1);
+  g_assert_cmpint (g_array_index (removed, guint, 3), ==, 2);
+
+  iter = clutter_model_get_iter_at_row (test_data.model, 1);
+  compare_iter (iter, 1, "String 4", 4);
+  g_object_unref (iter);
+
+  g_object_unref (test_data.model);
+  g_object_unref (remove[4]);
+  g_array_free (added, TRUE);
+  g_array_free (removed, TRUE);
+
+  for (i = 0; i < 9; i++)
+    g_object_unref (objects[i]);
+}
+
+void
+test_object_store_override_columns (void)
+{
+  ClutterModel *model;
+  ClutterModelIter *iter;
+  GObject *object;
+  gint number;
+  gint count;
+
+  model = foo_object_store_new (3,
+                                FOO_TYPE_TEST_OBJECT, "object",
+                                G_TYPE_INT,           "number",
+                                G_TYPE_INT,           "count");
+
+  object = g_object_new (foo_test_derived_get_type (), NULL);
+  foo_test_object_set_number (FOO_TEST_OBJECT (object), 7);
+  clutter_model_append (model, 0, object, -1);
+  g_object_unref (object);
+
+  /* Both columns have to go through the subclass' get_property. */
+  iter = clutter_model_get_first_iter (model);
+  clutter_model_iter_get (iter, 1, &number, 2, &count, -1);
+  g_assert_cmpint (number, ==, 70);
+  g_assert_cmpint (count, ==, 107);
+  g_object_unref (iter);
+
+  g_object_unref (model);
+}
+
 int
 main (int     argc,
       char  **argv)
 {
- 
+  g_thread_init (NULL);
   clutter_init (&argc, &argv);
 
   test_list_model_populate ();
   test_list_model_iterate ();
   test_list_model_filter ();
+  test_object_store_remove ();
+  test_object_store_filter_rows ();
+  test_object_store_sort ();
+  test_object_store_sort_parallel ();
+  test_object_store_coalesce_changes ();
+  test_object_store_bulk ();
+  test_object_store_override_columns ();
 
   return EXIT_SUCCESS;
 }
\ No newline at end of file
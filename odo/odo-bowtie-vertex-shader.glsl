@@ -0,0 +1,35 @@
+/* Bow-tie effect, see bowtie_func() in odo-distort-funcs.c.
+ * gl_Vertex is the flat grid, sized to width x height.
+ */
+uniform float turn;
+uniform float angle;
+uniform float radius;
+uniform float amplitude;
+uniform float width;
+uniform float height;
+
+const float PI = 3.14159265;
+const float HALF_PI = 1.57079633;
+
+void
+main ()
+{
+  vec4 position = gl_Vertex;
+
+  vec2 centre = vec2 (turn * (width + width / 2.0), height / 2.0);
+  vec2 offset = position.xy - centre;
+
+  /* Angle as a function of the distance from the curl ray */
+  float turn_angle = clamp ((offset.x / (width / 4.0)) * HALF_PI, -PI, 0.0);
+
+  /* Gradient that makes it look like lighting */
+  float shade = ((cos (turn_angle * 2.0) * 96.0) + 159.0) / 255.0;
+
+  /* A point on a cone */
+  position.y = (offset.y * cos (turn_angle)) + centre.y;
+  position.z = offset.y * sin (turn_angle);
+
+  gl_Position = gl_ModelViewProjectionMatrix * position;
+  gl_TexCoord[0] = gl_MultiTexCoord0;
+  gl_FrontColor = vec4 (gl_Color.rgb * shade, gl_Color.a);
+}
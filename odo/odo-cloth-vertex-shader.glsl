@@ -0,0 +1,36 @@
+/* Cloth effect, see cloth_func() in odo-distort-funcs.c.
+ * gl_Vertex is the flat grid, sized to width x height.
+ */
+uniform float turn;
+uniform float angle;
+uniform float radius;
+uniform float amplitude;
+uniform float width;
+uniform float height;
+
+const float HALF_PI = 1.57079633;
+
+void
+main ()
+{
+  vec4 position = gl_Vertex;
+
+  /* Distance from the curl ray */
+  vec2 centre = (1.0 - turn) * vec2 (width, height);
+  vec2 offset = position.xy - centre;
+  float rx = (offset.x * cos (angle)) + (offset.y * sin (angle)) - radius;
+
+  float turn_angle = ((rx / radius) * HALF_PI) - HALF_PI;
+  float wave = sin (turn_angle);
+
+  /* Gradient that makes it look like lighting */
+  float shade = ((255.0 * (1.0 - amplitude)) +
+                 (((wave * 96.0) + 159.0) * amplitude)) / 255.0;
+
+  /* The amplitude drops off with the distance from the curl ray */
+  position.z = (1.0 - rx / width) * radius * wave * amplitude;
+
+  gl_Position = gl_ModelViewProjectionMatrix * position;
+  gl_TexCoord[0] = gl_MultiTexCoord0;
+  gl_FrontColor = vec4 (gl_Color.rgb * shade, gl_Color.a);
+}
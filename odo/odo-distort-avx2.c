@@ -0,0 +1,225 @@
+/* odo-distort-avx2.c
+ *
+ * AVX2 versions of the distortions, eight vertices at a time. This file
+ * is built with -mavx2 -mfma and only used if the CPU supports both.
+ */
+
+#include <math.h>
+#include "odo-distort-simd.h"
+
+#ifdef ODO_DISTORT_HAVE_X86
+
+#include <immintrin.h>
+
+static inline __m256
+blend_ps (__m256 mask, __m256 a, __m256 b)
+{
+  /* a where mask is set, b elsewhere */
+  return _mm256_blendv_ps (b, a, mask);
+}
+
+static inline void
+sincos_ps (__m256 x, __m256 *s, __m256 *c)
+{
+  const __m256i one = _mm256_set1_epi32 (1);
+  const __m256i two = _mm256_set1_epi32 (2);
+  __m256i q, sin_sign, cos_sign;
+  __m256 qf, r, r2, sin_r, cos_r, swap;
+
+  /* Reduce to [-pi/4, pi/4] and remember the quadrant */
+  q = _mm256_cvtps_epi32 (_mm256_mul_ps (x, _mm256_set1_ps (2.f / G_PI)));
+  qf = _mm256_cvtepi32_ps (q);
+  r = _mm256_fnmadd_ps (qf, _mm256_set1_ps (ODO_DISTORT_DP1), x);
+  r = _mm256_fnmadd_ps (qf, _mm256_set1_ps (ODO_DISTORT_DP2), r);
+  r = _mm256_fnmadd_ps (qf, _mm256_set1_ps (ODO_DISTORT_DP3), r);
+  r2 = _mm256_mul_ps (r, r);
+
+  sin_r = _mm256_fmadd_ps (_mm256_set1_ps (ODO_DISTORT_SIN3), r2,
+                           _mm256_set1_ps (ODO_DISTORT_SIN2));
+  sin_r = _mm256_fmadd_ps (sin_r, r2, _mm256_set1_ps (ODO_DISTORT_SIN1));
+  sin_r = _mm256_fmadd_ps (_mm256_mul_ps (sin_r, r2), r, r);
+
+  cos_r = _mm256_fmadd_ps (_mm256_set1_ps (ODO_DISTORT_COS3), r2,
+                           _mm256_set1_ps (ODO_DISTORT_COS2));
+  cos_r = _mm256_fmadd_ps (cos_r, r2, _mm256_set1_ps (ODO_DISTORT_COS1));
+  cos_r = _mm256_mul_ps (_mm256_mul_ps (cos_r, r2), r2);
+  cos_r = _mm256_fnmadd_ps (r2, _mm256_set1_ps (0.5f), cos_r);
+  cos_r = _mm256_add_ps (cos_r, _mm256_set1_ps (1.f));
+
+  /* Odd quadrants swap sin and cos, and the signs follow the quadrant */
+  swap = _mm256_castsi256_ps (_mm256_cmpeq_epi32 (_mm256_and_si256 (q, one),
+                                                  one));
+  sin_sign = _mm256_slli_epi32 (_mm256_and_si256 (q, two), 30);
+  cos_sign = _mm256_slli_epi32 (_mm256_and_si256 (_mm256_add_epi32 (q, one),
+                                                  two), 30);
+
+  *s = _mm256_xor_ps (blend_ps (swap, cos_r, sin_r),
+                      _mm256_castsi256_ps (sin_sign));
+  *c = _mm256_xor_ps (blend_ps (swap, sin_r, cos_r),
+                      _mm256_castsi256_ps (cos_sign));
+}
+
+static void
+cloth_avx2 (OdoDistortChunk      *chunk,
+            gint                  n_vertices,
+            gfloat                width,
+            gfloat                height,
+            const OdoDistortData *d)
+{
+  __m256 cx, cy, cos_a, sin_a, radius, k, half_pi, inv_width;
+  __m256 base_shade, shade_scale, shade_offset, z_scale;
+  gint i;
+
+  cx = _mm256_set1_ps ((1.f - d->turn) * width);
+  cy = _mm256_set1_ps ((1.f - d->turn) * height);
+  cos_a = _mm256_set1_ps (cos (d->angle));
+  sin_a = _mm256_set1_ps (sin (d->angle));
+  radius = _mm256_set1_ps (d->radius);
+  k = _mm256_set1_ps (G_PI_2 / d->radius);
+  half_pi = _mm256_set1_ps (G_PI_2);
+  inv_width = _mm256_set1_ps (1.f / width);
+  base_shade = _mm256_set1_ps (255 * (1.f - d->amplitude));
+  shade_scale = _mm256_set1_ps (96 * d->amplitude);
+  shade_offset = _mm256_set1_ps (159 * d->amplitude);
+  z_scale = _mm256_set1_ps (d->radius * d->amplitude);
+
+  for (i = 0; i < n_vertices; i += 8)
+    {
+      __m256 x, y, rx, turn_angle, s, c, shade, z;
+
+      x = _mm256_load_ps (chunk->x + i);
+      y = _mm256_load_ps (chunk->y + i);
+
+      rx = _mm256_mul_ps (_mm256_sub_ps (y, cy), sin_a);
+      rx = _mm256_fmadd_ps (_mm256_sub_ps (x, cx), cos_a, rx);
+      rx = _mm256_sub_ps (rx, radius);
+      turn_angle = _mm256_fmsub_ps (rx, k, half_pi);
+      sincos_ps (turn_angle, &s, &c);
+
+      shade = _mm256_fmadd_ps (s, shade_scale, shade_offset);
+      shade = _mm256_add_ps (base_shade, shade);
+
+      z = _mm256_fnmadd_ps (rx, inv_width, _mm256_set1_ps (1.f));
+      z = _mm256_mul_ps (z, _mm256_mul_ps (s, z_scale));
+
+      _mm256_store_ps (chunk->z + i, z);
+      _mm256_store_ps (chunk->shade + i, shade);
+    }
+}
+
+static void
+bowtie_avx2 (OdoDistortChunk      *chunk,
+             gint                  n_vertices,
+             gfloat                width,
+             gfloat                height,
+             const OdoDistortData *d)
+{
+  __m256 cx, cy, k, min_angle, zero, one, two, shade_scale, shade_offset;
+  gint i;
+
+  cx = _mm256_set1_ps (d->turn * (width + width/2));
+  cy = _mm256_set1_ps (height/2);
+  k = _mm256_set1_ps (G_PI_2 / (width/4));
+  min_angle = _mm256_set1_ps (-G_PI);
+  zero = _mm256_setzero_ps ();
+  one = _mm256_set1_ps (1.f);
+  two = _mm256_set1_ps (2.f);
+  shade_scale = _mm256_set1_ps (96);
+  shade_offset = _mm256_set1_ps (159);
+
+  for (i = 0; i < n_vertices; i += 8)
+    {
+      __m256 rx, ry, turn_angle, s, c, cos_2a, shade;
+
+      rx = _mm256_sub_ps (_mm256_load_ps (chunk->x + i), cx);
+      ry = _mm256_sub_ps (_mm256_load_ps (chunk->y + i), cy);
+
+      turn_angle = _mm256_mul_ps (rx, k);
+      turn_angle = _mm256_max_ps (min_angle,
+                                  _mm256_min_ps (zero, turn_angle));
+      sincos_ps (turn_angle, &s, &c);
+
+      /* cos (2a) == 1 - 2sin²(a) */
+      cos_2a = _mm256_fnmadd_ps (two, _mm256_mul_ps (s, s), one);
+      shade = _mm256_fmadd_ps (cos_2a, shade_scale, shade_offset);
+
+      _mm256_store_ps (chunk->shade + i, shade);
+      _mm256_store_ps (chunk->y + i, _mm256_fmadd_ps (ry, c, cy));
+      _mm256_store_ps (chunk->z + i, _mm256_mul_ps (ry, s));
+    }
+}
+
+static void
+page_turn_avx2 (OdoDistortChunk      *chunk,
+                gint                  n_vertices,
+                gfloat                width,
+                gfloat                height,
+                const OdoDistortData *d)
+{
+  __m256 cx, cy, cos_a, sin_a, radius, k, half_pi, two_over_pi;
+  __m256 shade_limit, zero, shade_scale, shade_offset;
+  gint i;
+
+  cx = _mm256_set1_ps ((1.f - d->turn) * width);
+  cy = _mm256_set1_ps ((1.f - d->turn) * height);
+  cos_a = _mm256_set1_ps (cos (d->angle));
+  sin_a = _mm256_set1_ps (sin (d->angle));
+  radius = _mm256_set1_ps (d->radius);
+  k = _mm256_set1_ps (G_PI_2 / d->radius);
+  half_pi = _mm256_set1_ps (G_PI_2);
+  two_over_pi = _mm256_set1_ps (2.f / G_PI);
+  shade_limit = _mm256_set1_ps (-d->radius * 2);
+  zero = _mm256_setzero_ps ();
+  shade_scale = _mm256_set1_ps (96);
+  shade_offset = _mm256_set1_ps (159);
+
+  for (i = 0; i < n_vertices; i += 8)
+    {
+      __m256 x, y, z, dx, dy, rx, ry, turn_angle, s, c, shade;
+      __m256 shaded, curled, small_radius, curl_x, new_x, new_y, new_z;
+
+      x = _mm256_load_ps (chunk->x + i);
+      y = _mm256_load_ps (chunk->y + i);
+      z = _mm256_load_ps (chunk->z + i);
+
+      dx = _mm256_sub_ps (x, cx);
+      dy = _mm256_sub_ps (y, cy);
+      rx = _mm256_fmadd_ps (dx, cos_a, _mm256_mul_ps (dy, sin_a));
+      rx = _mm256_sub_ps (rx, radius);
+      ry = _mm256_fmsub_ps (dy, cos_a, _mm256_mul_ps (dx, sin_a));
+
+      turn_angle = _mm256_fmsub_ps (rx, k, half_pi);
+      sincos_ps (turn_angle, &s, &c);
+
+      shaded = _mm256_cmp_ps (rx, shade_limit, _CMP_GT_OQ);
+      shade = _mm256_fmadd_ps (s, shade_scale, shade_offset);
+      shade = blend_ps (shaded, shade, _mm256_load_ps (chunk->shade + i));
+      _mm256_store_ps (chunk->shade + i, shade);
+
+      /* Points past the crease get wrapped around a cylinder */
+      curled = _mm256_cmp_ps (rx, zero, _CMP_GT_OQ);
+      small_radius = _mm256_fnmadd_ps (turn_angle, two_over_pi, radius);
+      curl_x = _mm256_fmadd_ps (small_radius, c, radius);
+
+      new_x = _mm256_fmsub_ps (curl_x, cos_a, _mm256_mul_ps (ry, sin_a));
+      new_y = _mm256_fmadd_ps (curl_x, sin_a, _mm256_mul_ps (ry, cos_a));
+      new_z = _mm256_fmadd_ps (small_radius, s, radius);
+
+      new_x = blend_ps (curled, _mm256_add_ps (new_x, cx), x);
+      new_y = blend_ps (curled, _mm256_add_ps (new_y, cy), y);
+      new_z = blend_ps (curled, new_z, z);
+
+      _mm256_store_ps (chunk->x + i, new_x);
+      _mm256_store_ps (chunk->y + i, new_y);
+      _mm256_store_ps (chunk->z + i, new_z);
+    }
+}
+
+const OdoDistortKernels odo_distort_avx2_kernels =
+{
+  cloth_avx2,
+  bowtie_avx2,
+  page_turn_avx2
+};
+
+#endif /* ODO_DISTORT_HAVE_X86 */
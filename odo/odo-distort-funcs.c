@@ -1,5 +1,6 @@
 #include <math.h>
 #include "odo-distort-funcs.h"
+#include "odo-distort-simd.h"
 
 void
 cloth_func (OdoTexture *otex,
@@ -135,3 +136,186 @@ page_turn_func (OdoTexture        *otex,
       vertex->z = (small_radius * sin (turn_angle)) + d->radius;
     }
 }
+
+OdoTextureAttributes
+cloth_batch_func (OdoTexture        *otex,
+                  CoglTextureVertex *vertices,
+                  gint               n_columns,
+                  gint               n_rows,
+                  gfloat             width,
+                  gfloat             height,
+                  gpointer           data)
+{
+  OdoDistortData *d = data;
+  gfloat cx, cy, cos_a, sin_a;
+  gint i, j;
+
+  if (odo_distort_simd_cloth (vertices, n_columns * n_rows,
+                              width, height, d))
+    return ODO_TEXTURE_ATTRIBUTE_ALL;
+
+  cx = (1.f - d->turn) * width;
+  cy = (1.f - d->turn) * height;
+
+  /* cos (-angle) == cos (angle), sin (-angle) == -sin (angle) */
+  cos_a = cos (d->angle);
+  sin_a = sin (d->angle);
+
+  for (i = 0; i < n_rows; i++)
+    {
+      CoglTextureVertex *vertex = &vertices[i * n_columns];
+
+      /* The y contribution to the rotation is constant along a row */
+      gfloat row_rx = ((vertex->y - cy) * sin_a) - d->radius;
+
+      for (j = 0; j < n_columns; j++, vertex++)
+        {
+          gfloat rx, turn_angle, sin_turn, height_radius;
+          guint shade;
+
+          rx = ((vertex->x - cx) * cos_a) + row_rx;
+          turn_angle = ((rx / d->radius) * G_PI_2) - G_PI_2;
+          sin_turn = sin (turn_angle);
+
+          shade = (255 * (1.f - d->amplitude)) +
+                  (((sin_turn * 96) + 159) * d->amplitude);
+          vertex->color.red = shade;
+          vertex->color.green = shade;
+          vertex->color.blue = shade;
+
+          height_radius = (1 - rx / width) * d->radius;
+          vertex->z = height_radius * sin_turn * d->amplitude;
+        }
+    }
+
+  return ODO_TEXTURE_ATTRIBUTE_ALL;
+}
+
+typedef struct
+{
+  gfloat cos_turn;
+  gfloat sin_turn;
+  guint8 shade;
+} BowtieColumn;
+
+OdoTextureAttributes
+bowtie_batch_func (OdoTexture        *otex,
+                   CoglTextureVertex *vertices,
+                   gint               n_columns,
+                   gint               n_rows,
+                   gfloat             width,
+                   gfloat             height,
+                   gpointer           data)
+{
+  OdoDistortData *d = data;
+  BowtieColumn *columns;
+  gfloat cx, cy;
+  gint i, j;
+
+  if (odo_distort_simd_bowtie (vertices, n_columns * n_rows,
+                               width, height, d))
+    return ODO_TEXTURE_ATTRIBUTE_ALL;
+
+  cx = d->turn * (width + width/2);
+  cy = height/2;
+
+  /* The bow-tie isn't rotated, so the turn angle only depends on the
+   * column. Work out the trig once per column rather than per vertex.
+   */
+  columns = g_newa (BowtieColumn, n_columns);
+  for (j = 0; j < n_columns; j++)
+    {
+      gfloat rx, turn_angle;
+
+      rx = vertices[j].x - cx;
+      turn_angle = MAX (-G_PI, MIN (0, (rx / (width/4)) * G_PI_2));
+
+      columns[j].cos_turn = cos (turn_angle);
+      columns[j].sin_turn = sin (turn_angle);
+      columns[j].shade = (cos (turn_angle * 2) * 96) + 159;
+    }
+
+  for (i = 0; i < n_rows; i++)
+    {
+      CoglTextureVertex *vertex = &vertices[i * n_columns];
+      gfloat ry = vertex->y - cy;
+
+      for (j = 0; j < n_columns; j++, vertex++)
+        {
+          vertex->color.red = columns[j].shade;
+          vertex->color.green = columns[j].shade;
+          vertex->color.blue = columns[j].shade;
+
+          vertex->y = (ry * columns[j].cos_turn) + cy;
+          vertex->z = ry * columns[j].sin_turn;
+        }
+    }
+
+  return ODO_TEXTURE_ATTRIBUTE_ALL;
+}
+
+OdoTextureAttributes
+page_turn_batch_func (OdoTexture        *otex,
+                      CoglTextureVertex *vertices,
+                      gint               n_columns,
+                      gint               n_rows,
+                      gfloat             width,
+                      gfloat             height,
+                      gpointer           data)
+{
+  OdoDistortData *d = data;
+  gfloat cx, cy, cos_a, sin_a;
+  gint i, j;
+
+  if (odo_distort_simd_page_turn (vertices, n_columns * n_rows,
+                                  width, height, d))
+    return ODO_TEXTURE_ATTRIBUTE_ALL;
+
+  cx = (1.f - d->turn) * width;
+  cy = (1.f - d->turn) * height;
+  cos_a = cos (d->angle);
+  sin_a = sin (d->angle);
+
+  for (i = 0; i < n_rows; i++)
+    {
+      CoglTextureVertex *vertex = &vertices[i * n_columns];
+      gfloat dy = vertex->y - cy;
+
+      /* The y contribution to the rotation is constant along a row */
+      gfloat row_rx = (dy * sin_a) - d->radius;
+      gfloat row_ry = dy * cos_a;
+
+      for (j = 0; j < n_columns; j++, vertex++)
+        {
+          gfloat dx, rx, ry, turn_angle, sin_turn, small_radius;
+          guint shade;
+
+          dx = vertex->x - cx;
+          rx = (dx * cos_a) + row_rx;
+
+          if (rx <= -d->radius * 2)
+            continue;
+
+          turn_angle = (rx / d->radius * G_PI_2) - G_PI_2;
+          sin_turn = sin (turn_angle);
+
+          shade = (sin_turn * 96) + 159;
+          vertex->color.red = shade;
+          vertex->color.green = shade;
+          vertex->color.blue = shade;
+
+          if (rx <= 0)
+            continue;
+
+          ry = row_ry - (dx * sin_a);
+          small_radius = d->radius - (turn_angle * 2) / G_PI;
+
+          rx = (small_radius * cos (turn_angle)) + d->radius;
+          vertex->x = (rx * cos_a) - (ry * sin_a) + cx;
+          vertex->y = (rx * sin_a) + (ry * cos_a) + cy;
+          vertex->z = (small_radius * sin_turn) + d->radius;
+        }
+    }
+
+  return ODO_TEXTURE_ATTRIBUTE_ALL;
+}
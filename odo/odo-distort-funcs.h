@@ -7,14 +7,6 @@
 
 G_BEGIN_DECLS
 
-typedef struct
-{
-  gfloat           radius;
-  gfloat           angle;
-  gfloat           turn;
-  gfloat           amplitude;
-} OdoDistortData;
-
 void
 cloth_func (OdoTexture *otex,
             CoglTextureVertex *vertex,
@@ -36,6 +28,34 @@ page_turn_func (OdoTexture        *otex,
                 gfloat             height,
                 gpointer           data);
 
+/* Batch versions of the above, for odo_texture_set_batch_callback () */
+OdoTextureAttributes
+cloth_batch_func (OdoTexture        *otex,
+                  CoglTextureVertex *vertices,
+                  gint               n_columns,
+                  gint               n_rows,
+                  gfloat             width,
+                  gfloat             height,
+                  gpointer           data);
+
+OdoTextureAttributes
+bowtie_batch_func (OdoTexture        *otex,
+                   CoglTextureVertex *vertices,
+                   gint               n_columns,
+                   gint               n_rows,
+                   gfloat             width,
+                   gfloat             height,
+                   gpointer           data);
+
+OdoTextureAttributes
+page_turn_batch_func (OdoTexture        *otex,
+                      CoglTextureVertex *vertices,
+                      gint               n_columns,
+                      gint               n_rows,
+                      gfloat             width,
+                      gfloat             height,
+                      gpointer           data);
+
 G_END_DECLS
 
 #endif
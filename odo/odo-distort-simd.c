@@ -0,0 +1,138 @@
+/* odo-distort-simd.c */
+
+#include "odo-distort-simd.h"
+
+/* Picks the widest kernels the CPU supports. Setting ODO_SIMD to "none"
+ * or "sse2" in the environment restricts the choice, which is handy for
+ * comparing implementations.
+ */
+static const OdoDistortKernels *
+odo_distort_simd_get_kernels (void)
+{
+  static gsize initialised = 0;
+  static const OdoDistortKernels *kernels = NULL;
+
+  if (g_once_init_enter (&initialised))
+    {
+#ifdef ODO_DISTORT_HAVE_X86
+      const gchar *limit = g_getenv ("ODO_SIMD");
+
+      __builtin_cpu_init ();
+
+      if (limit && g_str_equal (limit, "none"))
+        kernels = NULL;
+      else if (__builtin_cpu_supports ("avx2") &&
+               __builtin_cpu_supports ("fma") &&
+               !(limit && g_str_equal (limit, "sse2")))
+        kernels = &odo_distort_avx2_kernels;
+      else if (__builtin_cpu_supports ("sse2"))
+        kernels = &odo_distort_sse2_kernels;
+#endif
+
+      g_once_init_leave (&initialised, 1);
+    }
+
+  return kernels;
+}
+
+static void
+odo_distort_simd_apply (OdoDistortKernel      kernel,
+                        CoglTextureVertex    *vertices,
+                        gint                  n_vertices,
+                        gfloat                width,
+                        gfloat                height,
+                        const OdoDistortData *d)
+{
+  OdoDistortChunk chunk;
+  gint start, n, padded, i;
+
+  for (start = 0; start < n_vertices; start += ODO_DISTORT_CHUNK_SIZE)
+    {
+      CoglTextureVertex *vertex = vertices + start;
+
+      n = MIN (ODO_DISTORT_CHUNK_SIZE, n_vertices - start);
+      padded = (n + 7) & ~7;
+
+      /* Gather into the staging arrays */
+      for (i = 0; i < n; i++)
+        {
+          chunk.x[i] = vertex[i].x;
+          chunk.y[i] = vertex[i].y;
+          chunk.z[i] = vertex[i].z;
+          chunk.shade[i] = vertex[i].color.red;
+        }
+      for (; i < padded; i++)
+        {
+          chunk.x[i] = 0;
+          chunk.y[i] = 0;
+          chunk.z[i] = 0;
+          chunk.shade[i] = 0;
+        }
+
+      kernel (&chunk, padded, width, height, d);
+
+      /* And scatter the results back */
+      for (i = 0; i < n; i++)
+        {
+          guint8 shade = (guint) chunk.shade[i];
+
+          vertex[i].x = chunk.x[i];
+          vertex[i].y = chunk.y[i];
+          vertex[i].z = chunk.z[i];
+          vertex[i].color.red = shade;
+          vertex[i].color.green = shade;
+          vertex[i].color.blue = shade;
+        }
+    }
+}
+
+gboolean
+odo_distort_simd_cloth (CoglTextureVertex    *vertices,
+                        gint                  n_vertices,
+                        gfloat                width,
+                        gfloat                height,
+                        const OdoDistortData *d)
+{
+  const OdoDistortKernels *kernels = odo_distort_simd_get_kernels ();
+
+  if (!kernels)
+    return FALSE;
+
+  odo_distort_simd_apply (kernels->cloth, vertices, n_vertices,
+                          width, height, d);
+  return TRUE;
+}
+
+gboolean
+odo_distort_simd_bowtie (CoglTextureVertex    *vertices,
+                         gint                  n_vertices,
+                         gfloat                width,
+                         gfloat                height,
+                         const OdoDistortData *d)
+{
+  const OdoDistortKernels *kernels = odo_distort_simd_get_kernels ();
+
+  if (!kernels)
+    return FALSE;
+
+  odo_distort_simd_apply (kernels->bowtie, vertices, n_vertices,
+                          width, height, d);
+  return TRUE;
+}
+
+gboolean
+odo_distort_simd_page_turn (CoglTextureVertex    *vertices,
+                            gint                  n_vertices,
+                            gfloat                width,
+                            gfloat                height,
+                            const OdoDistortData *d)
+{
+  const OdoDistortKernels *kernels = odo_distort_simd_get_kernels ();
+
+  if (!kernels)
+    return FALSE;
+
+  odo_distort_simd_apply (kernels->page_turn, vertices, n_vertices,
+                          width, height, d);
+  return TRUE;
+}
@@ -0,0 +1,86 @@
+/* odo-distort-simd.h */
+
+#ifndef ODO_DISTORT_SIMD_H
+#define ODO_DISTORT_SIMD_H
+
+#include "odo-distort-funcs.h"
+
+G_BEGIN_DECLS
+
+/* The distortions are run over the mesh in chunks of this many vertices,
+ * staged as a structure-of-arrays so that the kernels can load whole
+ * vectors of x, y, z and shade at once. It's a multiple of the widest
+ * vector width (8 floats for AVX2).
+ */
+#define ODO_DISTORT_CHUNK_SIZE 256
+
+typedef struct
+{
+  gfloat x[ODO_DISTORT_CHUNK_SIZE] __attribute__ ((aligned (32)));
+  gfloat y[ODO_DISTORT_CHUNK_SIZE] __attribute__ ((aligned (32)));
+  gfloat z[ODO_DISTORT_CHUNK_SIZE] __attribute__ ((aligned (32)));
+  gfloat shade[ODO_DISTORT_CHUNK_SIZE] __attribute__ ((aligned (32)));
+} OdoDistortChunk;
+
+/* n_vertices is always a multiple of 8; padding lanes are zeroed and
+ * their results discarded.
+ */
+typedef void (*OdoDistortKernel) (OdoDistortChunk      *chunk,
+                                  gint                  n_vertices,
+                                  gfloat                width,
+                                  gfloat                height,
+                                  const OdoDistortData *d);
+
+typedef struct
+{
+  OdoDistortKernel  cloth;
+  OdoDistortKernel  bowtie;
+  OdoDistortKernel  page_turn;
+} OdoDistortKernels;
+
+/* Coefficients for the polynomial sin/cos approximations used by the
+ * kernels (from Cephes' sinf/cosf). The argument is reduced by multiples
+ * of pi/2, split into three parts so the reduction stays exact.
+ */
+#define ODO_DISTORT_DP1  1.5703125f
+#define ODO_DISTORT_DP2  4.837512969970703125e-4f
+#define ODO_DISTORT_DP3  7.54978995489188216e-8f
+
+#define ODO_DISTORT_SIN1 -1.6666654611e-1f
+#define ODO_DISTORT_SIN2  8.3321608736e-3f
+#define ODO_DISTORT_SIN3 -1.9515295891e-4f
+
+#define ODO_DISTORT_COS1  4.166664568298827e-2f
+#define ODO_DISTORT_COS2 -1.388731625493765e-3f
+#define ODO_DISTORT_COS3  2.443315711809948e-5f
+
+#if defined (__i386__) || defined (__x86_64__)
+#define ODO_DISTORT_HAVE_X86 1
+extern const OdoDistortKernels odo_distort_sse2_kernels;
+extern const OdoDistortKernels odo_distort_avx2_kernels;
+#endif
+
+/* These return FALSE if there is no vectorised implementation for this
+ * CPU, in which case the caller should fall back to the scalar code.
+ */
+gboolean odo_distort_simd_cloth (CoglTextureVertex    *vertices,
+                                 gint                  n_vertices,
+                                 gfloat                width,
+                                 gfloat                height,
+                                 const OdoDistortData *d);
+
+gboolean odo_distort_simd_bowtie (CoglTextureVertex    *vertices,
+                                  gint                  n_vertices,
+                                  gfloat                width,
+                                  gfloat                height,
+                                  const OdoDistortData *d);
+
+gboolean odo_distort_simd_page_turn (CoglTextureVertex    *vertices,
+                                     gint                  n_vertices,
+                                     gfloat                width,
+                                     gfloat                height,
+                                     const OdoDistortData *d);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,218 @@
+/* odo-distort-sse2.c
+ *
+ * SSE2 versions of the distortions, four vertices at a time. This file
+ * is built with -msse2.
+ */
+
+#include <math.h>
+#include "odo-distort-simd.h"
+
+#ifdef ODO_DISTORT_HAVE_X86
+
+#include <emmintrin.h>
+
+static inline __m128
+blend_ps (__m128 mask, __m128 a, __m128 b)
+{
+  /* a where mask is set, b elsewhere */
+  return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));
+}
+
+static inline void
+sincos_ps (__m128 x, __m128 *s, __m128 *c)
+{
+  const __m128i one = _mm_set1_epi32 (1);
+  const __m128i two = _mm_set1_epi32 (2);
+  __m128i q, sin_sign, cos_sign;
+  __m128 qf, r, r2, sin_r, cos_r, swap;
+
+  /* Reduce to [-pi/4, pi/4] and remember the quadrant */
+  q = _mm_cvtps_epi32 (_mm_mul_ps (x, _mm_set1_ps (2.f / G_PI)));
+  qf = _mm_cvtepi32_ps (q);
+  r = _mm_sub_ps (x, _mm_mul_ps (qf, _mm_set1_ps (ODO_DISTORT_DP1)));
+  r = _mm_sub_ps (r, _mm_mul_ps (qf, _mm_set1_ps (ODO_DISTORT_DP2)));
+  r = _mm_sub_ps (r, _mm_mul_ps (qf, _mm_set1_ps (ODO_DISTORT_DP3)));
+  r2 = _mm_mul_ps (r, r);
+
+  sin_r = _mm_add_ps (_mm_mul_ps (_mm_set1_ps (ODO_DISTORT_SIN3), r2),
+                      _mm_set1_ps (ODO_DISTORT_SIN2));
+  sin_r = _mm_add_ps (_mm_mul_ps (sin_r, r2), _mm_set1_ps (ODO_DISTORT_SIN1));
+  sin_r = _mm_add_ps (_mm_mul_ps (_mm_mul_ps (sin_r, r2), r), r);
+
+  cos_r = _mm_add_ps (_mm_mul_ps (_mm_set1_ps (ODO_DISTORT_COS3), r2),
+                      _mm_set1_ps (ODO_DISTORT_COS2));
+  cos_r = _mm_add_ps (_mm_mul_ps (cos_r, r2), _mm_set1_ps (ODO_DISTORT_COS1));
+  cos_r = _mm_mul_ps (_mm_mul_ps (cos_r, r2), r2);
+  cos_r = _mm_sub_ps (cos_r, _mm_mul_ps (r2, _mm_set1_ps (0.5f)));
+  cos_r = _mm_add_ps (cos_r, _mm_set1_ps (1.f));
+
+  /* Odd quadrants swap sin and cos, and the signs follow the quadrant */
+  swap = _mm_castsi128_ps (_mm_cmpeq_epi32 (_mm_and_si128 (q, one), one));
+  sin_sign = _mm_slli_epi32 (_mm_and_si128 (q, two), 30);
+  cos_sign = _mm_slli_epi32 (_mm_and_si128 (_mm_add_epi32 (q, one), two), 30);
+
+  *s = _mm_xor_ps (blend_ps (swap, cos_r, sin_r), _mm_castsi128_ps (sin_sign));
+  *c = _mm_xor_ps (blend_ps (swap, sin_r, cos_r), _mm_castsi128_ps (cos_sign));
+}
+
+static void
+cloth_sse2 (OdoDistortChunk      *chunk,
+            gint                  n_vertices,
+            gfloat                width,
+            gfloat                height,
+            const OdoDistortData *d)
+{
+  __m128 cx, cy, cos_a, sin_a, radius, k, half_pi, inv_width;
+  __m128 base_shade, shade_scale, shade_offset, z_scale;
+  gint i;
+
+  cx = _mm_set1_ps ((1.f - d->turn) * width);
+  cy = _mm_set1_ps ((1.f - d->turn) * height);
+  cos_a = _mm_set1_ps (cos (d->angle));
+  sin_a = _mm_set1_ps (sin (d->angle));
+  radius = _mm_set1_ps (d->radius);
+  k = _mm_set1_ps (G_PI_2 / d->radius);
+  half_pi = _mm_set1_ps (G_PI_2);
+  inv_width = _mm_set1_ps (1.f / width);
+  base_shade = _mm_set1_ps (255 * (1.f - d->amplitude));
+  shade_scale = _mm_set1_ps (96 * d->amplitude);
+  shade_offset = _mm_set1_ps (159 * d->amplitude);
+  z_scale = _mm_set1_ps (d->radius * d->amplitude);
+
+  for (i = 0; i < n_vertices; i += 4)
+    {
+      __m128 x, y, rx, turn_angle, s, c, shade, z;
+
+      x = _mm_load_ps (chunk->x + i);
+      y = _mm_load_ps (chunk->y + i);
+
+      rx = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (x, cx), cos_a),
+                       _mm_mul_ps (_mm_sub_ps (y, cy), sin_a));
+      rx = _mm_sub_ps (rx, radius);
+      turn_angle = _mm_sub_ps (_mm_mul_ps (rx, k), half_pi);
+      sincos_ps (turn_angle, &s, &c);
+
+      shade = _mm_add_ps (base_shade,
+                          _mm_add_ps (_mm_mul_ps (s, shade_scale),
+                                      shade_offset));
+      z = _mm_sub_ps (_mm_set1_ps (1.f), _mm_mul_ps (rx, inv_width));
+      z = _mm_mul_ps (z, _mm_mul_ps (s, z_scale));
+
+      _mm_store_ps (chunk->z + i, z);
+      _mm_store_ps (chunk->shade + i, shade);
+    }
+}
+
+static void
+bowtie_sse2 (OdoDistortChunk      *chunk,
+             gint                  n_vertices,
+             gfloat                width,
+             gfloat                height,
+             const OdoDistortData *d)
+{
+  __m128 cx, cy, k, min_angle, zero, two, shade_scale, shade_offset;
+  gint i;
+
+  cx = _mm_set1_ps (d->turn * (width + width/2));
+  cy = _mm_set1_ps (height/2);
+  k = _mm_set1_ps (G_PI_2 / (width/4));
+  min_angle = _mm_set1_ps (-G_PI);
+  zero = _mm_setzero_ps ();
+  two = _mm_set1_ps (2.f);
+  shade_scale = _mm_set1_ps (96);
+  shade_offset = _mm_set1_ps (159);
+
+  for (i = 0; i < n_vertices; i += 4)
+    {
+      __m128 rx, ry, turn_angle, s, c, cos_2a;
+
+      rx = _mm_sub_ps (_mm_load_ps (chunk->x + i), cx);
+      ry = _mm_sub_ps (_mm_load_ps (chunk->y + i), cy);
+
+      turn_angle = _mm_mul_ps (rx, k);
+      turn_angle = _mm_max_ps (min_angle, _mm_min_ps (zero, turn_angle));
+      sincos_ps (turn_angle, &s, &c);
+
+      /* cos (2a) == 1 - 2sin²(a) */
+      cos_2a = _mm_sub_ps (_mm_set1_ps (1.f), _mm_mul_ps (two, _mm_mul_ps (s, s)));
+
+      _mm_store_ps (chunk->shade + i,
+                    _mm_add_ps (_mm_mul_ps (cos_2a, shade_scale),
+                                shade_offset));
+      _mm_store_ps (chunk->y + i, _mm_add_ps (_mm_mul_ps (ry, c), cy));
+      _mm_store_ps (chunk->z + i, _mm_mul_ps (ry, s));
+    }
+}
+
+static void
+page_turn_sse2 (OdoDistortChunk      *chunk,
+                gint                  n_vertices,
+                gfloat                width,
+                gfloat                height,
+                const OdoDistortData *d)
+{
+  __m128 cx, cy, cos_a, sin_a, radius, k, half_pi, two_over_pi;
+  __m128 shade_limit, zero, shade_scale, shade_offset;
+  gint i;
+
+  cx = _mm_set1_ps ((1.f - d->turn) * width);
+  cy = _mm_set1_ps ((1.f - d->turn) * height);
+  cos_a = _mm_set1_ps (cos (d->angle));
+  sin_a = _mm_set1_ps (sin (d->angle));
+  radius = _mm_set1_ps (d->radius);
+  k = _mm_set1_ps (G_PI_2 / d->radius);
+  half_pi = _mm_set1_ps (G_PI_2);
+  two_over_pi = _mm_set1_ps (2.f / G_PI);
+  shade_limit = _mm_set1_ps (-d->radius * 2);
+  zero = _mm_setzero_ps ();
+  shade_scale = _mm_set1_ps (96);
+  shade_offset = _mm_set1_ps (159);
+
+  for (i = 0; i < n_vertices; i += 4)
+    {
+      __m128 x, y, z, dx, dy, rx, ry, turn_angle, s, c;
+      __m128 shaded, curled, small_radius, curl_x, new_x, new_y, new_z;
+
+      x = _mm_load_ps (chunk->x + i);
+      y = _mm_load_ps (chunk->y + i);
+      z = _mm_load_ps (chunk->z + i);
+
+      dx = _mm_sub_ps (x, cx);
+      dy = _mm_sub_ps (y, cy);
+      rx = _mm_add_ps (_mm_mul_ps (dx, cos_a), _mm_mul_ps (dy, sin_a));
+      rx = _mm_sub_ps (rx, radius);
+      ry = _mm_sub_ps (_mm_mul_ps (dy, cos_a), _mm_mul_ps (dx, sin_a));
+
+      turn_angle = _mm_sub_ps (_mm_mul_ps (rx, k), half_pi);
+      sincos_ps (turn_angle, &s, &c);
+
+      shaded = _mm_cmpgt_ps (rx, shade_limit);
+      _mm_store_ps (chunk->shade + i,
+                    blend_ps (shaded,
+                              _mm_add_ps (_mm_mul_ps (s, shade_scale),
+                                          shade_offset),
+                              _mm_load_ps (chunk->shade + i)));
+
+      /* Points past the crease get wrapped around a cylinder */
+      curled = _mm_cmpgt_ps (rx, zero);
+      small_radius = _mm_sub_ps (radius, _mm_mul_ps (turn_angle, two_over_pi));
+      curl_x = _mm_add_ps (_mm_mul_ps (small_radius, c), radius);
+
+      new_x = _mm_sub_ps (_mm_mul_ps (curl_x, cos_a), _mm_mul_ps (ry, sin_a));
+      new_y = _mm_add_ps (_mm_mul_ps (curl_x, sin_a), _mm_mul_ps (ry, cos_a));
+      new_z = _mm_add_ps (_mm_mul_ps (small_radius, s), radius);
+
+      _mm_store_ps (chunk->x + i, blend_ps (curled, _mm_add_ps (new_x, cx), x));
+      _mm_store_ps (chunk->y + i, blend_ps (curled, _mm_add_ps (new_y, cy), y));
+      _mm_store_ps (chunk->z + i, blend_ps (curled, new_z, z));
+    }
+}
+
+const OdoDistortKernels odo_distort_sse2_kernels =
+{
+  cloth_sse2,
+  bowtie_sse2,
+  page_turn_sse2
+};
+
+#endif /* ODO_DISTORT_HAVE_X86 */
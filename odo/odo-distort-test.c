@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <math.h>
+#include <glib.h>
+#include "odo-distort-funcs.h"
+#include "odo-distort-simd.h"
+
+#define GRID_SIZE 16
+#define WIDTH     200.f
+#define HEIGHT    150.f
+
+/* The kernels use float maths and polynomial sin/cos, the scalar
+ * functions double precision and libm, and the scalar shade gets
+ * truncated to an integer.
+ */
+#define POSITION_TOLERANCE 0.01f
+#define SHADE_TOLERANCE    1.01f
+
+typedef void (*ScalarFunc) (OdoTexture        *otex,
+                            CoglTextureVertex *vertex,
+                            gfloat             width,
+                            gfloat             height,
+                            gpointer           data);
+
+static const OdoDistortData distortions[] =
+{
+  /* radius, angle, turn, amplitude */
+  { 24.f, G_PI / 4, 0.1f, 1.f },
+  { 24.f, G_PI / 4, 0.5f, 1.f },
+  { 16.f, G_PI / 6, 0.9f, 0.5f },
+  { 40.f, G_PI / 3, 0.3f, 0.f },
+};
+
+/* Runs one kernel over a grid covering the texture, and checks that it
+ * gives the same result as the scalar function.
+ */
+static void
+check_kernel (OdoDistortKernel      kernel,
+              ScalarFunc            func,
+              const OdoDistortData *d)
+{
+  CoglTextureVertex vertices[GRID_SIZE * GRID_SIZE];
+  OdoDistortChunk chunk;
+  gint x, y, i;
+
+  for (y = 0; y < GRID_SIZE; y++)
+    for (x = 0; x < GRID_SIZE; x++)
+      {
+        i = (y * GRID_SIZE) + x;
+
+        chunk.x[i] = vertices[i].x = (WIDTH * x) / (GRID_SIZE - 1);
+        chunk.y[i] = vertices[i].y = (HEIGHT * y) / (GRID_SIZE - 1);
+        chunk.z[i] = vertices[i].z = 0;
+        chunk.shade[i] = 255;
+        vertices[i].color.red = 255;
+      }
+
+  kernel (&chunk, GRID_SIZE * GRID_SIZE, WIDTH, HEIGHT, d);
+
+  for (i = 0; i < GRID_SIZE * GRID_SIZE; i++)
+    {
+      func (NULL, &vertices[i], WIDTH, HEIGHT, (gpointer) d);
+
+      g_assert_cmpfloat (fabsf (chunk.x[i] - vertices[i].x),
+                         <, POSITION_TOLERANCE);
+      g_assert_cmpfloat (fabsf (chunk.y[i] - vertices[i].y),
+                         <, POSITION_TOLERANCE);
+      g_assert_cmpfloat (fabsf (chunk.z[i] - vertices[i].z),
+                         <, POSITION_TOLERANCE);
+      g_assert_cmpfloat (fabsf (chunk.shade[i] - vertices[i].color.red),
+                         <, SHADE_TOLERANCE);
+    }
+}
+
+static void
+check_kernels (const OdoDistortKernels *kernels)
+{
+  gint i;
+
+  for (i = 0; i < G_N_ELEMENTS (distortions); i++)
+    {
+      check_kernel (kernels->cloth, cloth_func, &distortions[i]);
+      check_kernel (kernels->bowtie, bowtie_func, &distortions[i]);
+      check_kernel (kernels->page_turn, page_turn_func, &distortions[i]);
+    }
+}
+
+#ifdef ODO_DISTORT_HAVE_X86
+
+static void
+test_distort_sse2 (void)
+{
+  __builtin_cpu_init ();
+  if (!__builtin_cpu_supports ("sse2"))
+    {
+      if (g_test_verbose ())
+        g_print ("SSE2 not supported, skipping\n");
+      return;
+    }
+
+  check_kernels (&odo_distort_sse2_kernels);
+}
+
+static void
+test_distort_avx2 (void)
+{
+  __builtin_cpu_init ();
+  if (!__builtin_cpu_supports ("avx2") || !__builtin_cpu_supports ("fma"))
+    {
+      if (g_test_verbose ())
+        g_print ("AVX2 not supported, skipping\n");
+      return;
+    }
+
+  check_kernels (&odo_distort_avx2_kernels);
+}
+
+#endif
+
+int
+main (int     argc,
+      char  **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+#ifdef ODO_DISTORT_HAVE_X86
+  g_test_add_func ("/distort/sse2", test_distort_sse2);
+  g_test_add_func ("/distort/avx2", test_distort_avx2);
+#endif
+
+  return g_test_run ();
+}
@@ -0,0 +1,139 @@
+/* odo-indices.c */
+
+#include "odo-indices.h"
+#include "odo-mesh.h"
+
+/* Index buffers that nothing uses any more are kept around in case the
+ * resolution changes back, up to this many.
+ */
+#define ODO_INDICES_MAX_UNUSED 4
+
+static GHashTable *odo_indices_cache = NULL;
+static GQueue odo_indices_unused = G_QUEUE_INIT;
+
+static guint
+odo_indices_hash (gconstpointer key)
+{
+  const OdoIndices *indices = key;
+
+  return (indices->tiles_x * 65521) ^ indices->tiles_y;
+}
+
+static gboolean
+odo_indices_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const OdoIndices *indices_a = a, *indices_b = b;
+
+  return (indices_a->tiles_x == indices_b->tiles_x) &&
+         (indices_a->tiles_y == indices_b->tiles_y);
+}
+
+static CoglHandle
+odo_indices_new_buffer (const guint32 *indices,
+                        gint           n_indices,
+                        gboolean       int_indices)
+{
+  CoglHandle handle;
+  guint16 *short_indices;
+
+  if (int_indices)
+    return cogl_vertex_buffer_indices_new (COGL_INDICES_TYPE_UNSIGNED_INT,
+                                           indices,
+                                           n_indices);
+
+  short_indices = odo_mesh_narrow_indices (indices, n_indices);
+  handle = cogl_vertex_buffer_indices_new (COGL_INDICES_TYPE_UNSIGNED_SHORT,
+                                           short_indices,
+                                           n_indices);
+  g_free (short_indices);
+
+  return handle;
+}
+
+static OdoIndices *
+odo_indices_new (gint tiles_x,
+                 gint tiles_y)
+{
+  OdoIndices *indices;
+  gboolean int_indices;
+  guint32 *static_indices, *static_bf_indices;
+
+  indices = g_slice_new (OdoIndices);
+  indices->tiles_x = tiles_x;
+  indices->tiles_y = tiles_y;
+  indices->ref_count = 0;
+
+  /* Short indices are cheaper, but only go up to 65536 vertices */
+  int_indices = odo_mesh_needs_int_indices (tiles_x, tiles_y);
+
+  indices->n_indices = odo_mesh_get_n_indices (tiles_x, tiles_y);
+  static_indices = g_new (guint32, indices->n_indices);
+  static_bf_indices = g_new (guint32, indices->n_indices);
+
+  odo_mesh_build_strips (tiles_x, tiles_y,
+                         static_indices, static_bf_indices);
+
+  indices->indices = odo_indices_new_buffer (static_indices,
+                                             indices->n_indices,
+                                             int_indices);
+  indices->bf_indices = odo_indices_new_buffer (static_bf_indices,
+                                                indices->n_indices,
+                                                int_indices);
+  g_free (static_indices);
+  g_free (static_bf_indices);
+
+  return indices;
+}
+
+static void
+odo_indices_free (OdoIndices *indices)
+{
+  g_hash_table_remove (odo_indices_cache, indices);
+
+  cogl_handle_unref (indices->indices);
+  cogl_handle_unref (indices->bf_indices);
+  g_slice_free (OdoIndices, indices);
+}
+
+OdoIndices *
+odo_indices_get (gint tiles_x,
+                 gint tiles_y)
+{
+  OdoIndices key, *indices;
+
+  g_return_val_if_fail ((tiles_x > 0) && (tiles_y > 0), NULL);
+
+  if (!odo_indices_cache)
+    odo_indices_cache = g_hash_table_new (odo_indices_hash,
+                                          odo_indices_equal);
+
+  key.tiles_x = tiles_x;
+  key.tiles_y = tiles_y;
+  indices = g_hash_table_lookup (odo_indices_cache, &key);
+
+  if (!indices)
+    {
+      indices = odo_indices_new (tiles_x, tiles_y);
+      g_hash_table_insert (odo_indices_cache, indices, indices);
+    }
+  else if (indices->ref_count == 0)
+    g_queue_remove (&odo_indices_unused, indices);
+
+  indices->ref_count++;
+
+  return indices;
+}
+
+void
+odo_indices_unref (OdoIndices *indices)
+{
+  g_return_if_fail (indices->ref_count > 0);
+
+  if (--indices->ref_count > 0)
+    return;
+
+  g_queue_push_tail (&odo_indices_unused, indices);
+  if (g_queue_get_length (&odo_indices_unused) > ODO_INDICES_MAX_UNUSED)
+    odo_indices_free (g_queue_pop_head (&odo_indices_unused));
+}
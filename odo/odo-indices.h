@@ -0,0 +1,38 @@
+/* odo-indices.h
+ *
+ * Front and back-face index buffers for the OdoTexture grid. These only
+ * depend on the resolution, so they are shared between every texture
+ * that uses the same one.
+ */
+
+#ifndef ODO_INDICES_H
+#define ODO_INDICES_H
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+  gint        tiles_x;
+  gint        tiles_y;
+  gint        n_indices;
+  CoglHandle  indices;
+  CoglHandle  bf_indices;
+
+  /*< private >*/
+  gint        ref_count;
+} OdoIndices;
+
+/* Returns a reference to the index buffers for a grid of tiles_x by
+ * tiles_y tiles, creating them if no-one has them already. This must
+ * only be called from the thread that paints.
+ */
+OdoIndices *odo_indices_get (gint tiles_x,
+                             gint tiles_y);
+
+void odo_indices_unref (OdoIndices *indices);
+
+G_END_DECLS
+
+#endif
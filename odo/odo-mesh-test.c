@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <glib.h>
+#include "odo-mesh.h"
+
+/* Checks that the strips stay inside the grid and cover every tile with
+ * two triangles.
+ */
+static void
+check_strips (gint tiles_x,
+              gint tiles_y)
+{
+  guint32 *indices, *bf_indices;
+  guint32 max_index, max_bf_index;
+  guint8 *front_tiles, *back_tiles;
+  gint n_vertices, n_indices, n_tiles, i;
+
+  n_vertices = odo_mesh_get_n_vertices (tiles_x, tiles_y);
+  n_indices = odo_mesh_get_n_indices (tiles_x, tiles_y);
+  n_tiles = tiles_x * tiles_y;
+
+  if (g_test_verbose ())
+    g_print ("%dx%d tiles: %d vertices, %d indices\n",
+             tiles_x, tiles_y, n_vertices, n_indices);
+
+  indices = g_new (guint32, n_indices);
+  bf_indices = g_new (guint32, n_indices);
+  front_tiles = g_new0 (guint8, n_tiles);
+  back_tiles = g_new0 (guint8, n_tiles);
+
+  odo_mesh_build_strips (tiles_x, tiles_y, indices, bf_indices);
+
+  /* Nothing past the last vertex may be referenced, and the last vertex
+   * must be, so that indices wrapping around would show up as a smaller
+   * largest index.
+   */
+  max_index = max_bf_index = 0;
+  for (i = 0; i < n_indices; i++)
+    {
+      g_assert_cmpuint (indices[i], <, n_vertices);
+      g_assert_cmpuint (bf_indices[i], <, n_vertices);
+      max_index = MAX (max_index, indices[i]);
+      max_bf_index = MAX (max_bf_index, bf_indices[i]);
+    }
+  g_assert_cmpuint (max_index, ==, n_vertices - 1);
+  g_assert_cmpuint (max_bf_index, ==, n_vertices - 1);
+
+  for (i = 2; i < n_indices; i++)
+    {
+      guint32 *strips[] = { indices, bf_indices };
+      guint8 *tiles[] = { front_tiles, back_tiles };
+      gint s;
+
+      for (s = 0; s < 2; s++)
+        {
+          guint32 a = strips[s][i - 2], b = strips[s][i - 1], c = strips[s][i];
+          guint32 min_x, min_y;
+
+          /* Skip the degenerate triangles linking rows */
+          if (a == b || b == c || a == c)
+            continue;
+
+          min_x = MIN (a % (tiles_x + 1),
+                       MIN (b % (tiles_x + 1), c % (tiles_x + 1)));
+          min_y = MIN (a / (tiles_x + 1),
+                       MIN (b / (tiles_x + 1), c / (tiles_x + 1)));
+          tiles[s][min_y * tiles_x + min_x]++;
+        }
+    }
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      g_assert_cmpint (front_tiles[i], ==, 2);
+      g_assert_cmpint (back_tiles[i], ==, 2);
+    }
+
+  g_free (indices);
+  g_free (bf_indices);
+  g_free (front_tiles);
+  g_free (back_tiles);
+}
+
+static void
+test_mesh_small (void)
+{
+  check_strips (1, 1);
+  check_strips (3, 1);
+  check_strips (1, 4);
+  check_strips (32, 32);
+
+  g_assert (!odo_mesh_needs_int_indices (32, 32));
+}
+
+static void
+test_mesh_short_limit (void)
+{
+  /* 256x256 vertices is the most that short indices can address */
+  g_assert (!odo_mesh_needs_int_indices (255, 255));
+  g_assert (odo_mesh_needs_int_indices (256, 255));
+  check_strips (255, 255);
+}
+
+static void
+test_mesh_large (void)
+{
+  guint32 indices[] = { 0, G_MAXUINT16 };
+  guint16 *short_indices;
+
+  g_assert (odo_mesh_needs_int_indices (300, 300));
+  g_assert (odo_mesh_needs_int_indices (1000, 80));
+
+  /* Both go well past what 16 bits can index, and check_strips() makes
+   * sure their largest index is still the last vertex.
+   */
+  g_assert_cmpint (odo_mesh_get_n_vertices (300, 300), >,
+                   ODO_MESH_MAX_SHORT_VERTICES);
+  g_assert_cmpint (odo_mesh_get_n_vertices (1000, 80), >,
+                   ODO_MESH_MAX_SHORT_VERTICES);
+  check_strips (300, 300);
+  check_strips (1000, 80);
+
+  /* Narrowing must not lose anything up to the limit */
+  short_indices = odo_mesh_narrow_indices (indices, G_N_ELEMENTS (indices));
+  g_assert_cmpuint (short_indices[0], ==, 0);
+  g_assert_cmpuint (short_indices[1], ==, G_MAXUINT16);
+  g_free (short_indices);
+}
+
+int
+main (int     argc,
+      char  **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/mesh/small", test_mesh_small);
+  g_test_add_func ("/mesh/short-limit", test_mesh_short_limit);
+  g_test_add_func ("/mesh/large", test_mesh_large);
+
+  return g_test_run ();
+}
@@ -0,0 +1,116 @@
+/* odo-mesh.c */
+
+#include "odo-mesh.h"
+
+gint
+odo_mesh_get_n_vertices (gint tiles_x,
+                         gint tiles_y)
+{
+  return (tiles_x + 1) * (tiles_y + 1);
+}
+
+gint
+odo_mesh_get_n_indices (gint tiles_x,
+                        gint tiles_y)
+{
+  return (2 + 2 * tiles_x) * tiles_y + (tiles_y - 1);
+}
+
+gboolean
+odo_mesh_needs_int_indices (gint tiles_x,
+                            gint tiles_y)
+{
+  return odo_mesh_get_n_vertices (tiles_x, tiles_y) >
+         ODO_MESH_MAX_SHORT_VERTICES;
+}
+
+void
+odo_mesh_build_strips (gint     tiles_x,
+                       gint     tiles_y,
+                       guint32 *indices,
+                       guint32 *bf_indices)
+{
+  guint32 *idx, *bf_idx;
+  gint x, y, direction;
+
+#define MESH_INDEX(X, Y) (Y) * (tiles_x + 1) + (X)
+
+  direction = 1;
+
+  idx = indices;
+  idx[0] = MESH_INDEX (0, 0);
+  idx[1] = MESH_INDEX (0, 1);
+  idx += 2;
+
+  bf_idx = bf_indices;
+  bf_idx[0] = MESH_INDEX (tiles_x, 0);
+  bf_idx[1] = MESH_INDEX (tiles_x, 1);
+  bf_idx += 2;
+
+  for (y = 0; y < tiles_y; y++)
+    {
+      for (x = 0; x < tiles_x; x++)
+        {
+          /* Add 2 triangles for a quad */
+          if (direction)
+            {
+              idx[0] = MESH_INDEX (x + 1, y);
+              idx[1] = MESH_INDEX (x + 1, y + 1);
+              bf_idx[0] = MESH_INDEX (tiles_x - (x + 1), y);
+              bf_idx[1] = MESH_INDEX (tiles_x - (x + 1), y + 1);
+            }
+          else
+            {
+              idx[0] = MESH_INDEX (tiles_x - x - 1, y);
+              idx[1] = MESH_INDEX (tiles_x - x - 1, y + 1);
+              bf_idx[0] = MESH_INDEX (x + 1, y);
+              bf_idx[1] = MESH_INDEX (x + 1, y + 1);
+            }
+          idx += 2;
+          bf_idx += 2;
+        }
+
+      /* Link rows together to draw in one call */
+      if (y == (tiles_y - 1))
+        break;
+
+      if (direction)
+        {
+          idx[0] = MESH_INDEX (tiles_x, y + 1);
+          idx[1] = MESH_INDEX (tiles_x, y + 1);
+          idx[2] = MESH_INDEX (tiles_x, y + 2);
+          bf_idx[0] = MESH_INDEX (0, y + 1);
+          bf_idx[1] = MESH_INDEX (0, y + 1);
+          bf_idx[2] = MESH_INDEX (0, y + 2);
+        }
+      else
+        {
+          idx[0] = MESH_INDEX (0, y + 1);
+          idx[1] = MESH_INDEX (0, y + 1);
+          idx[2] = MESH_INDEX (0, y + 2);
+          bf_idx[0] = MESH_INDEX (tiles_x, y + 1);
+          bf_idx[1] = MESH_INDEX (tiles_x, y + 1);
+          bf_idx[2] = MESH_INDEX (tiles_x, y + 2);
+        }
+
+      idx += 3;
+      bf_idx += 3;
+      direction = !direction;
+    }
+
+#undef MESH_INDEX
+}
+
+guint16 *
+odo_mesh_narrow_indices (const guint32 *indices,
+                         gint           n_indices)
+{
+  guint16 *short_indices;
+  gint i;
+
+  short_indices = g_new (guint16, n_indices);
+  for (i = 0; i < n_indices; i++)
+    short_indices[i] = indices[i];
+
+  return short_indices;
+}
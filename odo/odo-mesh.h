@@ -0,0 +1,40 @@
+/* odo-mesh.h
+ *
+ * Triangle-strip indices for the OdoTexture grid. This doesn't use Cogl,
+ * so that it can be tested on its own (see odo-mesh-test.c).
+ */
+
+#ifndef ODO_MESH_H
+#define ODO_MESH_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Grids with more vertices than this can't be indexed with shorts */
+#define ODO_MESH_MAX_SHORT_VERTICES (G_MAXUINT16 + 1)
+
+gint odo_mesh_get_n_vertices (gint tiles_x,
+                              gint tiles_y);
+
+gint odo_mesh_get_n_indices (gint tiles_x,
+                             gint tiles_y);
+
+gboolean odo_mesh_needs_int_indices (gint tiles_x,
+                                     gint tiles_y);
+
+/* Fills in odo_mesh_get_n_indices() indices for a triangle strip that
+ * covers the grid with front-facing triangles, and another that covers
+ * it with back-facing ones.
+ */
+void odo_mesh_build_strips (gint     tiles_x,
+                            gint     tiles_y,
+                            guint32 *indices,
+                            guint32 *bf_indices);
+
+guint16 *odo_mesh_narrow_indices (const guint32 *indices,
+                                  gint           n_indices);
+
+G_END_DECLS
+
+#endif
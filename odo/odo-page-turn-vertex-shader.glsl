@@ -0,0 +1,53 @@
+/* Page-turn effect, see page_turn_func() in odo-distort-funcs.c.
+ * gl_Vertex is the flat grid, sized to width x height.
+ */
+uniform float turn;
+uniform float angle;
+uniform float radius;
+uniform float amplitude;
+uniform float width;
+uniform float height;
+
+const float PI = 3.14159265;
+const float HALF_PI = 1.57079633;
+
+void
+main ()
+{
+  vec4 position = gl_Vertex;
+  float shade = 1.0;
+
+  /* Rotate the point around the centre of the page-curl ray to align it
+     with the y-axis */
+  vec2 centre = (1.0 - turn) * vec2 (width, height);
+  vec2 offset = position.xy - centre;
+  float cos_a = cos (angle);
+  float sin_a = sin (angle);
+  float rx = (offset.x * cos_a) + (offset.y * sin_a) - radius;
+  float ry = (offset.y * cos_a) - (offset.x * sin_a);
+
+  if (rx > -radius * 2.0)
+    {
+      /* Curl angle as a function of the distance from the curl ray */
+      float turn_angle = (rx / radius * HALF_PI) - HALF_PI;
+
+      /* Gradient that makes it look like lighting */
+      shade = ((sin (turn_angle) * 96.0) + 159.0) / 255.0;
+
+      if (rx > 0.0)
+        {
+          /* Shrink the radius as more circles are formed, and wrap the
+             point around the cylinder */
+          float small_radius = radius - (turn_angle * 2.0) / PI;
+
+          rx = (small_radius * cos (turn_angle)) + radius;
+          position.x = (rx * cos_a) - (ry * sin_a) + centre.x;
+          position.y = (rx * sin_a) + (ry * cos_a) + centre.y;
+          position.z = (small_radius * sin (turn_angle)) + radius;
+        }
+    }
+
+  gl_Position = gl_ModelViewProjectionMatrix * position;
+  gl_TexCoord[0] = gl_MultiTexCoord0;
+  gl_FrontColor = vec4 (gl_Color.rgb * shade, gl_Color.a);
+}
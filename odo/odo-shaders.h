@@ -0,0 +1,20 @@
+/* odo-shaders.h
+ *
+ * The sources are generated from the .glsl files by the Makefile.
+ */
+
+#ifndef ODO_SHADERS_H
+#define ODO_SHADERS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+extern const char odo_page_turn_vertex_shader[];
+extern const char odo_cloth_vertex_shader[];
+extern const char odo_bowtie_vertex_shader[];
+extern const char odo_two_sided_fragment_shader[];
+
+G_END_DECLS
+
+#endif
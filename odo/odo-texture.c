@@ -1,29 +1,147 @@
 /* odo-texture.c */
 
+#include <math.h>
+#include <string.h>
 #include "odo-texture.h"
+#include "odo-indices.h"
+#include "odo-mesh.h"
+#include "odo-shaders.h"
 
 G_DEFINE_TYPE (OdoTexture, odo_texture, CLUTTER_TYPE_ACTOR)
 
 #define TEXTURE_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), ODO_TYPE_TEXTURE, OdoTexturePrivate))
 
-struct _OdoTexturePrivate
+typedef struct
+{
+  CoglHandle  program;
+  /* Set if shaders aren't available or this one won't compile */
+  gboolean    failed;
+
+  gint        turn_uniform;
+  gint        angle_uniform;
+  gint        radius_uniform;
+  gint        amplitude_uniform;
+  gint        width_uniform;
+  gint        height_uniform;
+  gint        front_uniform;
+  gint        back_uniform;
+} OdoTextureProgram;
+
+/* A grid of some resolution no finer than tiles_x by tiles_y. Only the
+ * first is used unless level of detail is enabled, in which case level n
+ * has a resolution of about 1/2^n of that and is created when first
+ * needed.
+ */
+typedef struct
+{
+  gint        tiles_x;
+  gint        tiles_y;
+  CoglHandle  vbo;
+  OdoIndices *indices;
+} OdoTextureLevel;
+
+#define ODO_TEXTURE_MAX_LEVELS 8
+
+/* The levels and arrays of a resolution the texture has switched away
+ * from. The last few are kept, so that going back and forth between
+ * resolutions (e.g. while animating) reuses their buffers.
+ */
+typedef struct
 {
   gint                tiles_x;
   gint                tiles_y;
-  OdoTextureCallback  callback;
-  gpointer            user_data;
+  OdoTextureLevel     levels[ODO_TEXTURE_MAX_LEVELS];
+  gint                n_levels;
+  CoglTextureVertex  *vertices;
+  gfloat             *column_tx;
+  gfloat             *row_ty;
+  gfloat             *lod_column_tx;
+  gfloat             *lod_row_ty;
+} OdoTextureGrid;
+
+#define ODO_TEXTURE_GRID_CACHE 4
+
+/* The deformation is sampled on a grid of this many tiles to find where
+ * it bends the texture, and movements of less than this many pixels
+ * from a straight line are ignored. How sharply a probe tile bends is
+ * weighed from 1 to ODO_TEXTURE_LOD_MAX_WEIGHT, one step for each
+ * doubling of the tolerance.
+ */
+#define ODO_TEXTURE_LOD_PROBE      16
+#define ODO_TEXTURE_LOD_TOLERANCE  0.5f
+#define ODO_TEXTURE_LOD_MAX_WEIGHT 4
+
+static const gchar *odo_texture_effect_sources[ODO_TEXTURE_N_EFFECTS] =
+{
+  NULL,
+  odo_page_turn_vertex_shader,
+  odo_cloth_vertex_shader,
+  odo_bowtie_vertex_shader
+};
 
-  CoglHandle          vbo;
-  gint                n_indices;
-  CoglHandle         *indices;
-  CoglHandle         *bf_indices;
+struct _OdoTexturePrivate
+{
+  gint                tiles_x;
+  gint                tiles_y;
+  OdoTextureCallback        callback;
+  OdoTextureDeformCallback  deform_callback;
+  OdoTextureBatchCallback   batch_callback;
+  gpointer                  user_data;
+
+  OdoTextureEffect          effect;
+  const OdoDistortData     *effect_data;
+  /* Indexed by effect, and whether both faces are drawn at once */
+  OdoTextureProgram         programs[ODO_TEXTURE_N_EFFECTS][2];
+  gboolean                  single_pass;
+  CoglHandle                material;
+
+  OdoTextureLevel     levels[ODO_TEXTURE_MAX_LEVELS];
+  gint                n_levels;
+  gint                level;
   CoglTextureVertex  *vertices;
 
+  /* Texture coordinates of the columns and rows of the current grid */
+  gfloat             *column_tx;
+  gfloat             *row_ty;
+
+  /* Earlier resolutions, most recently used first */
+  OdoTextureGrid      grids[ODO_TEXTURE_GRID_CACHE];
+  gint                n_grids;
+
+  /* Level of detail */
+  gboolean            lod;
+  gfloat              lod_tile_size;
+  gfloat             *lod_column_tx;
+  gfloat             *lod_row_ty;
+  CoglTextureVertex  *lod_probe;
+  gboolean            lod_probed;
+  /* How much each probe column and row bends, 0 if it stays flat */
+  guint8              lod_column_bend[ODO_TEXTURE_LOD_PROBE];
+  guint8              lod_row_bend[ODO_TEXTURE_LOD_PROBE];
+
   ClutterTexture     *front_face;
   ClutterTexture     *back_face;
 
   gboolean            dirty;
+
+  /* Large grids are deformed in bands of rows across a thread pool */
+  gint                n_threads;
+  gint                thread_threshold;
+  GThreadPool        *pool;
+  GMutex              bands_lock;
+  GCond               bands_cond;
+  gint                bands_pending;
+
+  /* Attributes that the last deformation moved away from the flat grid,
+   * and attributes that need uploading regardless (e.g. after the arrays
+   * were rebuilt, or the size or opacity changed).
+   */
+  OdoTextureAttributes  deformed;
+  OdoTextureAttributes  stale;
+  gfloat                width;
+  gfloat                height;
+  guint8                opacity;
 };
 
 enum
@@ -33,7 +151,12 @@ enum
   PROP_TILES_X,
   PROP_TILES_Y,
   PROP_FRONT_FACE,
-  PROP_BACK_FACE
+  PROP_BACK_FACE,
+  PROP_N_THREADS,
+  PROP_THREAD_THRESHOLD,
+  PROP_LOD,
+  PROP_LOD_TILE_SIZE,
+  PROP_SINGLE_PASS
 };
 
 static void
@@ -60,6 +183,26 @@ odo_texture_get_property (GObject *object, guint property_id,
       g_value_set_object (value, priv->back_face);
       break;
 
+    case PROP_N_THREADS:
+      g_value_set_int (value, priv->n_threads);
+      break;
+
+    case PROP_THREAD_THRESHOLD:
+      g_value_set_int (value, priv->thread_threshold);
+      break;
+
+    case PROP_LOD:
+      g_value_set_boolean (value, priv->lod);
+      break;
+
+    case PROP_LOD_TILE_SIZE:
+      g_value_set_float (value, priv->lod_tile_size);
+      break;
+
+    case PROP_SINGLE_PASS:
+      g_value_set_boolean (value, priv->single_pass);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -98,130 +241,1087 @@ odo_texture_set_property (GObject *object, guint property_id,
                                 g_value_get_object (value));
       break;
 
+    case PROP_N_THREADS:
+      odo_texture_set_threads (texture,
+                               g_value_get_int (value),
+                               priv->thread_threshold);
+      break;
+
+    case PROP_THREAD_THRESHOLD:
+      odo_texture_set_threads (texture,
+                               priv->n_threads,
+                               g_value_get_int (value));
+      break;
+
+    case PROP_LOD:
+      odo_texture_set_lod (texture,
+                           g_value_get_boolean (value),
+                           priv->lod_tile_size);
+      break;
+
+    case PROP_LOD_TILE_SIZE:
+      odo_texture_set_lod (texture,
+                           priv->lod,
+                           g_value_get_float (value));
+      break;
+
+    case PROP_SINGLE_PASS:
+      odo_texture_set_single_pass (texture, g_value_get_boolean (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
 }
 
+/* Moves the current levels and arrays out into grid, leaving none */
+static void
+odo_texture_save_grid (OdoTexture     *self,
+                       OdoTextureGrid *grid,
+                       gint            tiles_x,
+                       gint            tiles_y)
+{
+  OdoTexturePrivate *priv = self->priv;
+
+  grid->tiles_x = tiles_x;
+  grid->tiles_y = tiles_y;
+  memcpy (grid->levels, priv->levels, sizeof (priv->levels));
+  grid->n_levels = priv->n_levels;
+  grid->vertices = priv->vertices;
+  grid->column_tx = priv->column_tx;
+  grid->row_ty = priv->row_ty;
+  grid->lod_column_tx = priv->lod_column_tx;
+  grid->lod_row_ty = priv->lod_row_ty;
+
+  memset (priv->levels, 0, sizeof (priv->levels));
+  priv->n_levels = 0;
+  priv->vertices = NULL;
+  priv->column_tx = NULL;
+  priv->row_ty = NULL;
+  priv->lod_column_tx = NULL;
+  priv->lod_row_ty = NULL;
+}
+
+static void
+odo_texture_load_grid (OdoTexture     *self,
+                       OdoTextureGrid *grid)
+{
+  OdoTexturePrivate *priv = self->priv;
+
+  memcpy (priv->levels, grid->levels, sizeof (priv->levels));
+  priv->n_levels = grid->n_levels;
+  priv->vertices = grid->vertices;
+  priv->column_tx = grid->column_tx;
+  priv->row_ty = grid->row_ty;
+  priv->lod_column_tx = grid->lod_column_tx;
+  priv->lod_row_ty = grid->lod_row_ty;
+}
+
+static void
+odo_texture_grid_free (OdoTextureGrid *grid)
+{
+  gint i;
+
+  for (i = 0; i < grid->n_levels; i++)
+    {
+      OdoTextureLevel *level = &grid->levels[i];
+
+      if (level->vbo)
+        cogl_handle_unref (level->vbo);
+
+      if (level->indices)
+        odo_indices_unref (level->indices);
+    }
+
+  g_free (grid->vertices);
+  g_free (grid->column_tx);
+  g_free (grid->row_ty);
+  g_free (grid->lod_column_tx);
+  g_free (grid->lod_row_ty);
+}
+
+/* Keeps the current levels and arrays, for a resolution of tiles_x by
+ * tiles_y, in the cache of earlier grids.
+ */
+static void
+odo_texture_stash_grid (OdoTexture *self,
+                        gint        tiles_x,
+                        gint        tiles_y)
+{
+  OdoTexturePrivate *priv = self->priv;
+
+  if (!priv->vertices)
+    return;
+
+  if (priv->n_grids == ODO_TEXTURE_GRID_CACHE)
+    odo_texture_grid_free (&priv->grids[--priv->n_grids]);
+
+  memmove (&priv->grids[1], &priv->grids[0],
+           priv->n_grids * sizeof (OdoTextureGrid));
+  priv->n_grids++;
+
+  odo_texture_save_grid (self, &priv->grids[0], tiles_x, tiles_y);
+}
+
+/* Takes the grid for the current resolution back out of the cache.
+ * Returns FALSE if it isn't there.
+ */
+static gboolean
+odo_texture_unstash_grid (OdoTexture *self)
+{
+  gint i;
+  OdoTexturePrivate *priv = self->priv;
+
+  for (i = 0; i < priv->n_grids; i++)
+    if ((priv->grids[i].tiles_x == priv->tiles_x) &&
+        (priv->grids[i].tiles_y == priv->tiles_y))
+      {
+        odo_texture_load_grid (self, &priv->grids[i]);
+
+        priv->n_grids--;
+        memmove (&priv->grids[i], &priv->grids[i + 1],
+                 (priv->n_grids - i) * sizeof (OdoTextureGrid));
+
+        return TRUE;
+      }
+
+  return FALSE;
+}
+
 static void
 odo_texture_free_arrays (OdoTexture *self)
+{
+  OdoTextureGrid current;
+  OdoTexturePrivate *priv = self->priv;
+
+  odo_texture_save_grid (self, &current, priv->tiles_x, priv->tiles_y);
+  odo_texture_grid_free (&current);
+
+  while (priv->n_grids > 0)
+    odo_texture_grid_free (&priv->grids[--priv->n_grids]);
+
+  g_free (priv->lod_probe);
+  priv->lod_probe = NULL;
+}
+
+/* Drops the single-pass material, so that it gets rebuilt from the
+ * faces' materials the next time it's needed.
+ */
+static void
+odo_texture_material_changed (OdoTexture *self)
 {
   OdoTexturePrivate *priv = self->priv;
 
-  if (priv->vbo)
+  if (priv->material != COGL_INVALID_HANDLE)
     {
-      cogl_handle_unref (priv->vbo);
-      priv->vbo = NULL;
+      cogl_handle_unref (priv->material);
+      priv->material = COGL_INVALID_HANDLE;
     }
 
-  if (priv->indices)
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
+}
+
+static void
+odo_texture_watch_face (OdoTexture     *self,
+                        ClutterTexture *face)
+{
+  g_signal_connect_swapped (face, "notify::cogl-texture",
+                            G_CALLBACK (odo_texture_material_changed),
+                            self);
+  g_signal_connect_swapped (face, "notify::cogl-material",
+                            G_CALLBACK (odo_texture_material_changed),
+                            self);
+  g_signal_connect_swapped (face, "notify::filter-quality",
+                            G_CALLBACK (odo_texture_material_changed),
+                            self);
+}
+
+static void
+odo_texture_unwatch_face (OdoTexture     *self,
+                          ClutterTexture *face)
+{
+  g_signal_handlers_disconnect_by_func (face,
+                                        odo_texture_material_changed,
+                                        self);
+}
+
+/* Builds a material with the front face's material on the first layer
+ * and the back face's texture on the second, filtered the same way as
+ * it is in the back face's material.
+ */
+static CoglHandle
+odo_texture_build_material (OdoTexture *self)
+{
+  CoglHandle material, back_material, back_layer;
+  const GList *layers;
+  OdoTexturePrivate *priv = self->priv;
+
+  material =
+    cogl_material_copy (clutter_texture_get_cogl_material (priv->front_face));
+
+  cogl_material_set_layer (material, 1,
+                           clutter_texture_get_cogl_texture (priv->back_face));
+
+  back_material = clutter_texture_get_cogl_material (priv->back_face);
+  layers = cogl_material_get_layers (back_material);
+  if (layers)
     {
-      cogl_handle_unref (priv->indices);
-      priv->indices = NULL;
+      back_layer = layers->data;
+      cogl_material_set_layer_filters (material, 1,
+                                       cogl_material_layer_get_min_filter
+                                         (back_layer),
+                                       cogl_material_layer_get_mag_filter
+                                         (back_layer));
     }
 
-  g_free (priv->vertices);
-  priv->vertices = NULL;
+  return material;
 }
 
 static void
 odo_texture_dispose (GObject *object)
 {
+  gint i, j;
   OdoTexture *self = ODO_TEXTURE (object);
   OdoTexturePrivate *priv = self->priv;
 
   odo_texture_free_arrays (self);
 
+  for (i = 0; i < ODO_TEXTURE_N_EFFECTS; i++)
+    for (j = 0; j < 2; j++)
+      {
+        OdoTextureProgram *program = &priv->programs[i][j];
+
+        if (program->program != COGL_INVALID_HANDLE)
+          {
+            cogl_handle_unref (program->program);
+            program->program = COGL_INVALID_HANDLE;
+          }
+      }
+
+  if (priv->material != COGL_INVALID_HANDLE)
+    {
+      cogl_handle_unref (priv->material);
+      priv->material = COGL_INVALID_HANDLE;
+    }
+
   if (priv->front_face)
     {
+      odo_texture_unwatch_face (self, priv->front_face);
       g_object_unref (priv->front_face);
       priv->front_face = NULL;
     }
 
   if (priv->back_face)
     {
+      odo_texture_unwatch_face (self, priv->back_face);
       g_object_unref (priv->back_face);
       priv->back_face = NULL;
     }
 
+  if (priv->pool)
+    {
+      g_thread_pool_free (priv->pool, FALSE, TRUE);
+      priv->pool = NULL;
+    }
+
   G_OBJECT_CLASS (odo_texture_parent_class)->dispose (object);
 }
 
 static void
 odo_texture_finalize (GObject *object)
 {
+  OdoTexturePrivate *priv = ODO_TEXTURE (object)->priv;
+
+  g_mutex_clear (&priv->bands_lock);
+  g_cond_clear (&priv->bands_cond);
+
   G_OBJECT_CLASS (odo_texture_parent_class)->finalize (object);
 }
 
+/* Resets vertices to a flat, opaque-white mesh */
+static void
+odo_texture_flatten_vertices (CoglTextureVertex *vertex,
+                              gint               n_vertices,
+                              gfloat             width,
+                              gfloat             height,
+                              guint8             opacity)
+{
+  CoglTextureVertex *last = vertex + n_vertices;
+
+  for (; vertex < last; vertex++)
+    {
+      /* Texture coordinates are set in odo_texture_set_grid() */
+      vertex->x = width * vertex->tx;
+      vertex->y = height * vertex->ty;
+      vertex->z = 0;
+      cogl_color_set_from_4ub (&vertex->color, 0xff, 0xff, 0xff, opacity);
+    }
+}
+
+/* Resets a block of whole rows of the grid to a flat, opaque-white mesh */
+static void
+odo_texture_flatten_rows (OdoTexture *self,
+                          gint        first_row,
+                          gint        n_rows,
+                          gfloat      width,
+                          gfloat      height,
+                          guint8      opacity)
+{
+  OdoTexturePrivate *priv = self->priv;
+  gint n_columns = priv->levels[priv->level].tiles_x + 1;
+
+  odo_texture_flatten_vertices (&priv->vertices[first_row * n_columns],
+                                n_rows * n_columns,
+                                width, height, opacity);
+}
+
+static gboolean
+odo_texture_has_callback (OdoTexture *self)
+{
+  OdoTexturePrivate *priv = self->priv;
+
+  return priv->batch_callback || priv->deform_callback || priv->callback;
+}
+
+/* Runs the deformation callback over a block of whole rows of vertices,
+ * returning the attributes it touched.
+ */
+static OdoTextureAttributes
+odo_texture_run_callback (OdoTexture        *self,
+                          CoglTextureVertex *first,
+                          gint               n_columns,
+                          gint               n_rows,
+                          gfloat             width,
+                          gfloat             height)
+{
+  CoglTextureVertex *last, *vertex;
+  OdoTextureAttributes touched;
+
+  OdoTexturePrivate *priv = self->priv;
+
+  last = first + (n_rows * n_columns);
+  touched = ODO_TEXTURE_ATTRIBUTE_NONE;
+
+  if (priv->batch_callback)
+    touched = priv->batch_callback (self, first, n_columns, n_rows,
+                                    width, height, priv->user_data);
+  else if (priv->deform_callback)
+    {
+      for (vertex = first; vertex < last; vertex++)
+        touched |= priv->deform_callback (self, vertex, width, height,
+                                          priv->user_data);
+    }
+  else if (priv->callback)
+    {
+      for (vertex = first; vertex < last; vertex++)
+        {
+          gfloat tx = vertex->tx, ty = vertex->ty;
+
+          priv->callback (self, vertex, width, height, priv->user_data);
+
+          /* The grid owns the texture coordinates, and they aren't
+           * reset between frames, so undo any changes to them.
+           */
+          vertex->tx = tx;
+          vertex->ty = ty;
+        }
+      touched = ODO_TEXTURE_ATTRIBUTE_ALL;
+    }
+
+  return touched;
+}
+
+/* Flattens a block of whole rows and runs the deformation callback over
+ * it, returning the attributes it touched.
+ */
+static OdoTextureAttributes
+odo_texture_deform_rows (OdoTexture *self,
+                         gint        first_row,
+                         gint        n_rows,
+                         gfloat      width,
+                         gfloat      height,
+                         guint8      opacity)
+{
+  OdoTexturePrivate *priv = self->priv;
+  gint n_columns = priv->levels[priv->level].tiles_x + 1;
+
+  odo_texture_flatten_rows (self, first_row, n_rows, width, height, opacity);
+
+  return odo_texture_run_callback (self,
+                                   &priv->vertices[first_row * n_columns],
+                                   n_columns, n_rows, width, height);
+}
+
+typedef struct
+{
+  OdoTexture           *texture;
+  gint                  first_row;
+  gint                  n_rows;
+  gfloat                width;
+  gfloat                height;
+  guint8                opacity;
+  OdoTextureAttributes  touched;
+} OdoTextureBand;
+
+static void
+odo_texture_deform_band (OdoTextureBand *band)
+{
+  band->touched = odo_texture_deform_rows (band->texture,
+                                           band->first_row,
+                                           band->n_rows,
+                                           band->width,
+                                           band->height,
+                                           band->opacity);
+}
+
+static void
+odo_texture_band_thread (gpointer data,
+                         gpointer user_data)
+{
+  OdoTextureBand *band = data;
+  OdoTexturePrivate *priv = band->texture->priv;
+
+  odo_texture_deform_band (band);
+
+  g_mutex_lock (&priv->bands_lock);
+  if (--priv->bands_pending == 0)
+    g_cond_signal (&priv->bands_cond);
+  g_mutex_unlock (&priv->bands_lock);
+}
+
+/* Deforms the whole grid, splitting it into bands of rows across the
+ * thread pool if it's big enough to be worth it. This thread takes the
+ * first band and then waits for the rest, so the result is complete
+ * before it gets uploaded.
+ */
+static OdoTextureAttributes
+odo_texture_deform (OdoTexture *self,
+                    gfloat      width,
+                    gfloat      height,
+                    guint8      opacity)
+{
+  OdoTextureBand *bands;
+  OdoTextureAttributes touched;
+  gint i, n_rows, n_bands;
+
+  OdoTexturePrivate *priv = self->priv;
+  OdoTextureLevel *level = &priv->levels[priv->level];
+
+  n_rows = level->tiles_y + 1;
+  n_bands = MIN (priv->n_threads, n_rows);
+
+  if ((n_bands <= 1) ||
+      ((n_rows * (level->tiles_x + 1)) < priv->thread_threshold))
+    return odo_texture_deform_rows (self, 0, n_rows, width, height, opacity);
+
+  if (!priv->pool)
+    priv->pool = g_thread_pool_new (odo_texture_band_thread,
+                                    NULL,
+                                    priv->n_threads - 1,
+                                    FALSE,
+                                    NULL);
+
+  bands = g_newa (OdoTextureBand, n_bands);
+  for (i = 0; i < n_bands; i++)
+    {
+      bands[i].texture = self;
+      bands[i].first_row = (i * n_rows) / n_bands;
+      bands[i].n_rows = (((i + 1) * n_rows) / n_bands) - bands[i].first_row;
+      bands[i].width = width;
+      bands[i].height = height;
+      bands[i].opacity = opacity;
+    }
+
+  priv->bands_pending = n_bands - 1;
+  for (i = 1; i < n_bands; i++)
+    g_thread_pool_push (priv->pool, &bands[i], NULL);
+
+  odo_texture_deform_band (&bands[0]);
+
+  g_mutex_lock (&priv->bands_lock);
+  while (priv->bands_pending)
+    g_cond_wait (&priv->bands_cond, &priv->bands_lock);
+  g_mutex_unlock (&priv->bands_lock);
+
+  touched = ODO_TEXTURE_ATTRIBUTE_NONE;
+  for (i = 0; i < n_bands; i++)
+    touched |= bands[i].touched;
+
+  return touched;
+}
+
+static CoglHandle
+odo_texture_compile_shader (CoglShaderType  type,
+                            const gchar    *source)
+{
+  CoglHandle shader = cogl_create_shader (type);
+
+  if (shader == COGL_INVALID_HANDLE)
+    {
+      g_warning ("Failed to create shader");
+      return COGL_INVALID_HANDLE;
+    }
+
+  cogl_shader_source (shader, source);
+  cogl_shader_compile (shader);
+
+  if (!cogl_shader_is_compiled (shader))
+    {
+      gchar *info_log = cogl_shader_get_info_log (shader);
+      g_warning ("%s", info_log);
+      g_free (info_log);
+      cogl_handle_unref (shader);
+      return COGL_INVALID_HANDLE;
+    }
+
+  return shader;
+}
+
+/* Builds a program with the vertex shader for the effect, if any, and
+ * the two-sided fragment shader if single_pass is set.
+ */
+static gboolean
+odo_texture_compile_program (OdoTexture       *self,
+                             OdoTextureEffect  effect,
+                             gboolean          single_pass)
+{
+  OdoTexturePrivate *priv = self->priv;
+  OdoTextureProgram *program = &priv->programs[effect][single_pass];
+  CoglHandle vertex_shader, fragment_shader, handle;
+
+  /* If we've previously failed to create a shader then don't try again */
+  if (program->failed)
+    return FALSE;
+
+  if (program->program != COGL_INVALID_HANDLE)
+    return TRUE;
+
+  vertex_shader = fragment_shader = COGL_INVALID_HANDLE;
+  program->failed = TRUE;
+
+  if (effect != ODO_TEXTURE_EFFECT_NONE)
+    {
+      vertex_shader =
+        odo_texture_compile_shader (COGL_SHADER_TYPE_VERTEX,
+                                    odo_texture_effect_sources[effect]);
+      if (vertex_shader == COGL_INVALID_HANDLE)
+        return FALSE;
+    }
+
+  if (single_pass)
+    {
+      fragment_shader =
+        odo_texture_compile_shader (COGL_SHADER_TYPE_FRAGMENT,
+                                    odo_two_sided_fragment_shader);
+      if (fragment_shader == COGL_INVALID_HANDLE)
+        {
+          if (vertex_shader != COGL_INVALID_HANDLE)
+            cogl_handle_unref (vertex_shader);
+          return FALSE;
+        }
+    }
+
+  handle = cogl_create_program ();
+
+  if (vertex_shader != COGL_INVALID_HANDLE)
+    {
+      cogl_program_attach_shader (handle, vertex_shader);
+      cogl_handle_unref (vertex_shader);
+    }
+  if (fragment_shader != COGL_INVALID_HANDLE)
+    {
+      cogl_program_attach_shader (handle, fragment_shader);
+      cogl_handle_unref (fragment_shader);
+    }
+
+  cogl_program_link (handle);
+
+  /* Not every effect uses every parameter, so unused uniforms may have
+   * been optimised out. Setting a uniform at location -1 is silently
+   * ignored.
+   */
+  program->turn_uniform =
+    cogl_program_get_uniform_location (handle, "turn");
+  program->angle_uniform =
+    cogl_program_get_uniform_location (handle, "angle");
+  program->radius_uniform =
+    cogl_program_get_uniform_location (handle, "radius");
+  program->amplitude_uniform =
+    cogl_program_get_uniform_location (handle, "amplitude");
+  program->width_uniform =
+    cogl_program_get_uniform_location (handle, "width");
+  program->height_uniform =
+    cogl_program_get_uniform_location (handle, "height");
+  program->front_uniform =
+    cogl_program_get_uniform_location (handle, "front");
+  program->back_uniform =
+    cogl_program_get_uniform_location (handle, "back");
+
+  program->program = handle;
+  program->failed = FALSE;
+
+  return TRUE;
+}
+
+/* Picks the program to paint with, falling back to drawing the faces
+ * separately and then to deforming on the CPU if the shaders can't be
+ * used. Returns NULL if no program is needed.
+ */
+static OdoTextureProgram *
+odo_texture_choose_program (OdoTexture       *self,
+                            OdoTextureEffect *effect,
+                            gboolean         *single_pass)
+{
+  OdoTexturePrivate *priv = self->priv;
+
+  *effect = priv->effect_data ? priv->effect : ODO_TEXTURE_EFFECT_NONE;
+  *single_pass = priv->single_pass && priv->front_face && priv->back_face;
+
+  if ((*effect != ODO_TEXTURE_EFFECT_NONE) || *single_pass)
+    {
+      if (odo_texture_compile_program (self, *effect, *single_pass))
+        return &priv->programs[*effect][*single_pass];
+    }
+
+  if (*single_pass && (*effect != ODO_TEXTURE_EFFECT_NONE))
+    {
+      if (odo_texture_compile_program (self, *effect, FALSE))
+        {
+          *single_pass = FALSE;
+          return &priv->programs[*effect][FALSE];
+        }
+
+      if (odo_texture_compile_program (self, ODO_TEXTURE_EFFECT_NONE, TRUE))
+        {
+          *effect = ODO_TEXTURE_EFFECT_NONE;
+          return &priv->programs[ODO_TEXTURE_EFFECT_NONE][TRUE];
+        }
+    }
+
+  *effect = ODO_TEXTURE_EFFECT_NONE;
+  *single_pass = FALSE;
+
+  return NULL;
+}
+
+static void
+odo_texture_ensure_level (OdoTexture *self,
+                          gint        index)
+{
+  OdoTexturePrivate *priv = self->priv;
+  OdoTextureLevel *level = &priv->levels[index];
+
+  if (level->vbo)
+    return;
+
+  level->tiles_x = MAX (1, priv->tiles_x >> index);
+  level->tiles_y = MAX (1, priv->tiles_y >> index);
+
+  /* The indices only depend on the resolution, so they are shared with
+   * any other texture using the same one.
+   */
+  level->indices = odo_indices_get (level->tiles_x, level->tiles_y);
+
+  level->vbo = cogl_vertex_buffer_new (odo_mesh_get_n_vertices
+                                         (level->tiles_x, level->tiles_y));
+}
+
+static void
+odo_texture_uniform_coords (gfloat *coords,
+                            gint    n_tiles)
+{
+  gint i;
+
+  for (i = 0; i <= n_tiles; i++)
+    coords[i] = i / (gfloat)n_tiles;
+}
+
+/* Switches to drawing the given level, with the columns and rows at the
+ * texture coordinates in priv->column_tx and priv->row_ty.
+ */
+static void
+odo_texture_set_grid (OdoTexture *self,
+                      gint        index)
+{
+  gint x, y;
+  OdoTextureLevel *level;
+  CoglTextureVertex *vertex;
+  OdoTexturePrivate *priv = self->priv;
+
+  odo_texture_ensure_level (self, index);
+  priv->level = index;
+  level = &priv->levels[index];
+
+  vertex = priv->vertices;
+  for (y = 0; y <= level->tiles_y; y++)
+    for (x = 0; x <= level->tiles_x; x++, vertex++)
+      {
+        vertex->tx = priv->column_tx[x];
+        vertex->ty = priv->row_ty[y];
+      }
+
+  /* Texture coordinates don't change until the grid does, so they only
+   * get uploaded here.
+   */
+  cogl_vertex_buffer_add (level->vbo,
+                          "gl_MultiTexCoord0",
+                          2,
+                          COGL_ATTRIBUTE_TYPE_FLOAT,
+                          FALSE,
+                          sizeof (CoglTextureVertex),
+                          &priv->vertices->tx);
+
+  priv->deformed = ODO_TEXTURE_ATTRIBUTE_NONE;
+  priv->stale = ODO_TEXTURE_ATTRIBUTE_ALL;
+}
+
+/* How far b is from the line between a and c, or its colour from the
+ * average of theirs, as a weight from 0 (within the tolerance) up to
+ * ODO_TEXTURE_LOD_MAX_WEIGHT.
+ */
+static guint8
+odo_texture_lod_bend (const CoglTextureVertex *a,
+                      const CoglTextureVertex *b,
+                      const CoglTextureVertex *c)
+{
+  gfloat bend;
+  gint color;
+
+  bend = MAX (fabsf (a->x - 2 * b->x + c->x),
+              MAX (fabsf (a->y - 2 * b->y + c->y),
+                   fabsf (a->z - 2 * b->z + c->z)));
+
+  color = MAX (MAX (ABS (a->color.red - 2 * b->color.red + c->color.red),
+                    ABS (a->color.green - 2 * b->color.green +
+                         c->color.green)),
+               MAX (ABS (a->color.blue - 2 * b->color.blue + c->color.blue),
+                    ABS (a->color.alpha - 2 * b->color.alpha +
+                         c->color.alpha)));
+
+  /* A colour step of 2 counts the same as the positional tolerance */
+  bend = MAX (bend, color * (ODO_TEXTURE_LOD_TOLERANCE / 2));
+
+  if (bend <= ODO_TEXTURE_LOD_TOLERANCE)
+    return 0;
+
+  return MIN (ODO_TEXTURE_LOD_MAX_WEIGHT,
+              1 + (gint)log2f (bend / ODO_TEXTURE_LOD_TOLERANCE));
+}
+
+/* Runs the deformation over a coarse grid to find how much each of its
+ * columns and rows bends. Returns FALSE if there is no callback to run.
+ */
+static gboolean
+odo_texture_lod_probe (OdoTexture *self,
+                       gfloat      width,
+                       gfloat      height)
+{
+  gint x, y, n;
+  guint8 bend;
+  CoglTextureVertex *probe;
+  OdoTexturePrivate *priv = self->priv;
+
+  if (!odo_texture_has_callback (self))
+    return FALSE;
+
+  n = ODO_TEXTURE_LOD_PROBE + 1;
+  if (!priv->lod_probe)
+    priv->lod_probe = g_new (CoglTextureVertex, n * n);
+  probe = priv->lod_probe;
+
+  for (y = 0; y < n; y++)
+    for (x = 0; x < n; x++)
+      {
+        probe[(y * n) + x].tx = x / (gfloat)ODO_TEXTURE_LOD_PROBE;
+        probe[(y * n) + x].ty = y / (gfloat)ODO_TEXTURE_LOD_PROBE;
+      }
+
+  odo_texture_flatten_vertices (probe, n * n, width, height, 0xff);
+  odo_texture_run_callback (self, probe, n, n, width, height);
+
+  memset (priv->lod_column_bend, 0, sizeof (priv->lod_column_bend));
+  memset (priv->lod_row_bend, 0, sizeof (priv->lod_row_bend));
+
+  /* Each column and row takes the sharpest bend found along it, so the
+   * most tiles go where the curl is rather than being shared evenly
+   * between everything that moves.
+   */
+  for (y = 0; y < n; y++)
+    for (x = 1; x < n - 1; x++)
+      {
+        CoglTextureVertex *v = &probe[(y * n) + x];
+
+        bend = odo_texture_lod_bend (v - 1, v, v + 1);
+        priv->lod_column_bend[x - 1] = MAX (priv->lod_column_bend[x - 1],
+                                            bend);
+        priv->lod_column_bend[x] = MAX (priv->lod_column_bend[x], bend);
+      }
+
+  for (y = 1; y < n - 1; y++)
+    for (x = 0; x < n; x++)
+      {
+        CoglTextureVertex *v = &probe[(y * n) + x];
+
+        bend = odo_texture_lod_bend (v - n, v, v + n);
+        priv->lod_row_bend[y - 1] = MAX (priv->lod_row_bend[y - 1], bend);
+        priv->lod_row_bend[y] = MAX (priv->lod_row_bend[y], bend);
+      }
+
+  return TRUE;
+}
+
+static gint
+odo_texture_lod_count_bent (const guint8 *bend,
+                            gint         *total_bend)
+{
+  gint i, n_bent = 0;
+
+  if (total_bend)
+    *total_bend = 0;
+
+  for (i = 0; i < ODO_TEXTURE_LOD_PROBE; i++)
+    if (bend[i])
+      {
+        n_bent++;
+        if (total_bend)
+          *total_bend += bend[i];
+      }
+
+  return n_bent;
+}
+
+/* The amount of tiles needed along one side, if bent probe tiles need
+ * enough tiles to have screen_tiles across the whole side and flat ones
+ * need only one.
+ */
+static gint
+odo_texture_lod_needed (const guint8 *bend,
+                        gint          screen_tiles)
+{
+  gint n_bent = odo_texture_lod_count_bent (bend, NULL);
+
+  if (n_bent == 0)
+    return 1;
+
+  return (ODO_TEXTURE_LOD_PROBE - n_bent) +
+         n_bent * ((screen_tiles + ODO_TEXTURE_LOD_PROBE - 1) /
+                   ODO_TEXTURE_LOD_PROBE);
+}
+
+/* Spreads n_tiles tiles along one side, giving one to each probe tile
+ * and sharing the rest between the bent ones by how much they bend.
+ */
+static void
+odo_texture_lod_distribute (const guint8 *bend,
+                            gint          n_tiles,
+                            gfloat       *coords)
+{
+  gint i, j, n, n_bent, total_bend, spare, bend_seen, given, share, tile;
+
+  n_bent = bend ? odo_texture_lod_count_bent (bend, &total_bend) : 0;
+
+  if ((n_bent == 0) || (n_tiles < ODO_TEXTURE_LOD_PROBE))
+    {
+      odo_texture_uniform_coords (coords, n_tiles);
+      return;
+    }
+
+  spare = n_tiles - ODO_TEXTURE_LOD_PROBE;
+  bend_seen = 0;
+  given = 0;
+  tile = 0;
+
+  for (i = 0; i < ODO_TEXTURE_LOD_PROBE; i++)
+    {
+      n = 1;
+
+      /* Round the running total, so the shares add up to spare */
+      if (bend[i])
+        {
+          bend_seen += bend[i];
+          share = (spare * bend_seen) / total_bend;
+          n += share - given;
+          given = share;
+        }
+
+      for (j = 0; j < n; j++)
+        coords[tile++] = (i + (j / (gfloat)n)) / ODO_TEXTURE_LOD_PROBE;
+    }
+
+  coords[n_tiles] = 1.f;
+}
+
+/* Picks the coarsest level that gives tiles of about lod_tile_size
+ * pixels on screen where the texture bends, and concentrates its columns
+ * and rows there. Flat parts of the texture only need a single tile.
+ *
+ * When the deformation runs in a shader, nothing is probed, so that the
+ * CPU never runs it; the grid is then spread evenly.
+ */
+static void
+odo_texture_update_lod (OdoTexture *self,
+                        gboolean    use_shader)
+{
+  ClutterVertex verts[4];
+  ClutterActorBox box;
+  gfloat screen_w, screen_h;
+  gint screen_x, screen_y, needed_x, needed_y, index;
+  OdoTextureLevel *level;
+
+  OdoTexturePrivate *priv = self->priv;
+  ClutterActor *actor = CLUTTER_ACTOR (self);
+
+  /* Only run the probe when the deformation may have changed */
+  if (use_shader)
+    priv->lod_probed = FALSE;
+  else if (priv->dirty)
+    {
+      clutter_actor_get_allocation_box (actor, &box);
+      priv->lod_probed = odo_texture_lod_probe (self,
+                                                box.x2 - box.x1,
+                                                box.y2 - box.y1);
+    }
+
+  /* The vertices are top-left, top-right, bottom-left, bottom-right */
+  clutter_actor_get_abs_allocation_vertices (actor, verts);
+  screen_w = MAX (hypotf (verts[1].x - verts[0].x, verts[1].y - verts[0].y),
+                  hypotf (verts[3].x - verts[2].x, verts[3].y - verts[2].y));
+  screen_h = MAX (hypotf (verts[2].x - verts[0].x, verts[2].y - verts[0].y),
+                  hypotf (verts[3].x - verts[1].x, verts[3].y - verts[1].y));
+
+  screen_x = CLAMP (ceilf (screen_w / priv->lod_tile_size), 1, priv->tiles_x);
+  screen_y = CLAMP (ceilf (screen_h / priv->lod_tile_size), 1, priv->tiles_y);
+
+  if (priv->lod_probed)
+    {
+      needed_x = odo_texture_lod_needed (priv->lod_column_bend, screen_x);
+      needed_y = odo_texture_lod_needed (priv->lod_row_bend, screen_y);
+    }
+  else
+    {
+      needed_x = screen_x;
+      needed_y = screen_y;
+    }
+
+  for (index = priv->n_levels - 1; index > 0; index--)
+    {
+      if ((MAX (1, priv->tiles_x >> index) >= needed_x) &&
+          (MAX (1, priv->tiles_y >> index) >= needed_y))
+        break;
+    }
+
+  odo_texture_ensure_level (self, index);
+  level = &priv->levels[index];
+
+  odo_texture_lod_distribute (priv->lod_probed ?
+                                priv->lod_column_bend : NULL,
+                              level->tiles_x, priv->lod_column_tx);
+  odo_texture_lod_distribute (priv->lod_probed ?
+                                priv->lod_row_bend : NULL,
+                              level->tiles_y, priv->lod_row_ty);
+
+  if ((index == priv->level) &&
+      !memcmp (priv->lod_column_tx, priv->column_tx,
+               (level->tiles_x + 1) * sizeof (gfloat)) &&
+      !memcmp (priv->lod_row_ty, priv->row_ty,
+               (level->tiles_y + 1) * sizeof (gfloat)))
+    return;
+
+  memcpy (priv->column_tx, priv->lod_column_tx,
+          (level->tiles_x + 1) * sizeof (gfloat));
+  memcpy (priv->row_ty, priv->lod_row_ty,
+          (level->tiles_y + 1) * sizeof (gfloat));
+  odo_texture_set_grid (self, index);
+
+  priv->dirty = TRUE;
+}
+
 static void
 odo_texture_paint (ClutterActor *actor)
 {
-  gint i, j;
   CoglHandle material;
-  gboolean depth, cull;
+  gboolean depth, cull, want_cull, use_shader, single_pass;
+  OdoTextureEffect effect;
+  OdoTextureProgram *program;
+  OdoTextureLevel *level;
 
   OdoTexture *self = ODO_TEXTURE (actor);
   OdoTexturePrivate *priv = self->priv;
 
+  /* The built-in effects can run entirely on the GPU. If the shader can't
+   * be used, fall back to whatever callback is set.
+   */
+  program = odo_texture_choose_program (self, &effect, &single_pass);
+  use_shader = (effect != ODO_TEXTURE_EFFECT_NONE);
+
+  if (priv->lod)
+    odo_texture_update_lod (self, use_shader);
+  level = &priv->levels[priv->level];
+
   if (priv->dirty)
     {
-      guint opacity;
+      guint8 opacity;
       gfloat width, height;
       ClutterActorBox box;
+      OdoTextureAttributes touched, upload;
 
       opacity = clutter_actor_get_paint_opacity (actor);
       clutter_actor_get_allocation_box (actor, &box);
       width = box.x2 - box.x1;
       height = box.y2 - box.y1;
 
-      for (i = 0; i <= priv->tiles_y; i++)
+      if ((width != priv->width) || (height != priv->height))
         {
-          for (j = 0; j <= priv->tiles_x; j++)
-            {
-              CoglTextureVertex *vertex =
-                &priv->vertices[(i * (priv->tiles_x + 1)) + j];
-
-              vertex->tx = j/(gfloat)priv->tiles_x;
-              vertex->ty = i/(gfloat)priv->tiles_y;
-              vertex->x = width * vertex->tx;
-              vertex->y = height * vertex->ty;
-              vertex->z = 0;
-              cogl_color_set_from_4ub (&vertex->color,
-                                       0xff, 0xff, 0xff, opacity);
-
-              if (priv->callback)
-                priv->callback (self, vertex, width, height, priv->user_data);
-            }
+          priv->width = width;
+          priv->height = height;
+          priv->stale |= ODO_TEXTURE_ATTRIBUTE_POSITION;
         }
 
-      /* We add all three attributes again, although in an ideal case,
-       * we'd add only those that had changed. Because we provide the
-       * ability to change each, unless we had a 'changed' gboolean * in
-       * the function prototype, we have to upload all of it.
-       */
-      cogl_vertex_buffer_add (priv->vbo,
-                              "gl_Vertex",
-                              3,
-                              COGL_ATTRIBUTE_TYPE_FLOAT,
-                              FALSE,
-                              sizeof (CoglTextureVertex),
-                              &priv->vertices->x);
-      cogl_vertex_buffer_add (priv->vbo,
-                              "gl_MultiTexCoord0",
-                              2,
-                              COGL_ATTRIBUTE_TYPE_FLOAT,
-                              FALSE,
-                              sizeof (CoglTextureVertex),
-                              &priv->vertices->tx);
-      cogl_vertex_buffer_add (priv->vbo,
-                              "gl_Color",
-                              4,
-                              COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE,
-                              FALSE,
-                              sizeof (CoglTextureVertex),
-                              &priv->vertices->color);
-      cogl_vertex_buffer_submit (priv->vbo);
+      if (opacity != priv->opacity)
+        {
+          priv->opacity = opacity;
+          priv->stale |= ODO_TEXTURE_ATTRIBUTE_COLOR;
+        }
 
+      if (use_shader)
+        {
+          /* The buffer only needs to hold the flat grid, which doesn't
+           * change unless the size or opacity does.
+           */
+          if (priv->stale || priv->deformed)
+            odo_texture_flatten_rows (self, 0, level->tiles_y + 1,
+                                      width, height, opacity);
+          touched = ODO_TEXTURE_ATTRIBUTE_NONE;
+        }
+      else
+        touched = odo_texture_deform (self, width, height, opacity);
+
+      /* Upload whatever was deformed this time, as well as whatever was
+       * deformed last time, so that it gets restored to the flat grid.
+       */
+      upload = touched | priv->deformed | priv->stale;
+
+      if (upload & ODO_TEXTURE_ATTRIBUTE_POSITION)
+        cogl_vertex_buffer_add (level->vbo,
+                                "gl_Vertex",
+                                3,
+                                COGL_ATTRIBUTE_TYPE_FLOAT,
+                                FALSE,
+                                sizeof (CoglTextureVertex),
+                                &priv->vertices->x);
+      if (upload & ODO_TEXTURE_ATTRIBUTE_COLOR)
+        cogl_vertex_buffer_add (level->vbo,
+                                "gl_Color",
+                                4,
+                                COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE,
+                                FALSE,
+                                sizeof (CoglTextureVertex),
+                                &priv->vertices->color);
+      if (upload)
+        cogl_vertex_buffer_submit (level->vbo);
+
+      priv->deformed = touched;
+      priv->stale = ODO_TEXTURE_ATTRIBUTE_NONE;
       priv->dirty = FALSE;
     }
 
@@ -229,46 +1329,97 @@ odo_texture_paint (ClutterActor *actor)
   if (!depth)
     cogl_set_depth_test_enabled (TRUE);
 
+  /* Drawing the faces separately relies on culling to hide whichever
+   * one is facing away. Drawing them at once needs it off.
+   */
+  want_cull = priv->back_face && !single_pass;
   cull = cogl_get_backface_culling_enabled ();
-  if (priv->back_face && !cull)
-    cogl_set_backface_culling_enabled (TRUE);
-  else if (!priv->back_face && cull)
-    cogl_set_backface_culling_enabled (FALSE);
+  if (want_cull != cull)
+    cogl_set_backface_culling_enabled (want_cull);
 
-  if (priv->front_face)
+  if (program)
     {
-      material = clutter_texture_get_cogl_material (priv->front_face);
-      cogl_set_source (material);
-      cogl_vertex_buffer_draw_elements (priv->vbo,
-                                        COGL_VERTICES_MODE_TRIANGLE_STRIP,
-                                        priv->indices,
-                                        0,
-                                        (priv->tiles_x + 1) *
-                                        (priv->tiles_y + 1),
-                                        0,
-                                        priv->n_indices);
+      cogl_program_use (program->program);
+
+      if (use_shader)
+        {
+          const OdoDistortData *d = priv->effect_data;
+
+          cogl_program_uniform_1f (program->turn_uniform, d->turn);
+          cogl_program_uniform_1f (program->angle_uniform, d->angle);
+          cogl_program_uniform_1f (program->radius_uniform, d->radius);
+          cogl_program_uniform_1f (program->amplitude_uniform,
+                                   d->amplitude);
+          cogl_program_uniform_1f (program->width_uniform, priv->width);
+          cogl_program_uniform_1f (program->height_uniform, priv->height);
+        }
+
+      if (single_pass)
+        {
+          cogl_program_uniform_1i (program->front_uniform, 0);
+          cogl_program_uniform_1i (program->back_uniform, 1);
+        }
     }
 
-  if (priv->back_face)
+  if (single_pass)
     {
-      material = clutter_texture_get_cogl_material (priv->back_face);
-      cogl_set_source (material);
-      cogl_vertex_buffer_draw_elements (priv->vbo,
+      /* Both textures go in one material, front on the first layer. It's
+       * only rebuilt when one of the faces changes.
+       */
+      if (priv->material == COGL_INVALID_HANDLE)
+        priv->material = odo_texture_build_material (self);
+
+      cogl_set_source (priv->material);
+      cogl_vertex_buffer_draw_elements (level->vbo,
                                         COGL_VERTICES_MODE_TRIANGLE_STRIP,
-                                        priv->bf_indices,
+                                        level->indices->indices,
                                         0,
-                                        (priv->tiles_x + 1) *
-                                        (priv->tiles_y + 1),
+                                        odo_mesh_get_n_vertices
+                                          (level->tiles_x, level->tiles_y)
+                                        - 1,
                                         0,
-                                        priv->n_indices);
+                                        level->indices->n_indices);
     }
+  else
+    {
+      if (priv->front_face)
+        {
+          material = clutter_texture_get_cogl_material (priv->front_face);
+          cogl_set_source (material);
+          cogl_vertex_buffer_draw_elements (level->vbo,
+                                            COGL_VERTICES_MODE_TRIANGLE_STRIP,
+                                            level->indices->indices,
+                                            0,
+                                            odo_mesh_get_n_vertices
+                                              (level->tiles_x,
+                                               level->tiles_y) - 1,
+                                            0,
+                                            level->indices->n_indices);
+        }
+
+      if (priv->back_face)
+        {
+          material = clutter_texture_get_cogl_material (priv->back_face);
+          cogl_set_source (material);
+          cogl_vertex_buffer_draw_elements (level->vbo,
+                                            COGL_VERTICES_MODE_TRIANGLE_STRIP,
+                                            level->indices->bf_indices,
+                                            0,
+                                            odo_mesh_get_n_vertices
+                                              (level->tiles_x,
+                                               level->tiles_y) - 1,
+                                            0,
+                                            level->indices->n_indices);
+        }
+    }
+
+  if (program)
+    cogl_program_use (COGL_INVALID_HANDLE);
 
   if (!depth)
     cogl_set_depth_test_enabled (FALSE);
-  if (priv->back_face && !cull)
-    cogl_set_backface_culling_enabled (FALSE);
-  else if (!priv->back_face && cull)
-    cogl_set_backface_culling_enabled (TRUE);
+  if (want_cull != cull)
+    cogl_set_backface_culling_enabled (cull);
 }
 
 static void
@@ -401,105 +1552,108 @@ odo_texture_class_init (OdoTextureClass *klass)
                                                         G_PARAM_STATIC_NAME |
                                                         G_PARAM_STATIC_NICK |
                                                         G_PARAM_STATIC_BLURB));
-}
-
-static void
-odo_texture_init_arrays (OdoTexture *self)
-{
-  GLushort *idx, *bf_idx;
-  gint x, y, direction;
-  GLushort *static_indices, *static_bf_indices;
-  OdoTexturePrivate *priv = self->priv;
 
-  odo_texture_free_arrays (self);
+  g_object_class_install_property (object_class,
+                                   PROP_N_THREADS,
+                                   g_param_spec_int ("n-threads",
+                                                     "Threads",
+                                                     "Amount of threads to "
+                                                     "deform the mesh with.",
+                                                     1, G_MAXINT, 1,
+                                                     G_PARAM_READWRITE |
+                                                     G_PARAM_STATIC_NAME |
+                                                     G_PARAM_STATIC_NICK |
+                                                     G_PARAM_STATIC_BLURB));
 
-  priv->n_indices = (2 + 2 * priv->tiles_x) *
-                    priv->tiles_y +
-                    (priv->tiles_y - 1);
-  static_indices = g_new (GLushort, priv->n_indices);
-  static_bf_indices = g_new (GLushort, priv->n_indices);
+  g_object_class_install_property (object_class,
+                                   PROP_THREAD_THRESHOLD,
+                                   g_param_spec_int ("thread-threshold",
+                                                     "Thread threshold",
+                                                     "Amount of vertices "
+                                                     "below which the mesh "
+                                                     "is deformed on a "
+                                                     "single thread.",
+                                                     0, G_MAXINT, 4096,
+                                                     G_PARAM_READWRITE |
+                                                     G_PARAM_STATIC_NAME |
+                                                     G_PARAM_STATIC_NICK |
+                                                     G_PARAM_STATIC_BLURB));
 
-#define MESH_INDEX(X, Y) (Y) * (priv->tiles_x + 1) + (X)
+  g_object_class_install_property (object_class,
+                                   PROP_LOD,
+                                   g_param_spec_boolean ("lod",
+                                                         "Level of detail",
+                                                         "Whether to pick a "
+                                                         "coarser grid when "
+                                                         "the texture is "
+                                                         "small or flat.",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
 
-  direction = 1;
+  g_object_class_install_property (object_class,
+                                   PROP_LOD_TILE_SIZE,
+                                   g_param_spec_float ("lod-tile-size",
+                                                       "LOD tile size",
+                                                       "Size in pixels on "
+                                                       "screen of the tiles "
+                                                       "where the texture "
+                                                       "bends.",
+                                                       1.f, G_MAXFLOAT, 8.f,
+                                                       G_PARAM_READWRITE |
+                                                       G_PARAM_STATIC_NAME |
+                                                       G_PARAM_STATIC_NICK |
+                                                       G_PARAM_STATIC_BLURB));
 
-  idx = static_indices;
-  idx[0] = MESH_INDEX (0, 0);
-  idx[1] = MESH_INDEX (0, 1);
-  idx += 2;
+  g_object_class_install_property (object_class,
+                                   PROP_SINGLE_PASS,
+                                   g_param_spec_boolean ("single-pass",
+                                                         "Single pass",
+                                                         "Whether to draw "
+                                                         "both faces at once "
+                                                         "with a fragment "
+                                                         "shader.",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+}
 
-  bf_idx = static_bf_indices;
-  bf_idx[0] = MESH_INDEX (priv->tiles_x, 0);
-  bf_idx[1] = MESH_INDEX (priv->tiles_x, 1);
-  bf_idx += 2;
+static void
+odo_texture_init_arrays (OdoTexture *self)
+{
+  gint n;
+  OdoTexturePrivate *priv = self->priv;
 
-  for (y = 0; y < priv->tiles_y; y++)
+  /* A resolution used before still has its buffers */
+  if (odo_texture_unstash_grid (self))
     {
-      for (x = 0; x < priv->tiles_x; x++)
-        {
-          /* Add 2 triangles for a quad */
-          if (direction)
-            {
-              idx[0] = MESH_INDEX (x + 1, y);
-              idx[1] = MESH_INDEX (x + 1, y + 1);
-              bf_idx[0] = MESH_INDEX (priv->tiles_x - (x + 1), y);
-              bf_idx[1] = MESH_INDEX (priv->tiles_x - (x + 1), y + 1);
-            }
-          else
-            {
-              idx[0] = MESH_INDEX (priv->tiles_x - x - 1, y);
-              idx[1] = MESH_INDEX (priv->tiles_x - x - 1, y + 1);
-              bf_idx[0] = MESH_INDEX (x + 1, y);
-              bf_idx[1] = MESH_INDEX (x + 1, y + 1);
-            }
-          idx += 2;
-          bf_idx += 2;
-        }
-
-      /* Link rows together to draw in one call */
-      if (y == (priv->tiles_y - 1))
-        break;
-
-      if (direction)
-        {
-          idx[0] = MESH_INDEX (priv->tiles_x, y + 1);
-          idx[1] = MESH_INDEX (priv->tiles_x, y + 1);
-          idx[2] = MESH_INDEX (priv->tiles_x, y + 2);
-          bf_idx[0] = MESH_INDEX (0, y + 1);
-          bf_idx[1] = MESH_INDEX (0, y + 1);
-          bf_idx[2] = MESH_INDEX (0, y + 2);
-        }
-      else
-        {
-          idx[0] = MESH_INDEX (0, y + 1);
-          idx[1] = MESH_INDEX (0, y + 1);
-          idx[2] = MESH_INDEX (0, y + 2);
-          bf_idx[0] = MESH_INDEX (priv->tiles_x, y + 1);
-          bf_idx[1] = MESH_INDEX (priv->tiles_x, y + 1);
-          bf_idx[2] = MESH_INDEX (priv->tiles_x, y + 2);
-        }
-
-      idx += 3;
-      bf_idx += 3;
-      direction = !direction;
+      odo_texture_uniform_coords (priv->column_tx, priv->tiles_x);
+      odo_texture_uniform_coords (priv->row_ty, priv->tiles_y);
+      odo_texture_set_grid (self, 0);
+      return;
     }
 
-  priv->indices =
-    cogl_vertex_buffer_indices_new (COGL_INDICES_TYPE_UNSIGNED_SHORT,
-                                    static_indices,
-                                    priv->n_indices);
-  priv->bf_indices =
-    cogl_vertex_buffer_indices_new (COGL_INDICES_TYPE_UNSIGNED_SHORT,
-                                    static_bf_indices,
-                                    priv->n_indices);
-  g_free (static_indices);
-  g_free (static_bf_indices);
+  /* Each level halves the resolution, down to a single tile */
+  for (n = 1; n < ODO_TEXTURE_MAX_LEVELS; n++)
+    if (((priv->tiles_x >> n) < 1) && ((priv->tiles_y >> n) < 1))
+      break;
+  priv->n_levels = n;
 
+  /* Coarser levels use the start of the same arrays */
   priv->vertices = g_new (CoglTextureVertex,
                           (priv->tiles_x + 1) * (priv->tiles_y + 1));
-
-  priv->vbo = cogl_vertex_buffer_new ((priv->tiles_x + 1) *
-                                      (priv->tiles_y + 1));
+  priv->column_tx = g_new (gfloat, priv->tiles_x + 1);
+  priv->row_ty = g_new (gfloat, priv->tiles_y + 1);
+  priv->lod_column_tx = g_new (gfloat, priv->tiles_x + 1);
+  priv->lod_row_ty = g_new (gfloat, priv->tiles_y + 1);
+
+  odo_texture_uniform_coords (priv->column_tx, priv->tiles_x);
+  odo_texture_uniform_coords (priv->row_ty, priv->tiles_y);
+  odo_texture_set_grid (self, 0);
 }
 
 static void
@@ -509,7 +1663,14 @@ odo_texture_init (OdoTexture *self)
 
   priv->tiles_x = 32;
   priv->tiles_y = 32;
+  priv->lod_tile_size = 8.f;
+  priv->single_pass = FALSE;
   odo_texture_init_arrays (self);
+
+  priv->n_threads = 1;
+  priv->thread_threshold = 4096;
+  g_mutex_init (&priv->bands_lock);
+  g_cond_init (&priv->bands_cond);
 }
 
 ClutterActor *
@@ -562,16 +1723,25 @@ odo_texture_set_textures (OdoTexture     *texture,
   OdoTexturePrivate *priv = texture->priv;
 
   old_texture = priv->front_face;
+  if (old_texture)
+    odo_texture_unwatch_face (texture, old_texture);
   priv->front_face = front_face ? g_object_ref_sink (front_face) : NULL;
+  if (priv->front_face)
+    odo_texture_watch_face (texture, priv->front_face);
   if (old_texture)
     g_object_unref (old_texture);
 
   old_texture = priv->back_face;
+  if (old_texture)
+    odo_texture_unwatch_face (texture, old_texture);
   priv->back_face = back_face ? g_object_ref_sink (back_face) : NULL;
+  if (priv->back_face)
+    odo_texture_watch_face (texture, priv->back_face);
   if (old_texture)
     g_object_unref (old_texture);
 
-  clutter_actor_queue_redraw (CLUTTER_ACTOR (texture));
+  /* This queues a redraw too */
+  odo_texture_material_changed (texture);
 }
 
 void
@@ -593,28 +1763,137 @@ odo_texture_set_resolution (OdoTexture *texture,
                             gint        tiles_y)
 {
   OdoTexturePrivate *priv = texture->priv;
-  gboolean changed = FALSE;
 
   g_return_if_fail ((tiles_x > 0) && (tiles_y > 0));
 
+  if ((priv->tiles_x == tiles_x) && (priv->tiles_y == tiles_y))
+    return;
+
+  odo_texture_stash_grid (texture, priv->tiles_x, priv->tiles_y);
+
+  g_object_freeze_notify (G_OBJECT (texture));
+
   if (priv->tiles_x != tiles_x)
     {
       priv->tiles_x = tiles_x;
-      changed = TRUE;
       g_object_notify (G_OBJECT (texture), "tiles-x");
     }
 
   if (priv->tiles_y != tiles_y)
     {
       priv->tiles_y = tiles_y;
-      changed = TRUE;
       g_object_notify (G_OBJECT (texture), "tiles-y");
     }
 
-  if (changed)
+  odo_texture_init_arrays (texture);
+  odo_texture_invalidate (texture);
+
+  g_object_thaw_notify (G_OBJECT (texture));
+}
+}
+
+void
+odo_texture_get_threads (OdoTexture *texture,
+                         gint       *n_threads,
+                         gint       *threshold)
+{
+  OdoTexturePrivate *priv = texture->priv;
+
+  if (n_threads)
+    *n_threads = priv->n_threads;
+  if (threshold)
+    *threshold = priv->thread_threshold;
+}
+
+void
+odo_texture_set_threads (OdoTexture *texture,
+                         gint        n_threads,
+                         gint        threshold)
+{
+  OdoTexturePrivate *priv = texture->priv;
+
+  g_return_if_fail ((n_threads > 0) && (threshold >= 0));
+
+  if (priv->n_threads != n_threads)
+    {
+      priv->n_threads = n_threads;
+      if (priv->pool)
+        g_thread_pool_set_max_threads (priv->pool, n_threads - 1, NULL);
+      g_object_notify (G_OBJECT (texture), "n-threads");
+    }
+
+  if (priv->thread_threshold != threshold)
     {
-      odo_texture_init_arrays (texture);
-      odo_texture_invalidate (texture);
+      priv->thread_threshold = threshold;
+      g_object_notify (G_OBJECT (texture), "thread-threshold");
+    }
+}
+
+void
+odo_texture_get_lod (OdoTexture *texture,
+                     gboolean   *enabled,
+                     gfloat     *tile_size)
+{
+  OdoTexturePrivate *priv = texture->priv;
+
+  if (enabled)
+    *enabled = priv->lod;
+  if (tile_size)
+    *tile_size = priv->lod_tile_size;
+}
+
+void
+odo_texture_set_lod (OdoTexture *texture,
+                     gboolean    enabled,
+                     gfloat      tile_size)
+{
+  OdoTexturePrivate *priv = texture->priv;
+
+  g_return_if_fail (tile_size >= 1.f);
+
+  enabled = !!enabled;
+  if (priv->lod != enabled)
+    {
+      priv->lod = enabled;
+
+      /* Go back to the full resolution grid */
+      if (!enabled)
+        {
+          odo_texture_uniform_coords (priv->column_tx, priv->tiles_x);
+          odo_texture_uniform_coords (priv->row_ty, priv->tiles_y);
+          odo_texture_set_grid (texture, 0);
+        }
+
+      g_object_notify (G_OBJECT (texture), "lod");
+    }
+
+  if (priv->lod_tile_size != tile_size)
+    {
+      priv->lod_tile_size = tile_size;
+      g_object_notify (G_OBJECT (texture), "lod-tile-size");
+    }
+
+  odo_texture_invalidate (texture);
+}
+
+gboolean
+odo_texture_get_single_pass (OdoTexture *texture)
+{
+  return texture->priv->single_pass;
+}
+
+void
+odo_texture_set_single_pass (OdoTexture *texture,
+                             gboolean    single_pass)
+{
+  OdoTexturePrivate *priv = texture->priv;
+
+  single_pass = !!single_pass;
+  if (priv->single_pass != single_pass)
+    {
+      priv->single_pass = single_pass;
+      g_object_notify (G_OBJECT (texture), "single-pass");
+      clutter_actor_queue_redraw (CLUTTER_ACTOR (texture));
     }
 }
 
@@ -626,11 +1905,58 @@ odo_texture_set_callback (OdoTexture         *texture,
   OdoTexturePrivate *priv = texture->priv;
 
   priv->callback = callback;
+  priv->deform_callback = NULL;
+  priv->batch_callback = NULL;
   priv->user_data = user_data;
 
   odo_texture_invalidate (texture);
 }
 
+void
+odo_texture_set_deform_callback (OdoTexture               *texture,
+                                 OdoTextureDeformCallback  callback,
+                                 gpointer                  user_data)
+{
+  OdoTexturePrivate *priv = texture->priv;
+
+  priv->callback = NULL;
+  priv->deform_callback = callback;
+  priv->batch_callback = NULL;
+  priv->user_data = user_data;
+
+  odo_texture_invalidate (texture);
+}
+
+void
+odo_texture_set_batch_callback (OdoTexture              *texture,
+                                OdoTextureBatchCallback  callback,
+                                gpointer                 user_data)
+{
+  OdoTexturePrivate *priv = texture->priv;
+
+  priv->callback = NULL;
+  priv->deform_callback = NULL;
+  priv->batch_callback = callback;
+  priv->user_data = user_data;
+
+  odo_texture_invalidate (texture);
+}
+
+void
+odo_texture_set_effect (OdoTexture           *texture,
+                        OdoTextureEffect      effect,
+                        const OdoDistortData *data)
+{
+  OdoTexturePrivate *priv = texture->priv;
+
+  g_return_if_fail (effect < ODO_TEXTURE_N_EFFECTS);
+
+  priv->effect = effect;
+  priv->effect_data = data;
+
+  odo_texture_invalidate (texture);
+}
+
 void
 odo_texture_invalidate (OdoTexture *texture)
 {
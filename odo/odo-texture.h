@@ -48,12 +48,73 @@ struct _OdoTextureClass
 
 GType odo_texture_get_type (void);
 
+typedef struct
+{
+  gfloat           radius;
+  gfloat           angle;
+  gfloat           turn;
+  gfloat           amplitude;
+} OdoDistortData;
+
+/* Built-in effects that can be run in a vertex shader */
+typedef enum
+{
+  ODO_TEXTURE_EFFECT_NONE,
+  ODO_TEXTURE_EFFECT_PAGE_TURN,
+  ODO_TEXTURE_EFFECT_CLOTH,
+  ODO_TEXTURE_EFFECT_BOWTIE,
+
+  ODO_TEXTURE_N_EFFECTS
+} OdoTextureEffect;
+
+typedef enum
+{
+  ODO_TEXTURE_ATTRIBUTE_NONE     = 0,
+  ODO_TEXTURE_ATTRIBUTE_POSITION = 1 << 0,
+  ODO_TEXTURE_ATTRIBUTE_COLOR    = 1 << 1,
+
+  ODO_TEXTURE_ATTRIBUTE_ALL      = ODO_TEXTURE_ATTRIBUTE_POSITION |
+                                   ODO_TEXTURE_ATTRIBUTE_COLOR
+} OdoTextureAttributes;
+
+/* Grids of at least the threshold set with odo_texture_set_threads() are
+ * deformed in bands of rows on a pool of worker threads as well as the
+ * painting thread. Any of the callbacks below can then be running on
+ * several threads at once, and must not call into Clutter or touch state
+ * shared with the main loop without locking.
+ */
+
+/* Moves and shades one vertex of the grid. The texture coordinates are
+ * set by the grid; changes to them are discarded.
+ */
 typedef void (*OdoTextureCallback) (OdoTexture        *texture,
                                     CoglTextureVertex *vertex,
                                     gfloat             width,
                                     gfloat             height,
                                     gpointer           user_data);
 
+/* Like OdoTextureCallback, but returns the attributes of the vertex that
+ * were modified, so that only those streams need to be uploaded. Texture
+ * coordinates are computed when the grid changes and must not be modified.
+ */
+typedef OdoTextureAttributes (*OdoTextureDeformCallback) (OdoTexture        *texture,
+                                                          CoglTextureVertex *vertex,
+                                                          gfloat             width,
+                                                          gfloat             height,
+                                                          gpointer           user_data);
+
+/* Called with a block of whole rows of the grid, already reset to a flat
+ * mesh, so that invariants can be hoisted out of the per-vertex loop.
+ * vertices holds n_rows rows of n_columns vertices each.
+ */
+typedef OdoTextureAttributes (*OdoTextureBatchCallback) (OdoTexture        *texture,
+                                                         CoglTextureVertex *vertices,
+                                                         gint               n_columns,
+                                                         gint               n_rows,
+                                                         gfloat             width,
+                                                         gfloat             height,
+                                                         gpointer           user_data);
+
 ClutterActor *odo_texture_new (void);
 ClutterActor *odo_texture_new_from_files (const gchar *front_face_filename,
                                           const gchar *back_face_filename);
@@ -68,10 +129,61 @@ void odo_texture_set_resolution (OdoTexture *texture,
                                  gint        tiles_x,
                                  gint        tiles_y);
 
+/* Grids of at least threshold vertices are deformed in bands of rows on
+ * n_threads threads, so callbacks must be safe to call concurrently.
+ */
+void odo_texture_get_threads (OdoTexture *texture,
+                              gint       *n_threads,
+                              gint       *threshold);
+
+void odo_texture_set_threads (OdoTexture *texture,
+                              gint        n_threads,
+                              gint        threshold);
+
+/* With level of detail enabled, the resolution is the finest grid that
+ * will be used. Each frame, the texture picks the coarsest of a few
+ * grids that gives tiles of about tile_size pixels on screen where the
+ * deformation bends it, with the columns and rows concentrated there.
+ * Parts that stay flat get a single tile.
+ */
+void odo_texture_get_lod (OdoTexture *texture,
+                          gboolean   *enabled,
+                          gfloat     *tile_size);
+
+void odo_texture_set_lod (OdoTexture *texture,
+                          gboolean    enabled,
+                          gfloat      tile_size);
+
+/* When both faces are set, they are drawn in one pass with a fragment
+ * shader that picks the texture by which way each triangle faces. This
+ * is on by default, and falls back to drawing each face separately if
+ * shaders are unavailable.
+ */
+gboolean odo_texture_get_single_pass (OdoTexture *texture);
+
+void odo_texture_set_single_pass (OdoTexture *texture,
+                                  gboolean    single_pass);
+
 void odo_texture_set_callback (OdoTexture         *texture,
                                OdoTextureCallback  callback,
                                gpointer            user_data);
 
+void odo_texture_set_deform_callback (OdoTexture               *texture,
+                                      OdoTextureDeformCallback  callback,
+                                      gpointer                  user_data);
+
+void odo_texture_set_batch_callback (OdoTexture              *texture,
+                                     OdoTextureBatchCallback  callback,
+                                     gpointer                 user_data);
+
+/* Runs one of the built-in effects on the GPU, reading its parameters
+ * from data whenever the texture is painted. This takes precedence over
+ * any callback, which is used instead if shaders are unavailable.
+ */
+void odo_texture_set_effect (OdoTexture           *texture,
+                             OdoTextureEffect      effect,
+                             const OdoDistortData *data);
+
 void odo_texture_set_textures (OdoTexture     *texture,
                                ClutterTexture *front_face,
                                ClutterTexture *back_face);
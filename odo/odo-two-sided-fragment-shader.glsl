@@ -0,0 +1,15 @@
+/* Draws both faces of the mesh in one pass, picking the texture by
+ * which way the triangle faces. The front face is on texture unit 0 and
+ * the back face on unit 1.
+ */
+uniform sampler2D front;
+uniform sampler2D back;
+
+void
+main ()
+{
+  if (gl_FrontFacing)
+    gl_FragColor = texture2D (front, gl_TexCoord[0].st) * gl_Color;
+  else
+    gl_FragColor = texture2D (back, gl_TexCoord[0].st) * gl_Color;
+}
@@ -11,8 +11,35 @@ struct distort_data
   ClutterAlpha    *alpha;
 };
 
+/* The built-in effects run in a shader where possible, with the batch
+ * functions as a fallback.
+ */
+static const struct
+{
+  OdoTextureBatchCallback callback;
+  OdoTextureEffect        effect;
+} funcs[] =
+{
+  { page_turn_batch_func, ODO_TEXTURE_EFFECT_PAGE_TURN },
+  { bowtie_batch_func, ODO_TEXTURE_EFFECT_BOWTIE },
+  { cloth_batch_func, ODO_TEXTURE_EFFECT_CLOTH }
+};
+
 static gint func = 0;
 
+static void
+set_func (struct distort_data *d,
+          gint                 index)
+{
+  func = index;
+  odo_texture_set_batch_callback (ODO_TEXTURE (d->odo),
+                                  funcs[func].callback,
+                                  &d->data);
+  odo_texture_set_effect (ODO_TEXTURE (d->odo),
+                          funcs[func].effect,
+                          &d->data);
+}
+
 static void
 new_frame_cb (ClutterTimeline *timeline,
               gint             msecs,
@@ -36,32 +63,9 @@ completed_cb (ClutterTimeline *timeline,
   ClutterTimelineDirection dir = clutter_timeline_get_direction (timeline);
   clutter_timeline_set_direction (timeline, 1 - dir);
 
+  /* Switch to the next effect each time the page is flat again */
   if (dir == CLUTTER_TIMELINE_BACKWARD)
-    {
-      switch (func)
-        {
-        case 0:
-          odo_texture_set_callback (ODO_TEXTURE (d->odo),
-                                    bowtie_func,
-                                    &d->data);
-          func = 1;
-          break;
-
-        case 1:
-          odo_texture_set_callback (ODO_TEXTURE (d->odo),
-                                    cloth_func,
-                                    &d->data);
-          func = 2;
-          break;
-
-        case 2:
-          odo_texture_set_callback (ODO_TEXTURE (d->odo),
-                                    page_turn_func,
-                                    &d->data);
-          func = 0;
-          break;
-        }
-    }
+    set_func (d, (func + 1) % G_N_ELEMENTS (funcs));
 
   clutter_timeline_start (timeline);
 }
@@ -94,12 +98,20 @@ main (int argc, char *argv[])
 
   /* Create the texture and set the deformation callback */
   data.odo = odo_texture_new_from_files (argv[1], (argc > 2) ? argv[2] : NULL);
-  odo_texture_set_callback (ODO_TEXTURE (data.odo), page_turn_func, &data.data);
+  set_func (&data, 0);
 
-  /* Make the subdivision dependent on image size */
+  /* Make the subdivision dependent on image size, and use coarser grids
+   * when the page is mostly flat
+   */
   odo_texture_set_resolution (ODO_TEXTURE (data.odo),
                               clutter_actor_get_width (data.odo) / 10,
                               clutter_actor_get_height (data.odo) / 10);
+  odo_texture_set_lod (ODO_TEXTURE (data.odo), TRUE, 8.0);
+
+  /* Spread the deformation of big meshes over all the cores */
+  odo_texture_set_threads (ODO_TEXTURE (data.odo),
+                           g_get_num_processors (),
+                           4096);
 
   /* Put it in the centre of the stage and add a jaunty angle */
   clutter_actor_set_rotation (data.odo, CLUTTER_Y_AXIS, 15, 0, 0, 0);